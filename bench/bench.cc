@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <new>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "parameters.h"
+#include "hugepage.h"
+#include "bench.h"
+
+// Runner for the microbenchmarks in bench/ (make bench).
+//
+//    bench/cbp_bench [--json] [--filter <substring>] [--min-time <seconds>] [--reps <n>] [--list]
+//                    [--hugepages thp|explicit]
+//
+// Each benchmark is calibrated until one run takes at least 10 ms, then run --reps times
+// for a total of about --min-time seconds. ns/op is the median over the repetitions
+// (min ns/op the fastest one), with the cost of the clock reads subtracted.
+// allocs/op and bytes/op count operator new calls inside the timed sections; memory
+// that zlib or other C code gets from malloc directly is not included.
+// --hugepages allocates the cache and predictor tables as cbp -G does.
+
+static uint64_t num_allocs = 0;
+static uint64_t num_alloc_bytes = 0;
+
+uint64_t bench_allocs() { return num_allocs; }
+uint64_t bench_alloc_bytes() { return num_alloc_bytes; }
+
+volatile uint64_t bench_sink = 0;
+
+void *operator new(size_t size)
+{
+   num_allocs++;
+   num_alloc_bytes += size;
+   if (void *p = malloc(size ? size : 1))
+      return p;
+   throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t&) noexcept { num_allocs++; num_alloc_bytes += size; return malloc(size ? size : 1); }
+void *operator new[](size_t size, const std::nothrow_t&) noexcept { num_allocs++; num_alloc_bytes += size; return malloc(size ? size : 1); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+struct bench_entry_t {
+   const char *name;
+   bench_t *(*make)();
+};
+
+static std::vector<bench_entry_t>& registry()
+{
+   static std::vector<bench_entry_t> r;
+   return r;
+}
+
+int bench_register(const char *name, bench_t *(*make)())
+{
+   registry().push_back({name, make});
+   return 0;
+}
+
+struct bench_result_t {
+   std::string name;
+   double ns_per_op;
+   double min_ns_per_op;
+   double allocs_per_op;
+   double bytes_per_op;
+   uint64_t ops;
+};
+
+static double clock_overhead_ns()
+{
+   typedef std::chrono::steady_clock clock;
+   double best = 1e9;
+   for (int i = 0; i < 1000; i++)
+   {
+      clock::time_point a = clock::now();
+      clock::time_point b = clock::now();
+      best = std::min(best, std::chrono::duration<double, std::nano>(b - a).count());
+   }
+   return best;
+}
+
+static double net_ns(const bench_state_t& s, double overhead)
+{
+   return std::max(0.0, s.elapsed_ns - overhead * s.num_intervals());
+}
+
+static bench_result_t run_bench(const bench_entry_t& e, double min_time, uint64_t reps, double overhead)
+{
+   bench_t *b = e.make();
+
+   // Calibrate the number of operations per repetition.
+   uint64_t n = 16;
+   double t;
+   for (;;)
+   {
+      bench_state_t s;
+      s.resume();
+      b->run(s, n);
+      s.pause();
+      t = net_ns(s, overhead);
+      if ((t >= 1e7) || (n >= (1lu << 34)))
+         break;
+      n *= (t < 1e6) ? 10 : 2;
+   }
+   uint64_t per_rep = std::max((uint64_t)1, (uint64_t)((double)n * (min_time * 1e9 / reps) / std::max(t, 1.0)));
+
+   std::vector<double> ns;
+   uint64_t allocs = 0;
+   uint64_t bytes = 0;
+   for (uint64_t r = 0; r < reps; r++)
+   {
+      bench_state_t s;
+      s.resume();
+      b->run(s, per_rep);
+      s.pause();
+      ns.push_back(net_ns(s, overhead) / per_rep);
+      allocs += s.allocs;
+      bytes += s.alloc_bytes;
+   }
+   delete b;
+
+   std::sort(ns.begin(), ns.end());
+   bench_result_t res;
+   res.name = e.name;
+   res.ns_per_op = ns[ns.size() / 2];
+   res.min_ns_per_op = ns[0];
+   res.allocs_per_op = (double)allocs / (per_rep * reps);
+   res.bytes_per_op = (double)bytes / (per_rep * reps);
+   res.ops = per_rep * reps;
+   return res;
+}
+
+static void usage()
+{
+   printf("Usage: cbp_bench [--json] [--filter <substring>] [--min-time <seconds>] [--reps <n>] [--list] [--hugepages thp|explicit]\n");
+   exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+   bool json = false;
+   bool list = false;
+   const char *filter = NULL;
+   double min_time = 0.5;
+   uint64_t reps = 5;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--json"))
+         json = true;
+      else if (!strcmp(argv[i], "--list"))
+         list = true;
+      else if (!strcmp(argv[i], "--filter") && (i + 1 < argc))
+         filter = argv[++i];
+      else if (!strcmp(argv[i], "--min-time") && (i + 1 < argc))
+         min_time = atof(argv[++i]);
+      else if (!strcmp(argv[i], "--reps") && (i + 1 < argc))
+         reps = strtoul(argv[++i], NULL, 0);
+      else if (!strcmp(argv[i], "--hugepages") && (i + 1 < argc) && !strcmp(argv[i + 1], "thp") && ++i)
+         HUGEPAGE_MODE = hugepage_mode_t::Transparent;
+      else if (!strcmp(argv[i], "--hugepages") && (i + 1 < argc) && !strcmp(argv[i + 1], "explicit") && ++i)
+         HUGEPAGE_MODE = hugepage_mode_t::Explicit;
+      else
+         usage();
+   }
+   if ((min_time <= 0.0) || (reps == 0))
+      usage();
+
+   std::vector<bench_entry_t> selected;
+   for (const bench_entry_t& e : registry())
+      if (!filter || strstr(e.name, filter))
+         selected.push_back(e);
+   std::sort(selected.begin(), selected.end(), [](const bench_entry_t& a, const bench_entry_t& b) { return strcmp(a.name, b.name) < 0; });
+
+   if (list)
+   {
+      for (const bench_entry_t& e : selected)
+         printf("%s\n", e.name);
+      return 0;
+   }
+
+   const double overhead = clock_overhead_ns();
+
+   if (json)
+      printf("{\n  \"clock_overhead_ns\": %.2f,\n  \"min_time\": %.3f,\n  \"reps\": %lu,\n  \"benchmarks\": [", overhead, min_time, reps);
+   else
+      printf("%-36s %10s %10s %10s %10s %14s\n", "benchmark", "ns/op", "min ns/op", "allocs/op", "bytes/op", "ops");
+
+   for (size_t i = 0; i < selected.size(); i++)
+   {
+      bench_result_t r = run_bench(selected[i], min_time, reps, overhead);
+      if (json)
+         printf("%s\n    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, \"allocs_per_op\": %.4f, \"bytes_per_op\": %.2f, \"ops\": %lu}",
+                i ? "," : "", r.name.c_str(), r.ns_per_op, r.min_ns_per_op, r.allocs_per_op, r.bytes_per_op, r.ops);
+      else
+         printf("%-36s %10.2f %10.2f %10.3f %10.1f %14lu\n", r.name.c_str(), r.ns_per_op, r.min_ns_per_op, r.allocs_per_op, r.bytes_per_op, r.ops);
+      fflush(stdout);
+   }
+
+   if (json)
+      printf("\n  ]\n}\n");
+   return 0;
+}
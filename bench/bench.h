@@ -0,0 +1,94 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <inttypes.h>
+#include <chrono>
+
+// Microbenchmarks of the simulator hot paths (make bench, see bench.cc for the options).
+//
+// A benchmark is a bench_t: its constructor builds and warms the structure under test
+// (untimed) and run(s, n) performs n operations. Work that has to happen between
+// operations but is not part of what is measured goes between s.pause() and
+// s.resume(). Benchmarks register themselves at start-up:
+//
+//    BENCH("cache/l1_hit", new cache_bench_t(...));
+
+// Heap allocations (count and bytes) made through operator new so far; bench.cc
+// replaces the global operators to count them.
+uint64_t bench_allocs();
+uint64_t bench_alloc_bytes();
+
+class bench_state_t {
+private:
+   typedef std::chrono::steady_clock clock;
+
+   bool running;
+   clock::time_point t_start;
+   uint64_t allocs_start;
+   uint64_t bytes_start;
+   uint64_t intervals;
+
+public:
+   double elapsed_ns;
+   uint64_t allocs;
+   uint64_t alloc_bytes;
+
+   bench_state_t() : running(false), allocs_start(0), bytes_start(0), intervals(0), elapsed_ns(0.0), allocs(0), alloc_bytes(0) {}
+
+   void resume()
+   {
+      if (running)
+         return;
+      running = true;
+      intervals++;
+      allocs_start = bench_allocs();
+      bytes_start = bench_alloc_bytes();
+      t_start = clock::now();
+   }
+
+   void pause()
+   {
+      if (!running)
+         return;
+      clock::time_point t_end = clock::now();
+      elapsed_ns += std::chrono::duration<double, std::nano>(t_end - t_start).count();
+      allocs += bench_allocs() - allocs_start;
+      alloc_bytes += bench_alloc_bytes() - bytes_start;
+      running = false;
+   }
+
+   // Number of timed intervals; each one includes about one clock read, which the
+   // runner subtracts.
+   uint64_t num_intervals() const { return intervals; }
+};
+
+class bench_t {
+public:
+   virtual ~bench_t() {}
+   virtual void run(bench_state_t& s, uint64_t n) = 0;
+};
+
+int bench_register(const char *name, bench_t *(*make)());
+
+// Keeps results alive so the compiler cannot drop the measured work.
+extern volatile uint64_t bench_sink;
+
+// Small deterministic generator for the precomputed input streams.
+struct bench_rng_t {
+   uint64_t x;
+   explicit bench_rng_t(uint64_t seed) : x(seed * 0x9e3779b97f4a7c15lu + 1) {}
+   uint64_t next()
+   {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      return x;
+   }
+};
+
+#define BENCH_CAT2(a, b) a##b
+#define BENCH_CAT(a, b) BENCH_CAT2(a, b)
+#define BENCH(name, expr) \
+   static const int BENCH_CAT(bench_reg_, __LINE__) = bench_register(name, []() -> bench_t * { return (expr); })
+
+#endif
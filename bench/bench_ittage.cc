@@ -0,0 +1,83 @@
+#include <inttypes.h>
+#include <vector>
+#include "ittage.h"
+#include "bench.h"
+
+// IPREDICTOR (ITTAGE) GetPrediction / UpdatePredictor as bp_t calls them for indirect
+// jumps, with TrackOtherInst for the direct branches in between (untimed). 64 static
+// indirect jumps pick among 1, 2, 4 or 8 targets, some of them following the previous
+// jump's target.
+
+enum class ittage_phase_t { Predict, Update };
+
+class ittage_bench_t : public bench_t {
+private:
+   struct jump_t {
+      uint64_t pc;
+      uint64_t target;
+      uint64_t other_pc;   // a taken direct branch before the jump
+   };
+
+   ittage_phase_t phase;
+   IPREDICTOR *ittage;
+   std::vector<jump_t> stream;
+   uint64_t pos;
+
+public:
+   ittage_bench_t(ittage_phase_t phase)
+      : phase(phase)
+      , ittage(new IPREDICTOR())
+      , pos(0)
+   {
+      bench_rng_t rng(5);
+      stream.resize(1 << 16);
+      uint64_t last = 0;
+      for (jump_t& j : stream)
+      {
+         const uint64_t site = rng.next() & 63;
+         const uint64_t num_targets = 1lu << (site & 3);
+         const uint64_t sel = (site & 4) ? (last & (num_targets - 1)) : (rng.next() & (num_targets - 1));
+         j.pc = 0x500000 + site * 0x100;
+         j.target = 0x700000 + site * 0x1000 + sel * 0x40;
+         j.other_pc = 0x600000 + (rng.next() & 255) * 0x20;
+         last = sel + site;
+      }
+      bench_state_t s;
+      run(s, stream.size());
+   }
+
+   ~ittage_bench_t()
+   {
+      delete ittage;
+   }
+
+   void run(bench_state_t& s, uint64_t n)
+   {
+      uint64_t sum = 0;
+      s.pause();
+      for (uint64_t i = 0; i < n; i++)
+      {
+         const jump_t& j = stream[pos];
+         ittage->TrackOtherInst(j.other_pc, j.other_pc + 0x100);
+
+         if (phase == ittage_phase_t::Predict)
+            s.resume();
+         sum += ittage->GetPrediction(j.pc);
+         if (phase == ittage_phase_t::Predict)
+            s.pause();
+
+         if (phase == ittage_phase_t::Update)
+            s.resume();
+         ittage->UpdatePredictor(j.pc, j.target);
+         if (phase == ittage_phase_t::Update)
+            s.pause();
+
+         pos = (pos + 1) & (stream.size() - 1);
+      }
+      s.resume();
+      bench_sink += sum;
+   }
+};
+
+BENCH("ittage/predict", new ittage_bench_t(ittage_phase_t::Predict));
+BENCH("ittage/update", new ittage_bench_t(ittage_phase_t::Update));
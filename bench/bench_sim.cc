@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <inttypes.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "spdlog/spdlog.h"
+#include "spdlog/fmt/ostr.h"
+#include "parameters.h"
+#include "cache.h"
+#include "resource_schedule.h"
+#include "stride_prefetcher.h"
+#include "trace_reader.h"
+#include "bench.h"
+
+// Memory-side and trace-side benchmarks: cache_t, resource_schedule, StridePrefetcher
+// and TraceReader, built with the default parameters.
+
+// cache_t::access on the configured L1/L2/L3 hierarchy, all levels with replacement
+// policy Replacement. The address stream is precomputed and cycled through; a
+// sequential sweep over a footprint larger than a level's capacity misses in that level
+// under LRU, so each footprint selects the level that hits. The constructor makes one
+// untimed pass so the hierarchy starts warm.
+template <class Replacement = lru_repl_t>
+class cache_bench_t : public bench_t {
+private:
+   cache_t<Replacement> L3;
+   cache_t<Replacement> L2;
+   cache_t<Replacement> L1;
+   std::vector<uint64_t> addr;
+   uint64_t pos;
+   uint64_t cycle;
+
+public:
+   // A sweep over footprint bytes, with far_perc percent of the accesses replaced by
+   // random blocks of a far_footprint region; L2 and L3 simulate 2^-sample_bits of their
+   // sets (-X).
+   cache_bench_t(uint64_t footprint, uint64_t far_perc = 0, uint64_t far_footprint = 0, uint64_t sample_bits = 0)
+      : L3(L3_SIZE, L3_ASSOC, L3_BLOCKSIZE, L3_LATENCY, NULL, sample_bits)
+      , L2(L2_SIZE, L2_ASSOC, L2_BLOCKSIZE, L2_LATENCY, &L3, sample_bits)
+      , L1(L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, L1_LATENCY, &L2)
+      , pos(0)
+      , cycle(0)
+   {
+      bench_rng_t rng(footprint);
+      const uint64_t base = 0x10000000lu;
+      const uint64_t far_base = 0x100000000lu;
+      const uint64_t len = std::max(footprint / L1_BLOCKSIZE, (uint64_t)(1 << 16));
+      addr.resize(len);
+      for (uint64_t i = 0; i < len; i++)
+      {
+         if (far_perc && ((rng.next() % 100) < far_perc))
+            addr[i] = far_base + (rng.next() % (far_footprint / L1_BLOCKSIZE)) * L1_BLOCKSIZE;
+         else
+            addr[i] = base + (i * L1_BLOCKSIZE) % footprint;
+      }
+      for (uint64_t a : addr)
+         L1.access(cycle++, true, a);
+   }
+
+   void run(bench_state_t& s, uint64_t n)
+   {
+      uint64_t sum = 0;
+      for (uint64_t i = 0; i < n; i++)
+      {
+         sum += L1.access(cycle++, true, addr[pos]);
+         if (++pos == addr.size())
+            pos = 0;
+      }
+      bench_sink += sum;
+   }
+};
+
+BENCH("cache/l1_hit", new cache_bench_t(L1_SIZE / 2));
+BENCH("cache/l2_hit", new cache_bench_t(L1_SIZE * 4));
+BENCH("cache/l3_hit", new cache_bench_t(L2_SIZE * 4));
+BENCH("cache/memory", new cache_bench_t(L3_SIZE * 4));
+BENCH("cache/mix_l1_90_memory_10", new cache_bench_t(L1_SIZE / 2, 10, L3_SIZE * 4));
+// The other policies keep part of a sweep that overflows a level, so their l3_hit is a
+// mix of L2 and L3 hits.
+BENCH("cache/plru/l3_hit", new cache_bench_t<plru_repl_t>(L2_SIZE * 4));
+BENCH("cache/srrip/l3_hit", new cache_bench_t<srrip_repl_t>(L2_SIZE * 4));
+BENCH("cache/brrip/l3_hit", new cache_bench_t<brrip_repl_t>(L2_SIZE * 4));
+BENCH("cache/random/l3_hit", new cache_bench_t<random_repl_t>(L2_SIZE * 4));
+// 1/16 of the L2 and L3 sets simulated, the others inferred.
+BENCH("cache/sampled/memory", new cache_bench_t(L3_SIZE * 4, 0, 0, 4));
+BENCH("cache/sampled/mix_l1_90_memory_10", new cache_bench_t(L1_SIZE / 2, 10, L3_SIZE * 4, 4));
+
+// The I$ fetch path on an instruction stream: 4-byte micro-ops in basic blocks of 1..16,
+// each ending in a jump to a random block of a code footprint that fits in the I$, so
+// every fetch hits. fetch() answers the fetches after the first of each line from the
+// last-block filter; filter = false times access(), the full lookup, on the same stream.
+class ifetch_bench_t : public bench_t {
+private:
+   cache_t<lru_repl_t> L3;
+   cache_t<lru_repl_t> L2;
+   cache_t<lru_repl_t> IC;
+   std::vector<uint64_t> pc;
+   uint64_t pos;
+   uint64_t cycle;
+   bool filter;
+
+public:
+   ifetch_bench_t(bool filter)
+      : L3(L3_SIZE, L3_ASSOC, L3_BLOCKSIZE, L3_LATENCY, NULL)
+      , L2(L2_SIZE, L2_ASSOC, L2_BLOCKSIZE, L2_LATENCY, &L3)
+      , IC(IC_SIZE, IC_ASSOC, IC_BLOCKSIZE, 0, &L2)
+      , pos(0)
+      , cycle(0)
+      , filter(filter)
+   {
+      bench_rng_t rng(IC_SIZE);
+      const uint64_t base = 0x400000lu;
+      const uint64_t footprint = IC_SIZE / 2;
+      pc.resize(1 << 16);
+      uint64_t p = base;
+      for (uint64_t i = 0; i < pc.size(); i++)
+      {
+         pc[i] = p;
+         p += 4;
+         if ((rng.next() % 16) == 0)
+            p = base + (rng.next() % (footprint / 4)) * 4;
+      }
+      for (uint64_t a : pc)
+         IC.access(cycle++, true, a);
+   }
+
+   void run(bench_state_t& s, uint64_t n)
+   {
+      uint64_t sum = 0;
+      for (uint64_t i = 0; i < n; i++)
+      {
+         sum += filter ? IC.fetch(cycle++, pc[pos]) : IC.access(cycle++, true, pc[pos]);
+         if (++pos == pc.size())
+            pos = 0;
+      }
+      bench_sink += sum;
+   }
+};
+
+BENCH("cache/ic_fetch", new ifetch_bench_t(true));
+BENCH("cache/ic_fetch_unfiltered", new ifetch_bench_t(false));
+
+// resource_schedule::schedule with per_cycle requests per cycle on NUM_LDST_LANES lanes,
+// each asking for the current cycle plus a random 0..31 cycle delay (operand readiness).
+// At per_cycle == width the schedule is saturated: requests queue up behind runs of full
+// cycles and the search has to skip over them. The base cycle follows the clock as in
+// uarchsim_t::step().
+class schedule_bench_t : public bench_t {
+private:
+   resource_schedule rs;
+   std::vector<uint8_t> delay;
+   uint64_t per_cycle;
+   uint64_t pos;
+   uint64_t k;
+   uint64_t cycle;
+
+public:
+   schedule_bench_t(uint64_t per_cycle)
+      : rs(NUM_LDST_LANES)
+      , delay(1 << 16)
+      , per_cycle(per_cycle)
+      , pos(0)
+      , k(0)
+      , cycle(0)
+   {
+      bench_rng_t rng(per_cycle);
+      for (uint8_t& d : delay)
+         d = rng.next() & 31;
+      bench_state_t s;
+      run(s, 1 << 20);
+   }
+
+   void run(bench_state_t& s, uint64_t n)
+   {
+      uint64_t sum = 0;
+      for (uint64_t i = 0; i < n; i++)
+      {
+         sum += rs.schedule(cycle + delay[pos]);
+         pos = (pos + 1) & (delay.size() - 1);
+         if (++k == per_cycle)
+         {
+            k = 0;
+            cycle++;
+            rs.advance_base_cycle(cycle);
+         }
+      }
+      bench_sink += sum;
+   }
+};
+
+BENCH("resource_schedule/saturated", new schedule_bench_t(NUM_LDST_LANES));
+BENCH("resource_schedule/half_load", new schedule_bench_t(NUM_LDST_LANES / 2));
+
+// StridePrefetcher: 64 strided load PCs plus one-in-eight loads from a pool of 4096
+// other PCs that keep replacing RPT entries. The lookahead case does what the fetch
+// stage does per load (lookahead, then train) and issues the queued prefetches once per
+// cycle, two loads per cycle.
+class prefetcher_bench_t : public bench_t {
+private:
+   StridePrefetcher pf;
+   std::vector<PrefetchTrainingInfo> stream;
+   bool lookahead;
+   uint64_t pos;
+   uint64_t cycle;
+
+public:
+   prefetcher_bench_t(bool lookahead)
+      : lookahead(lookahead)
+      , pos(0)
+      , cycle(0)
+   {
+      bench_rng_t rng(7);
+      uint64_t next_addr[64];
+      for (uint64_t i = 0; i < 64; i++)
+         next_addr[i] = 0x10000000lu + i * 0x1000000lu;
+      stream.resize(1 << 16);
+      for (uint64_t i = 0; i < stream.size(); i++)
+      {
+         uint64_t pc;
+         uint64_t addr;
+         if ((rng.next() & 7) == 0)
+         {
+            pc = 0x200000 + (rng.next() & 4095);
+            addr = 0x80000000lu + (rng.next() & 0xffffff) * 8;
+         }
+         else
+         {
+            uint64_t j = i & 63;
+            pc = 0x100000 + j;
+            addr = next_addr[j];
+            next_addr[j] += 8 * (j + 1);
+         }
+         stream[i] = PrefetchTrainingInfo{pc, addr, 0, false};
+      }
+      bench_state_t s;
+      run(s, stream.size());
+   }
+
+   void run(bench_state_t& s, uint64_t n)
+   {
+      uint64_t sum = 0;
+      Prefetch p;
+      for (uint64_t i = 0; i < n; i++)
+      {
+         const PrefetchTrainingInfo& info = stream[pos];
+         if (lookahead)
+         {
+            pf.lookahead(info.pc, cycle);
+            if (i & 1)
+            {
+               while (pf.issue(p, cycle))
+                  sum += p.address;
+               cycle++;
+            }
+         }
+         pf.train(info);
+         pos = (pos + 1) & (stream.size() - 1);
+      }
+      bench_sink += sum;
+   }
+};
+
+BENCH("prefetcher/train", new prefetcher_bench_t(false));
+BENCH("prefetcher/lookahead_train", new prefetcher_bench_t(true));
+
+// TraceReader::get_inst (including freeing the returned db_t) on a synthetic trace of
+// loops with loads, stores, ALU/FP/slow ALU ops and branches, gzip-compressed into a
+// memfd so no disk I/O is involved. At the end of the trace a new reader is opened,
+// untimed.
+class trace_bench_t : public bench_t {
+private:
+   int fd;
+   std::string path;
+   TraceReader *reader;
+   std::string buf;
+
+   void emit(uint64_t pc, InstClass type, uint64_t ea, bool taken, uint64_t target,
+             std::initializer_list<uint8_t> ins, std::initializer_list<uint8_t> outs, uint64_t val)
+   {
+      auto put = [this](const void *p, size_t size) { buf.append((const char *)p, size); };
+      const uint8_t t = (uint8_t)type;
+      const uint8_t zero = 0;
+      const uint8_t size = 8;
+      put(&pc, 8);
+      put(&t, 1);
+      if (is_mem(type))
+      {
+         put(&ea, 8);
+         put(&size, 1);
+         put(&zero, 1);
+         if (type == InstClass::storeInstClass)
+            put(&zero, 1);
+      }
+      if (is_br(type))
+      {
+         const uint8_t tk = taken;
+         put(&tk, 1);
+         if (taken)
+            put(&target, 8);
+      }
+      const uint8_t num_ins = ins.size();
+      const uint8_t num_outs = outs.size();
+      put(&num_ins, 1);
+      for (uint8_t r : ins)
+         put(&r, 1);
+      put(&num_outs, 1);
+      for (uint8_t r : outs)
+         put(&r, 1);
+      for (uint8_t r : outs)
+      {
+         put(&val, 8);
+         if ((r >= 32) && (r < 64))
+            put(&val, 8);
+      }
+   }
+
+   void reopen()
+   {
+      delete reader;
+      reader = new TraceReader(path.c_str());
+   }
+
+public:
+   trace_bench_t()
+      : reader(NULL)
+   {
+      bench_rng_t rng(3);
+      for (uint64_t it = 0; it < 16384; it++)
+      {
+         const uint64_t base = 0x400000 + (it % 7) * 0x1000;
+         const uint64_t trip = 4 + (rng.next() & 15);
+         for (uint64_t k = 0; k < trip; k++)
+         {
+            uint64_t pc = base;
+            emit(pc, InstClass::loadInstClass, 0x10000000 + k * 64, false, 0, {1}, {2}, k); pc += 4;
+            emit(pc, InstClass::aluInstClass, 0, false, 0, {2, 3}, {3}, k); pc += 4;
+            emit(pc, InstClass::fpInstClass, 0, false, 0, {33}, {34}, k); pc += 4;
+            emit(pc, InstClass::storeInstClass, 0x20000000 + k * 8, false, 0, {1, 3}, {}, 0); pc += 4;
+            emit(pc, InstClass::slowAluInstClass, 0, false, 0, {3, 2}, {6}, k * k); pc += 4;
+            const bool t = rng.next() & 1;
+            emit(pc, InstClass::condBranchInstClass, 0, t, pc + 16, {64}, {}, 0);
+            pc = t ? (pc + 16) : (pc + 4);
+            emit(pc, InstClass::condBranchInstClass, 0, k != (trip - 1), base, {64}, {}, 0);
+         }
+      }
+
+      fd = memfd_create("cbp_bench_trace", 0);
+      if (fd < 0)
+      {
+         fprintf(stderr, "cbp_bench: memfd_create failed.\n");
+         exit(EXIT_FAILURE);
+      }
+      gzFile gz = gzdopen(dup(fd), "wb");
+      gzwrite(gz, buf.data(), buf.size());
+      gzclose(gz);
+      buf.clear();
+      buf.shrink_to_fit();
+      path = "/proc/self/fd/" + std::to_string(fd);
+
+      // The reader reports end of trace and its instruction count on std::cout.
+      std::cout.setstate(std::ios::failbit);
+      reopen();
+   }
+
+   ~trace_bench_t()
+   {
+      delete reader;
+      std::cout.clear();
+      close(fd);
+   }
+
+   void run(bench_state_t& s, uint64_t n)
+   {
+      uint64_t sum = 0;
+      for (uint64_t i = 0; i < n; i++)
+      {
+         db_t *inst = reader->get_inst();
+         if (!inst)
+         {
+            s.pause();
+            reopen();
+            s.resume();
+            inst = reader->get_inst();
+         }
+         sum += inst->pc;
+         delete inst;
+      }
+      bench_sink += sum;
+   }
+};
+
+BENCH("trace_reader/get_inst", new trace_bench_t());
@@ -0,0 +1,114 @@
+#include <inttypes.h>
+#include <vector>
+#include "cbp2016_tage_sc_l.h"
+#include "bench.h"
+
+// CBP2016_TAGE_SC_L predict / history_update / update, called the way
+// cond_branch_predictor_interface.cc calls them: predict and history_update at fetch,
+// update at retire. Branches go through in batches of WINDOW in-flight branches, so
+// update sees a prediction-time history that is WINDOW branches old. Each case times one
+// of the three calls and runs the other two paused; "branch" times all three.
+//
+// The predictor keeps its tables in globals (cbp2016_tage_sc_l.h), so this file is the
+// only one in the benchmark that includes it; lib/ittage.h is benchmarked separately.
+// setup() is called as beginCondDirPredictor() does, to move the tables to -G storage.
+
+enum class tage_phase_t { Predict, HistoryUpdate, Update, All };
+
+class tage_bench_t : public bench_t {
+private:
+   static constexpr uint64_t WINDOW = 32;
+
+   struct branch_t {
+      uint64_t pc;
+      bool taken;
+   };
+
+   tage_phase_t phase;
+   std::vector<branch_t> stream;
+   uint64_t pos;
+   uint64_t seq_no;
+   bool pred[WINDOW];
+
+   // Runs the branches [first, first + num) of the stream through one of the calls.
+   void step(tage_phase_t p, uint64_t first, uint64_t num)
+   {
+      for (uint64_t i = 0; i < num; i++)
+      {
+         const branch_t& b = stream[(first + i) & (stream.size() - 1)];
+         const uint64_t next_pc = b.taken ? (b.pc + 0x40) : (b.pc + 4);
+         if (p == tage_phase_t::Predict)
+            pred[i] = cbp2016_tage_sc_l.predict(seq_no + i, 0, b.pc).pred_taken;
+         else if (p == tage_phase_t::HistoryUpdate)
+            cbp2016_tage_sc_l.history_update(seq_no + i, 0, b.pc, 1, pred[i], b.taken, next_pc);
+         else
+            cbp2016_tage_sc_l.update(seq_no + i, 0, b.pc, b.taken, pred[i], next_pc, false);
+      }
+   }
+
+public:
+   // 512 static branches in loops of 8: loop exits, biased, alternating, and
+   // history-correlated branches, plus some data-dependent (random) ones.
+   tage_bench_t(tage_phase_t phase)
+      : phase(phase)
+      , pos(0)
+      , seq_no(0)
+   {
+      cbp2016_tage_sc_l.setup();
+      bench_rng_t rng(11);
+      stream.reserve(1 << 18);
+      bool last = false;
+      while (stream.size() < (1 << 18))
+      {
+         const uint64_t body = rng.next() & 63;
+         const uint64_t trip = 2 + (rng.next() & 15);
+         for (uint64_t k = 0; (k < trip) && (stream.size() < (1 << 18)); k++)
+         {
+            for (uint64_t j = 0; j < 7; j++)
+            {
+               const uint64_t pc = 0x400000 + (body * 8 + j) * 0x40;
+               bool t;
+               switch ((body + j) & 3)
+               {
+                  case 0: t = (rng.next() & 15) != 0; break;
+                  case 1: t = k & 1; break;
+                  case 2: t = !last; break;
+                  default: t = rng.next() & 1; break;
+               }
+               stream.push_back({pc, t});
+               last = t;
+            }
+            stream.push_back({0x400000 + (body * 8 + 7) * 0x40, k != (trip - 1)});
+         }
+      }
+      bench_state_t s;
+      run(s, stream.size());
+   }
+
+   void run(bench_state_t& s, uint64_t n)
+   {
+      s.pause();
+      for (uint64_t done = 0; done < n;)
+      {
+         const uint64_t num = std::min(WINDOW, n - done);
+         for (tage_phase_t p : {tage_phase_t::Predict, tage_phase_t::HistoryUpdate, tage_phase_t::Update})
+         {
+            if ((phase == p) || (phase == tage_phase_t::All))
+               s.resume();
+            step(p, pos, num);
+            if (phase != tage_phase_t::All)
+               s.pause();
+         }
+         s.pause();
+         pos += num;
+         seq_no += num;
+         done += num;
+      }
+      s.resume();
+   }
+};
+
+BENCH("tage_sc_l/predict", new tage_bench_t(tage_phase_t::Predict));
+BENCH("tage_sc_l/history_update", new tage_bench_t(tage_phase_t::HistoryUpdate));
+BENCH("tage_sc_l/update", new tage_bench_t(tage_phase_t::Update));
+BENCH("tage_sc_l/branch", new tage_bench_t(tage_phase_t::All));
@@ -12,6 +12,8 @@
 #include <array>
 #include <iostream>
 #include "lib/parameters.h"
+#include "lib/checkpoint.h"
+#include "lib/hugepage.h"
 //  extern int U_incrment;
 
 //parameters of the loop predictor
@@ -168,6 +170,12 @@ class bentry            // TAGE bimodal table entry
             hyst = 1;
         }
 
+        void checkpoint (ckpt_t& c)
+        {
+            c.io (hyst);
+            c.io (pred);
+        }
+
 };
 
 class gentry            // TAGE global table entry
@@ -185,6 +193,13 @@ class gentry            // TAGE global table entry
 
 
         }
+
+        void checkpoint (ckpt_t& c)
+        {
+            c.io (ctr);
+            c.io (tag);
+            c.io (u);
+        }
 };
 
 #define  POWER
@@ -266,6 +281,16 @@ class lentry            //loop predictor entry
             age = 0;
             dir = false;
         }
+
+        void checkpoint (ckpt_t& c)
+        {
+            c.io (NbIter);
+            c.io (confid);
+            c.io (CurrentIter);
+            c.io (TAG);
+            c.io (age);
+            c.io (dir);
+        }
 };
 
 //For the TAGE predictor
@@ -337,6 +362,30 @@ struct cbp_hist_t
 #ifdef LOOPPREDICTOR
           ltable.resize(1 << (LOGL));
           WITHLOOP = -1;
+#endif
+      }
+
+      // Folded-history lengths are set by init_histories(); only the folded value is state.
+      void checkpoint(ckpt_t& c)
+      {
+          c.io(GHIST);
+          c.io(ghist);
+          c.io(phist);
+          c.io(ptghist);
+          for (int i = 0; i <= NHIST; i++)
+          {
+              c.io(ch_i[i].comp);
+              c.io(ch_t[0][i].comp);
+              c.io(ch_t[1][i].comp);
+          }
+          c.io(L_shist);
+          c.io(S_slhist);
+          c.io(T_slhist);
+          c.io(IMHIST);
+          c.io(IMLIcount);
+#ifdef LOOPPREDICTOR
+          c.io(ltable);
+          c.io(WITHLOOP);
 #endif
       }
 };
@@ -504,12 +553,80 @@ class CBP2016_TAGE_SC_L
 
         void setup()
         {
+            // The tables were allocated by the static constructor, before -G was parsed.
+            gtable[1] = table_move(gtable[1], SizeTable[1]);
+            gtable[BORN] = table_move(gtable[BORN], SizeTable[BORN]);
+            for (int i = BORN + 1; i <= NHIST; i++)
+                gtable[i] = gtable[BORN];
+            for (int i = 2; i <= BORN - 1; i++)
+                gtable[i] = gtable[1];
+            btable = table_move(btable, 1 << LOGB);
         }
 
         void terminate()
         {
         }
 
+        // Saves/restores the predictor tables (file-scope globals above) together with the
+        // running and prediction-time histories.
+        void checkpoint(ckpt_t& c)
+        {
+            c.io (Bias);
+            c.io (BiasSK);
+            c.io (BiasBank);
+            c.io (IGEHLA);
+            c.io (IMGEHLA);
+            c.io (GGEHLA);
+            c.io (PGEHLA);
+            c.io (LGEHLA);
+            c.io (SGEHLA);
+            c.io (TGEHLA);
+            c.io (updatethreshold);
+            c.io (Pupdatethreshold);
+            c.io (WG);
+            c.io (WL);
+            c.io (WS);
+            c.io (WT);
+            c.io (WP);
+            c.io (WI);
+            c.io (WIM);
+            c.io (WB);
+            c.io (LSUM);
+            c.io (FirstH);
+            c.io (SecondH);
+            c.io (MedConf);
+            c.io (AltConf);
+            c.io (use_alt_on_na);
+            c.io (BIM);
+            c.io (TICK);
+            c.io (Seed);
+            c.io_array (btable, 1 << LOGB);
+            c.io_array (gtable[1], SizeTable[1]);
+            c.io_array (gtable[BORN], SizeTable[BORN]);
+
+            c.io (GI);
+            c.io (GTAG);
+            c.io (BI);
+            c.io (THRES);
+            c.io (predloop);
+            c.io (LIB);
+            c.io (LI);
+            c.io (LHIT);
+            c.io (LTAG);
+            c.io (LVALID);
+            c.io (tage_pred);
+            c.io (alttaken);
+            c.io (LongestMatchPred);
+            c.io (HitBank);
+            c.io (AltBank);
+            c.io (pred_inter);
+            c.io (LowConf);
+            c.io (HighConf);
+
+            c.io (active_hist);
+            c.io (pred_time_histories);
+        }
+
         uint64_t get_unique_inst_id(uint64_t seq_no, uint8_t piece) const
         {
             assert(piece < 16);
@@ -561,17 +678,17 @@ class CBP2016_TAGE_SC_L
 //            ltable = new lentry[1 << (LOGL)];
 //#endif
 
-            gtable[1] = new gentry[NBANKLOW * (1 << LOGG)];
+            gtable[1] = table_new<gentry>(NBANKLOW * (1 << LOGG));
             SizeTable[1] = NBANKLOW * (1 << LOGG);
 
-            gtable[BORN] = new gentry[NBANKHIGH * (1 << LOGG)];
+            gtable[BORN] = table_new<gentry>(NBANKHIGH * (1 << LOGG));
             SizeTable[BORN] = NBANKHIGH * (1 << LOGG);
 
             for (int i = BORN + 1; i <= NHIST; i++)
                 gtable[i] = gtable[BORN];
             for (int i = 2; i <= BORN - 1; i++)
                 gtable[i] = gtable[1];
-            btable = new bentry[1 << LOGB];
+            btable = table_new<bentry>(1 << LOGB);
 
             for (int i = 1; i <= NHIST; i++)
             {
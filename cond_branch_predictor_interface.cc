@@ -20,6 +20,10 @@
 #include "cbp2016_tage_sc_l.h"
 #include "my_cond_branch_predictor.h"
 #include "lib/log.h"
+#include "lib/stats.h"
+#include "lib/memstats.h"
+#include "lib/profiler.h"
+#include "lib/perfcount.h"
 #include <cassert>
 #include <stdio.h>
 #include <iterator>
@@ -105,6 +109,22 @@ public:
         return visited;
     }
 
+    void checkpoint(ckpt_t& c) {
+        c.io(graph);
+    }
+
+    uint64_t size() const {
+        return graph.size();
+    }
+
+    mem_usage_t memory() const {
+        mem_usage_t u = mem_usage(graph);
+        for (const auto& [key, dependencies] : graph) {
+            u.bytes += mem_usage(dependencies).bytes;
+        }
+        return u;
+    }
+
 private:
     std::unordered_map<uint64_t, std::unordered_set<uint64_t>> graph;
 
@@ -160,9 +180,12 @@ void notify_instr_fetch(uint64_t seq_no, uint8_t piece, uint64_t pc, const uint6
 bool get_cond_dir_prediction(uint64_t seq_no, uint8_t piece, uint64_t pc, const uint64_t pred_cycle,const uint64_t fetch_cycle, const uint64_t exec_cycle)
 {
     // which predictor was used, predictions from each, history tables where branch is found and their preiction, history tables it was stored in dured update
+    PERF_PHASE(PredictorHooks);
+    PROFILE_SCOPE(CondPredict);
     const PredDebugInfo active_predDebug =  cbp2016_tage_sc_l.predict(seq_no, piece, pc);  
     const bool tage_sc_l_pred = active_predDebug.pred_taken;
     const bool my_prediction = cond_predictor_impl.predict(seq_no, piece, pc, tage_sc_l_pred);
+    PROFILE_SCOPE(InterfaceLog);   // nested: the logging below is not charged to the predictor
     // fprintf(files.pred_history, "%" PRIx64 ",%" PRIx8 ",%" PRIx64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", 
     //     seq_no, piece, pc, pred_cycle, fetch_cycle, exec_cycle);
 
@@ -191,6 +214,8 @@ bool get_cond_dir_prediction(uint64_t seq_no, uint8_t piece, uint64_t pc, const
 //
 void spec_update(uint64_t seq_no, uint8_t piece, uint64_t pc, InstClass inst_class, const bool resolve_dir, const bool pred_dir, const uint64_t next_pc)
 {
+    PERF_PHASE(PredictorHooks);
+    PROFILE_SCOPE(SpecUpdate);
     assert(is_br(inst_class));
     int br_type = 0;
     switch(inst_class)
@@ -240,6 +265,8 @@ DependencyGraph depGraph;
 std::unordered_map<uint64_t/*key*/, bool/*val*/> registers_in_flight;
 void notify_instr_decode(uint64_t seq_no, uint8_t piece, uint64_t pc, const DecodeInfo& _decode_info, const uint64_t decode_cycle)
 {
+    PERF_PHASE(PredictorHooks);
+    PROFILE_SCOPE(InterfaceLog);
     if (is_load(_decode_info.insn_class)){
         
         std::vector<uint64_t> sources = _decode_info.src_reg_info;
@@ -299,6 +326,8 @@ std::string vector_to_string(const std::vector<uint64_t>& vec) {
 
 void notify_instr_execute_resolve(uint64_t seq_no, uint8_t piece, uint64_t pc, const bool pred_dir, const ExecuteInfo& _exec_info, const uint64_t execute_cycle)
 {
+    PERF_PHASE(PredictorHooks);
+    PROFILE_SCOPE(InterfaceLog);
     const auto log_key = get_unique_inst_id(seq_no, piece);
     const bool is_branch = is_br(_exec_info.dec_info.insn_class);
     // extern bool LOAD_DEPENDENT_BRANCHES;
@@ -324,8 +353,11 @@ void notify_instr_execute_resolve(uint64_t seq_no, uint8_t piece, uint64_t pc, c
                 is_LD_dependent = false;
             }
 
-            cbp2016_tage_sc_l.update(seq_no, piece, pc, _resolve_dir, pred_dir, _next_pc, is_LD_dependent);
-            cond_predictor_impl.update(seq_no, piece, pc, _resolve_dir, pred_dir, _next_pc);
+            {
+                PROFILE_SCOPE(CondUpdate);
+                cbp2016_tage_sc_l.update(seq_no, piece, pc, _resolve_dir, pred_dir, _next_pc, is_LD_dependent);
+                cond_predictor_impl.update(seq_no, piece, pc, _resolve_dir, pred_dir, _next_pc);
+            }
 	    // fprintf(files.history, "%" PRIx64 ",%" PRIx8 ",%" PRIx64 ",%" PRIx64 ",%" PRIu64 ",%d,%d\n", 
         //         seq_no, piece, pc, _next_pc, execute_cycle, pred_dir, _resolve_dir);
         }
@@ -418,6 +450,8 @@ void notify_instr_execute_resolve(uint64_t seq_no, uint8_t piece, uint64_t pc, c
 // For the sample predictor implementation, we do not leverage commit information
 void notify_instr_commit(uint64_t seq_no, uint8_t piece, uint64_t pc, const bool pred_dir, const ExecuteInfo& _exec_info, const uint64_t commit_cycle)
 {   
+    PERF_PHASE(PredictorHooks);
+    PROFILE_SCOPE(InterfaceLog);
     if(is_load(_exec_info.dec_info.insn_class)){
         uint64_t dst_reg = _exec_info.dec_info.dst_reg_info.value();
         // depChains.erase(dst_reg);
@@ -490,8 +524,58 @@ void write_CyclWP_summary_to_file(const std::map<int8_t, std::tuple<int, uint64_
 
 void endCondDirPredictor ()
 {
+    PROFILE_SCOPE(Output);
+    PERF_PHASE(Output);
     // writeHistorylog(histories_log, files.history); 
     // write_CyclWP_summary_to_file(compute_CyclWP_summary(histories_log),files.CyclWP_summary);    
     cbp2016_tage_sc_l.terminate();
     cond_predictor_impl.terminate();
 }
+
+//
+// checkpoint_cond_dir_predictor(ckpt_t& c)
+//
+// Saves or restores all predictor-side state (see lib/checkpoint.h). Called by the simulator
+// between instructions, after beginCondDirPredictor() on restore.
+//
+void checkpoint_cond_dir_predictor(ckpt_t& c)
+{
+    c.section("interface");
+    c.io(histories_log);
+    c.io(depGraph);
+    c.io(registers_in_flight);
+    c.section("cbp2016_tage_sc_l");
+    cbp2016_tage_sc_l.checkpoint(c);
+    c.section("cond_predictor_impl");
+    cond_predictor_impl.checkpoint(c);
+}
+
+//
+// register_cond_dir_predictor_stats(stats_t& s)
+//
+// Registers predictor-side measurements with the simulator's stats registry (-S, see
+// lib/stats.h). Called once when the simulator is constructed; contestants can add their
+// own counters here.
+//
+void register_cond_dir_predictor_stats(stats_t& s)
+{
+    s.counter("predictor.histories_log_entries", []() { return (uint64_t)histories_log.size(); });
+    s.counter("predictor.dep_graph_registers", []() { return depGraph.size(); });
+    s.counter("predictor.registers_in_flight", []() { return (uint64_t)registers_in_flight.size(); });
+}
+
+//
+// register_cond_dir_predictor_memory(memstats_t& m)
+//
+// Registers the predictor-side structures that grow with the run with the memory report
+// (-m, see lib/memstats.h). Called once when the simulator is constructed; contestants
+// whose predictor keeps per-branch state should add it here.
+//
+void register_cond_dir_predictor_memory(memstats_t& m)
+{
+    m.track("predictor.histories_log", []() { return mem_usage(histories_log); });
+    m.track("predictor.dep_graph", []() { return depGraph.memory(); });
+    m.track("predictor.registers_in_flight", []() { return mem_usage(registers_in_flight); });
+    m.track("cbp2016_tage_sc_l.pred_time_histories", []() { return mem_usage(cbp2016_tage_sc_l.pred_time_histories); });
+    m.track("cond_predictor_impl.pred_time_histories", []() { return cond_predictor_impl.memory(); });
+}
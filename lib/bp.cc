@@ -33,8 +33,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "cbp.h"
 #include "log.h"
 #include "parameters.h"
-
-#include "parameters.h"
+#include "stats.h"
+#include "memstats.h"
+#include "profiler.h"
 
 extern log_files files;
 
@@ -131,6 +132,7 @@ bool bp_t::predict(uint64_t seq_no, uint8_t piece, InstClass inst_class, uint64_
       spec_update(seq_no, piece, pc, inst_class, true/*taken*/, true/*pred_taken*/, next_pc);
       if(!PERFECT_INDIRECT_PRED)
       {
+          PROFILE_SCOPE(Indirect);
           ITTAGE->TrackOtherInst(pc , next_pc);
       }
 
@@ -150,6 +152,7 @@ bool bp_t::predict(uint64_t seq_no, uint8_t piece, InstClass inst_class, uint64_
       }
       else
       {
+         PROFILE_SCOPE(Indirect);
          // Make prediction.
          pred_target= ITTAGE->GetPrediction (pc);
 
@@ -206,26 +209,145 @@ void bp_t::update_cycles_on_wrong_path(const uint64_t cycles_on_wrong_path)
     meas_cycles_on_wrong_path_per_epoch.back() += cycles_on_wrong_path;
 }
 
+// Drops all per-epoch measurements; the caller begins a new first epoch.
+void bp_t::reset_measurements()
+{
+   meas_conddir_n_per_epoch.clear();
+   meas_conddir_m_per_epoch.clear();
+   meas_jumpdir_n_per_epoch.clear();
+   meas_jumpind_n_per_epoch.clear();
+   meas_jumpind_m_per_epoch.clear();
+   meas_jumpret_n_per_epoch.clear();
+   meas_jumpret_m_per_epoch.clear();
+   meas_notctrl_n_per_epoch.clear();
+   meas_notctrl_m_per_epoch.clear();
+   meas_cycles_on_wrong_path_per_epoch.clear();
+}
+
+static uint64_t sum_epochs(const std::vector<uint64_t>& v)
+{
+   return std::accumulate(v.begin(), v.end(), (uint64_t)0);
+}
+
+uint64_t bp_t::num_cond_mispredicts() const
+{
+   return sum_epochs(meas_conddir_m_per_epoch);
+}
+
+void bp_t::register_stats(stats_t& s)
+{
+   s.counter("bp.conddir.count", [this]() { return sum_epochs(meas_conddir_n_per_epoch); });
+   s.counter("bp.conddir.mispredicts", [this]() { return sum_epochs(meas_conddir_m_per_epoch); });
+   s.counter("bp.jumpdir.count", [this]() { return sum_epochs(meas_jumpdir_n_per_epoch); });
+   s.counter("bp.jumpind.count", [this]() { return sum_epochs(meas_jumpind_n_per_epoch); });
+   s.counter("bp.jumpind.mispredicts", [this]() { return sum_epochs(meas_jumpind_m_per_epoch); });
+   s.counter("bp.jumpret.count", [this]() { return sum_epochs(meas_jumpret_n_per_epoch); });
+   s.counter("bp.jumpret.mispredicts", [this]() { return sum_epochs(meas_jumpret_m_per_epoch); });
+   s.counter("bp.notctrl.count", [this]() { return sum_epochs(meas_notctrl_n_per_epoch); });
+   s.counter("bp.notctrl.mispredicts", [this]() { return sum_epochs(meas_notctrl_m_per_epoch); });
+
+   s.ratio("bp.conddir.mr", "bp.conddir.mispredicts", "bp.conddir.count");
+   s.ratio("bp.conddir.mpki", "bp.conddir.mispredicts", "instructions", 1000.0);
+   s.ratio("bp.jumpind.mpki", "bp.jumpind.mispredicts", "instructions", 1000.0);
+   s.ratio("bp.jumpret.mpki", "bp.jumpret.mispredicts", "instructions", 1000.0);
+}
+
+// The same columns as the text tables, under window.<Last10M|Last25M|50Perc|Full>.<column>.
+void bp_t::register_window_stats(stats_t& s, const std::vector<uint64_t>&num_insts_per_epoch, const std::vector<uint64_t>&num_cycles_per_epoch)
+{
+   const std::vector<uint64_t> *insts = &num_insts_per_epoch;
+   const std::vector<uint64_t> *cycles = &num_cycles_per_epoch;
+
+   struct target_t {
+      const char *name;
+      std::function<uint64_t()> instr_count;
+   };
+   const target_t targets[] = {
+      {"Last10M", []() { return (uint64_t)10000000; }},
+      {"Last25M", []() { return (uint64_t)25000000; }},
+      {"50Perc",  [insts]() { return sum_epochs(*insts)/2; }},
+      {"Full",    [insts]() { return sum_epochs(*insts); }},
+   };
+
+   for (const target_t& t : targets)
+   {
+      auto window = [this, insts, cycles, t]() { return sum_last_epochs(t.instr_count(), *insts, *cycles); };
+      const std::string prefix = std::string("window.") + t.name + ".";
+      s.summary(prefix + "Instr",        [window]() { return (double)window().instr; });
+      s.summary(prefix + "Cycles",       [window]() { return (double)window().cycles; });
+      s.summary(prefix + "IPC",          [window]() { bp_window_t w = window(); return (double)w.instr/(double)w.cycles; });
+      s.summary(prefix + "NumBr",        [window]() { return (double)window().br; });
+      s.summary(prefix + "MispBr",       [window]() { return (double)window().misp; });
+      s.summary(prefix + "BrPerCyc",     [window]() { bp_window_t w = window(); return (double)w.br/(double)w.cycles; });
+      s.summary(prefix + "MispBrPerCyc", [window]() { bp_window_t w = window(); return (double)w.misp/(double)w.cycles; });
+      s.summary(prefix + "MR",           [window]() { bp_window_t w = window(); return 100.0*(double)w.misp/(double)w.br; });
+      s.summary(prefix + "MPKI",         [window]() { bp_window_t w = window(); return 1000.0*(double)w.misp/(double)w.instr; });
+      s.summary(prefix + "CycWP",        [window]() { return (double)window().cyc_wp; });
+      s.summary(prefix + "CycWPAvg",     [window]() { bp_window_t w = window(); return (w.misp == 0) ? 0.0 : (double)w.cyc_wp/(double)w.misp; });
+      s.summary(prefix + "CycWPPKI",     [window]() { bp_window_t w = window(); return (double)w.cyc_wp*1000/(double)w.instr; });
+   }
+}
+
+// One entry per epoch in each of the per-epoch measurement vectors (-m).
+void bp_t::register_memory(memstats_t& m)
+{
+   m.track("bp.per_epoch_vectors", [this]() {
+      const std::vector<uint64_t> *vectors[] = {
+         &meas_conddir_n_per_epoch, &meas_conddir_m_per_epoch, &meas_jumpdir_n_per_epoch,
+         &meas_jumpind_n_per_epoch, &meas_jumpind_m_per_epoch, &meas_jumpret_n_per_epoch,
+         &meas_jumpret_m_per_epoch, &meas_notctrl_n_per_epoch, &meas_notctrl_m_per_epoch,
+         &meas_cycles_on_wrong_path_per_epoch,
+      };
+      mem_usage_t u = {0, 0};
+      for (const std::vector<uint64_t> *v : vectors)
+         u += mem_usage(*v);
+      return u;
+   });
+}
+
+void bp_t::checkpoint(ckpt_t& c)
+{
+    c.io(mispred_correction_seed);
+
+    c.io(meas_conddir_n_per_epoch);
+    c.io(meas_conddir_m_per_epoch);
+    c.io(meas_jumpdir_n_per_epoch);
+    c.io(meas_jumpind_n_per_epoch);
+    c.io(meas_jumpind_m_per_epoch);
+    c.io(meas_jumpret_n_per_epoch);
+    c.io(meas_jumpret_m_per_epoch);
+    c.io(meas_notctrl_n_per_epoch);
+    c.io(meas_notctrl_m_per_epoch);
+    c.io(meas_cycles_on_wrong_path_per_epoch);
+
+    // ITTAGE only exists when indirect prediction is not perfect; the parameter
+    // fingerprint guarantees both runs agree on that.
+    if(ITTAGE)
+    {
+        ITTAGE->checkpoint(c);
+    }
+}
+
 #define BP_OUTPUT(str, n, m, i) \
     fprintf(files.result,"%s%10ld %10ld %8.4lf%% %8.4lf\n", (str), (n), (m), 100.0*((double)(m)/(double)(n)), 1000.0*((double)(m)/(double)(i)))
 
 void bp_t::output(const uint64_t num_inst)
 {
-   const uint64_t meas_conddir_n = std::accumulate(meas_conddir_n_per_epoch.begin(), meas_conddir_n_per_epoch.end(), 0);    // # conditional branches
-   const uint64_t meas_conddir_m = std::accumulate(meas_conddir_m_per_epoch.begin(), meas_conddir_m_per_epoch.end(), 0);    // # mispredicted conditional branches
+   const uint64_t meas_conddir_n = sum_epochs(meas_conddir_n_per_epoch);    // # conditional branches
+   const uint64_t meas_conddir_m = sum_epochs(meas_conddir_m_per_epoch);    // # mispredicted conditional branches
                                    
-   const uint64_t meas_jumpdir_n = std::accumulate(meas_jumpdir_n_per_epoch.begin(), meas_jumpdir_n_per_epoch.end(), 0);    // # jumps, direct
+   const uint64_t meas_jumpdir_n = sum_epochs(meas_jumpdir_n_per_epoch);    // # jumps, direct
                                    
-   const uint64_t meas_jumpind_n = std::accumulate(meas_jumpind_n_per_epoch.begin(), meas_jumpind_n_per_epoch.end(), 0);    // # jumps, indirect
-   const uint64_t meas_jumpind_m = std::accumulate(meas_jumpind_m_per_epoch.begin(), meas_jumpind_m_per_epoch.end(), 0);    // # mispredicted jumps, indirect
+   const uint64_t meas_jumpind_n = sum_epochs(meas_jumpind_n_per_epoch);    // # jumps, indirect
+   const uint64_t meas_jumpind_m = sum_epochs(meas_jumpind_m_per_epoch);    // # mispredicted jumps, indirect
                                    
-   const uint64_t meas_jumpret_n = std::accumulate(meas_jumpret_n_per_epoch.begin(), meas_jumpret_n_per_epoch.end(), 0);    // # jumps, return
-   const uint64_t meas_jumpret_m = std::accumulate(meas_jumpret_m_per_epoch.begin(), meas_jumpret_m_per_epoch.end(), 0);    // # mispredicted jumps, return
+   const uint64_t meas_jumpret_n = sum_epochs(meas_jumpret_n_per_epoch);    // # jumps, return
+   const uint64_t meas_jumpret_m = sum_epochs(meas_jumpret_m_per_epoch);    // # mispredicted jumps, return
                                    
-   const uint64_t meas_notctrl_n = std::accumulate(meas_notctrl_n_per_epoch.begin(), meas_notctrl_n_per_epoch.end(), 0);    // # non-control transfer instructions
-   const uint64_t meas_notctrl_m = std::accumulate(meas_notctrl_m_per_epoch.begin(), meas_notctrl_m_per_epoch.end(), 0);    // # non-control transfer instructions for which: next_pc != pc + 4
+   const uint64_t meas_notctrl_n = sum_epochs(meas_notctrl_n_per_epoch);    // # non-control transfer instructions
+   const uint64_t meas_notctrl_m = sum_epochs(meas_notctrl_m_per_epoch);    // # non-control transfer instructions for which: next_pc != pc + 4
 
-   //const uint64_t meas_cycles_on_wrong_path = std::accumulate(meas_cycles_on_wrong_path_per_epoch.begin(), meas_cycles_on_wrong_path_per_epoch.end(), 0);
+   //const uint64_t meas_cycles_on_wrong_path = sum_epochs(meas_cycles_on_wrong_path_per_epoch);
 
    //uint64_t num_misp = (meas_conddir_m + meas_jumpind_m + meas_jumpret_m + meas_notctrl_m);
    fprintf(files.result,"\n-----------------------------------------------BRANCH PREDICTION MEASUREMENTS (Full Simulation i.e. Counts Not Reset When Warmup Ends)----------------------------------------------\n");
@@ -239,6 +361,31 @@ void bp_t::output(const uint64_t num_inst)
    fprintf(files.result,"------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
 }
 
+bp_window_t bp_t::sum_last_epochs(const uint64_t target_instr_count, const std::vector<uint64_t>&num_insts_per_epoch, const std::vector<uint64_t>&num_cycles_per_epoch) const
+{
+   bp_window_t w = {0, 0, 0, 0, 0};
+   for(int epoch_index = num_insts_per_epoch.size() -1; epoch_index >= 0; epoch_index--)
+   {
+        w.instr   += num_insts_per_epoch.at(epoch_index);
+        w.cycles  += num_cycles_per_epoch.at(epoch_index);
+        w.br      += meas_conddir_n_per_epoch.at(epoch_index);
+        w.misp    += meas_conddir_m_per_epoch.at(epoch_index);
+        w.cyc_wp  += meas_cycles_on_wrong_path_per_epoch.at(epoch_index);
+        if(w.instr > target_instr_count)
+        {
+            break;
+        }
+   }
+   return w;
+}
+
+static void print_window_row(const bp_window_t& w)
+{
+   const double cyc_wp_avg =  (w.misp == 0) ? 0.00 : (double)w.cyc_wp/(double)w.misp;
+   const double cyc_wp_pki =  (double)w.cyc_wp*1000/(double)w.instr;
+   fprintf(files.result,"%12ld %12ld %8.4f %10ld %10ld %8.4lf %12.4lf %8.4lf%% %8.4lf %10ld %10.4lf %10.4lf\n", w.instr, w.cycles, (double)w.instr/(double)w.cycles, w.br, w.misp, (double)(w.br)/(double)(w.cycles), (double)(w.misp)/(double)(w.cycles), 100.0*((double)(w.misp)/(double)(w.br)), 1000.0*((double)(w.misp)/(double)(w.instr)), w.cyc_wp, cyc_wp_avg, cyc_wp_pki);
+}
+
 void bp_t::output_periodic_info(const std::vector<uint64_t>&num_insts_per_epoch, const std::vector<uint64_t>&num_cycles_per_epoch)
 {
    assert(num_insts_per_epoch.size() == num_cycles_per_epoch.size());
@@ -247,26 +394,7 @@ void bp_t::output_periodic_info(const std::vector<uint64_t>&num_insts_per_epoch,
       const uint64_t target_instr_count = 10000000;
       fprintf(files.result,"\n------------------------------------------------------DIRECT CONDITIONAL BRANCH PREDICTION MEASUREMENTS (Last 10M instructions)-----------------------------------------------------\n");
       fprintf(files.result,"       Instr       Cycles      IPC      NumBr     MispBr BrPerCyc MispBrPerCyc        MR     MPKI      CycWP   CycWPAvg   CycWPPKI\n");
-      uint64_t my_instr_count = 0;
-      uint64_t my_cycle_count = 0;
-      uint64_t my_br_count = 0;
-      uint64_t my_br_mispred_count = 0;
-      uint64_t my_wpc_count = 0;
-      for(int epoch_index = num_insts_per_epoch.size() -1; epoch_index >= 0; epoch_index--)
-      {
-           my_instr_count       += num_insts_per_epoch.at(epoch_index);
-           my_cycle_count       += num_cycles_per_epoch.at(epoch_index);
-           my_br_count          += meas_conddir_n_per_epoch.at(epoch_index);
-           my_br_mispred_count  += meas_conddir_m_per_epoch.at(epoch_index);
-           my_wpc_count         += meas_cycles_on_wrong_path_per_epoch.at(epoch_index);
-           if(my_instr_count > target_instr_count)
-           {
-               break;
-           }
-      }
-      const double cyc_wp_avg =  (my_br_mispred_count == 0) ? 0.00 : (double)my_wpc_count/(double)my_br_mispred_count;
-      const double cyc_wp_pki =  (double)my_wpc_count*1000/(double)my_instr_count;
-      fprintf(files.result,"%12ld %12ld %8.4f %10ld %10ld %8.4lf %12.4lf %8.4lf%% %8.4lf %10ld %10.4lf %10.4lf\n", my_instr_count, my_cycle_count, (double)my_instr_count/(double)my_cycle_count, my_br_count, my_br_mispred_count, (double)(my_br_count)/(double)(my_cycle_count), (double)(my_br_mispred_count)/(double)(my_cycle_count), 100.0*((double)(my_br_mispred_count)/(double)(my_br_count)), 1000.0*((double)(my_br_mispred_count)/(double)(my_instr_count)), my_wpc_count, cyc_wp_avg, cyc_wp_pki);
+      print_window_row(sum_last_epochs(target_instr_count, num_insts_per_epoch, num_cycles_per_epoch));
       fprintf(files.result,"------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
    }
 
@@ -274,82 +402,25 @@ void bp_t::output_periodic_info(const std::vector<uint64_t>&num_insts_per_epoch,
       const uint64_t target_instr_count = 25000000;
       fprintf(files.result,"\n------------------------------------------------------DIRECT CONDITIONAL BRANCH PREDICTION MEASUREMENTS (Last 25M instructions)-----------------------------------------------------\n");
       fprintf(files.result,"       Instr       Cycles      IPC      NumBr     MispBr BrPerCyc MispBrPerCyc        MR     MPKI      CycWP   CycWPAvg   CycWPPKI\n");
-      uint64_t my_instr_count = 0;
-      uint64_t my_cycle_count = 0;
-      uint64_t my_br_count = 0;
-      uint64_t my_br_mispred_count = 0;
-      uint64_t my_wpc_count = 0;
-      for(int epoch_index = num_insts_per_epoch.size() -1; epoch_index >= 0; epoch_index--)
-      {
-           my_instr_count       += num_insts_per_epoch.at(epoch_index);
-           my_cycle_count       += num_cycles_per_epoch.at(epoch_index);
-           my_br_count          += meas_conddir_n_per_epoch.at(epoch_index);
-           my_br_mispred_count  += meas_conddir_m_per_epoch.at(epoch_index);
-           my_wpc_count         += meas_cycles_on_wrong_path_per_epoch.at(epoch_index);
-           if(my_instr_count > target_instr_count)
-           {
-               break;
-           }
-      }
-      const double cyc_wp_avg =  (my_br_mispred_count == 0) ? 0.00 : (double)my_wpc_count/(double)my_br_mispred_count;
-      const double cyc_wp_pki =  (double)my_wpc_count*1000/(double)my_instr_count;
-      fprintf(files.result,"%12ld %12ld %8.4f %10ld %10ld %8.4lf %12.4lf %8.4lf%% %8.4lf %10ld %10.4lf %10.4lf\n", my_instr_count, my_cycle_count, (double)my_instr_count/(double)my_cycle_count, my_br_count, my_br_mispred_count, (double)(my_br_count)/(double)(my_cycle_count), (double)(my_br_mispred_count)/(double)(my_cycle_count), 100.0*((double)(my_br_mispred_count)/(double)(my_br_count)), 1000.0*((double)(my_br_mispred_count)/(double)(my_instr_count)), my_wpc_count, cyc_wp_avg, cyc_wp_pki);
+      print_window_row(sum_last_epochs(target_instr_count, num_insts_per_epoch, num_cycles_per_epoch));
       fprintf(files.result,"-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
    }
 
-   const uint64_t total_instr = std::accumulate(num_insts_per_epoch.begin(), num_insts_per_epoch.end(), 0); // # mispredicted jumps, return
+   const uint64_t total_instr = sum_epochs(num_insts_per_epoch); // # mispredicted jumps, return
    {
       const uint64_t target_instr_count = total_instr/2;
       fprintf(files.result,"\n---------------------------------------------------------DIRECT CONDITIONAL BRANCH PREDICTION MEASUREMENTS (50 Perc instructions)---------------------------------------------------\n");
       fprintf(files.result,"       Instr       Cycles      IPC      NumBr     MispBr BrPerCyc MispBrPerCyc        MR     MPKI      CycWP   CycWPAvg   CycWPPKI\n");
-      uint64_t my_instr_count = 0;
-      uint64_t my_cycle_count = 0;
-      uint64_t my_br_count = 0;
-      uint64_t my_br_mispred_count = 0;
-      uint64_t my_wpc_count = 0;
-      for(int epoch_index = num_insts_per_epoch.size() -1; epoch_index >= 0; epoch_index--)
-      {
-           my_instr_count       += num_insts_per_epoch.at(epoch_index);
-           my_cycle_count       += num_cycles_per_epoch.at(epoch_index);
-           my_br_count          += meas_conddir_n_per_epoch.at(epoch_index);
-           my_br_mispred_count  += meas_conddir_m_per_epoch.at(epoch_index);
-           my_wpc_count         += meas_cycles_on_wrong_path_per_epoch.at(epoch_index);
-           if(my_instr_count > target_instr_count)
-           {
-               break;
-           }
-      }
-      const double cyc_wp_avg =  (my_br_mispred_count == 0) ? 0.00 : (double)my_wpc_count/(double)my_br_mispred_count;
-      const double cyc_wp_pki =  (double)my_wpc_count*1000/(double)my_instr_count;
-      fprintf(files.result,"%12ld %12ld %8.4f %10ld %10ld %8.4lf %12.4lf %8.4lf%% %8.4lf %10ld %10.4lf %10.4lf\n", my_instr_count, my_cycle_count, (double)my_instr_count/(double)my_cycle_count, my_br_count, my_br_mispred_count, (double)(my_br_count)/(double)(my_cycle_count), (double)(my_br_mispred_count)/(double)(my_cycle_count), 100.0*((double)(my_br_mispred_count)/(double)(my_br_count)), 1000.0*((double)(my_br_mispred_count)/(double)(my_instr_count)), my_wpc_count, cyc_wp_avg, cyc_wp_pki);
+      print_window_row(sum_last_epochs(target_instr_count, num_insts_per_epoch, num_cycles_per_epoch));
       fprintf(files.result,"------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
    }
 
    {
-      const uint64_t total_instr = std::accumulate(num_insts_per_epoch.begin(), num_insts_per_epoch.end(), 0);  // # mispredicted jumps, return
+      const uint64_t total_instr = sum_epochs(num_insts_per_epoch);  // # mispredicted jumps, return
       const uint64_t target_instr_count = total_instr;
       fprintf(files.result,"\n-------------------------------------DIRECT CONDITIONAL BRANCH PREDICTION MEASUREMENTS (Full Simulation i.e. Counts Not Reset When Warmup Ends)-------------------------------------\n");
       fprintf(files.result,"       Instr       Cycles      IPC      NumBr     MispBr BrPerCyc MispBrPerCyc        MR     MPKI      CycWP   CycWPAvg   CycWPPKI\n");
-      uint64_t my_instr_count = 0;
-      uint64_t my_cycle_count = 0;
-      uint64_t my_br_count = 0;
-      uint64_t my_br_mispred_count = 0;
-      uint64_t my_wpc_count = 0;
-      for(int epoch_index = num_insts_per_epoch.size() -1; epoch_index >= 0; epoch_index--)
-      {
-           my_instr_count       += num_insts_per_epoch.at(epoch_index);
-           my_cycle_count       += num_cycles_per_epoch.at(epoch_index);
-           my_br_count          += meas_conddir_n_per_epoch.at(epoch_index);
-           my_br_mispred_count  += meas_conddir_m_per_epoch.at(epoch_index);
-           my_wpc_count         += meas_cycles_on_wrong_path_per_epoch.at(epoch_index);
-           if(my_instr_count > target_instr_count)
-           {
-               break;
-           }
-      }
-      const double cyc_wp_avg =  (my_br_mispred_count == 0) ? 0.00 : (double)my_wpc_count/(double)my_br_mispred_count;
-      const double cyc_wp_pki =  (double)my_wpc_count*1000/(double)my_instr_count;
-      fprintf(files.result,"%12ld %12ld %8.4f %10ld %10ld %8.4lf %12.4lf %8.4lf%% %8.4lf %10ld %10.4lf %10.4lf\n", my_instr_count, my_cycle_count, (double)my_instr_count/(double)my_cycle_count, my_br_count, my_br_mispred_count, (double)(my_br_count)/(double)(my_cycle_count), (double)(my_br_mispred_count)/(double)(my_cycle_count), 100.0*((double)(my_br_mispred_count)/(double)(my_br_count)), 1000.0*((double)(my_br_mispred_count)/(double)(my_instr_count)), my_wpc_count, cyc_wp_avg, cyc_wp_pki);
+      print_window_row(sum_last_epochs(target_instr_count, num_insts_per_epoch, num_cycles_per_epoch));
       fprintf(files.result,"------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
    }
 
@@ -24,6 +24,19 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ittage.h"
 
+class stats_t;
+class memstats_t;
+
+// Conditional-branch totals over the most recent epochs covering more than a target
+// number of instructions (the "Last 10M", "50 Perc", ... tables).
+struct bp_window_t {
+    uint64_t instr;
+    uint64_t cycles;
+    uint64_t br;
+    uint64_t misp;
+    uint64_t cyc_wp;
+};
+
 class ras_t {
 private:
     uint64_t *ras;
@@ -111,5 +124,14 @@ public:
     void output_periodic_info(const std::vector<uint64_t>&num_insts_per_epoch, const std::vector<uint64_t>&num_cycles_per_epoch);
     void notify_begin_new_epoch();
     void update_cycles_on_wrong_path(const uint64_t cycles_on_wrong_path);
+    void reset_measurements();
+    void checkpoint(ckpt_t& c);
+
+    uint64_t num_cond_mispredicts() const;
+    bp_window_t sum_last_epochs(const uint64_t target_instr_count, const std::vector<uint64_t>&num_insts_per_epoch, const std::vector<uint64_t>&num_cycles_per_epoch) const;
+    // Counters are registered after the "instructions" counter of the owning simulator.
+    void register_stats(stats_t& s);
+    void register_window_stats(stats_t& s, const std::vector<uint64_t>&num_insts_per_epoch, const std::vector<uint64_t>&num_cycles_per_epoch);
+    void register_memory(memstats_t& m);
 };
 
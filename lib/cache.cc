@@ -26,11 +26,50 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <assert.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include "parameters.h"
 #include "cache.h"
+#include "checkpoint.h"
+#include "stats.h"
+#include "profiler.h"
+#include "hugepage.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define CACHE_SIMD_WAYS 4lu
+#elif defined(__SSE2__)
+#define CACHE_SIMD_WAYS 2lu
+#else
+#define CACHE_SIMD_WAYS 1lu
+#endif
+
+
+const char *repl_policy_name(repl_policy_t p) {
+   switch (p) {
+   case repl_policy_t::LRU:    return "lru";
+   case repl_policy_t::PLRU:   return "plru";
+   case repl_policy_t::SRRIP:  return "srrip";
+   case repl_policy_t::BRRIP:  return "brrip";
+   case repl_policy_t::Random: return "random";
+   }
+   return "?";
+}
 
+bool parse_repl_policy(const char *name, repl_policy_t& p) {
+   for (repl_policy_t q : {repl_policy_t::LRU, repl_policy_t::PLRU, repl_policy_t::SRRIP, repl_policy_t::BRRIP, repl_policy_t::Random}) {
+      if (!strcmp(name, repl_policy_name(q))) {
+         p = q;
+         return true;
+      }
+   }
+   return false;
+}
 
-cache_t::cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_t *next_level) {
+cache_base_t::cache_base_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_base_t *next_level,
+                           uint64_t sample_bits, bool sample_validate) {
    uint64_t num_sets;
 
    assert(IsPow2(blocksize));
@@ -43,104 +82,354 @@ cache_t::cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t lat
 
    this->assoc = assoc;
 
-   C = new block_t *[num_sets];
+   assert((num_index_bits + num_offset_bits) > 0);   // keeps TAG() below INVALID_TAG
+
+   if (sample_bits > num_index_bits) {
+      fprintf(stderr, "Set sampling: 1/%lu of the sets of a %lu-set cache is less than one set.\n", 1lu << sample_bits, num_sets);
+      exit(EXIT_FAILURE);
+   }
+   this->sample_bits = sample_bits;
+   this->num_sampled_sets = num_sets >> sample_bits;
+   this->sample_window = std::max(64lu, SAMPLE_SPAN >> sample_bits);
+   this->sample_validate = sample_validate && sample_bits;
+   memset(inference, 0, sizeof(inference));
+   memset(group_accesses, 0, sizeof(group_accesses));
+   memset(group_misses, 0, sizeof(group_misses));
+   sampled_mode_misses = 0;
+   inferred_misses = 0;
+   max_promoted_sets = std::min(num_sampled_sets, num_sets - num_sampled_sets);
+   num_promoted_sets = 0;
+   num_hot_sets = 0;
+   inferred_accesses = 0;
+   promoted_accesses = 0;
+   if (sample_bits) {
+      // The first num_sampled_sets sets of a seeded Fisher-Yates shuffle: unlike a fixed
+      // pattern of indices, no stride lines up with them.
+      std::vector<uint32_t> order(num_sets);
+      for (uint64_t i = 0; i < num_sets; i++)
+         order[i] = i;
+      repl_rng_t rng;
+      for (uint64_t i = 0; i < num_sampled_sets; i++)
+         std::swap(order[i], order[i + rng.next() % (num_sets - i)]);
+      sample_slot.assign(num_sets, UNSAMPLED);
+      for (uint64_t i = 0; i < num_sampled_sets; i++)
+         sample_slot[order[i]] = i;
+      set_accesses.assign(num_sets, 0);
+   }
+   num_sets = num_stored_sets();
+
+   tag_stride = (assoc + CACHE_SIMD_WAYS - 1) & ~(CACHE_SIMD_WAYS - 1);
+   const uint64_t tags_bytes = (num_sets * tag_stride * sizeof(uint64_t) + 63) & ~63lu;
+   storage = table_alloc(tags_bytes + num_sets * assoc * sizeof(uint64_t));
+   tags = (uint64_t *)storage;
+   timestamps = (uint64_t *)((char *)storage + tags_bytes);
+
    for (uint64_t i = 0; i < num_sets; i++) {
-      C[i] = new block_t[assoc];
-      for (uint64_t j = 0; j < assoc; j++) {
-         C[i][j].valid = false;
-     C[i][j].lru = j;
-      }
+      for (uint64_t j = 0; j < tag_stride; j++)
+         tags[i * tag_stride + j] = INVALID_TAG;
+      for (uint64_t j = 0; j < assoc; j++)
+         timestamps[i * assoc + j] = 0;
    }
 
    this->latency = latency;
    this->next_level = next_level;
 
+   last_block = INVALID_TAG;
+   last_index = 0;
+   last_way = 0;
+
    accesses = 0;
+   pf_accesses = 0;
    misses = 0;
+   pf_misses = 0;
+   filter_hits = 0;
+}
+
+cache_base_t::~cache_base_t() {
+   table_free(storage);
+}
+
+template <class Replacement>
+cache_t<Replacement>::cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_base_t *next_level,
+                              uint64_t sample_bits, bool sample_validate)
+   : cache_base_t(size, assoc, blocksize, latency, next_level, sample_bits, sample_validate) {
+   repl.init(num_stored_sets(), assoc);
+   next_same = dynamic_cast<cache_t *>(next_level);
+
+   uint64_t same_levels = 1;
+   for (cache_t *c = next_same; c; c = c->next_same)
+      same_levels++;
+   assert(same_levels <= CACHE_MAX_LEVELS);
+}
+
+// Way of set index that holds tag, or assoc (or more) if none. Compares CACHE_SIMD_WAYS
+// tags at a time; the padding ways hold INVALID_TAG and never match a valid tag.
+inline uint64_t cache_base_t::find_way(uint64_t index, uint64_t tag) const {
+   const uint64_t *t = &tags[index * tag_stride];
+#if defined(__AVX2__)
+   const __m256i key = _mm256_set1_epi64x(tag);
+   for (uint64_t way = 0; way < assoc; way += 4) {
+      const __m256i eq = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i *)(t + way)), key);
+      if (const int m = _mm256_movemask_pd(_mm256_castsi256_pd(eq)))
+         return way + __builtin_ctz(m);
+   }
+#elif defined(__SSE2__)
+   // No 64-bit compare in SSE2: both 32-bit halves must match.
+   const __m128i key = _mm_set1_epi64x(tag);
+   for (uint64_t way = 0; way < assoc; way += 2) {
+      __m128i eq = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)(t + way)), key);
+      eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+      if (const int m = _mm_movemask_pd(_mm_castsi128_pd(eq)))
+         return way + __builtin_ctz(m);
+   }
+#else
+   for (uint64_t way = 0; way < assoc; way++)
+      if (t[way] == tag)
+         return way;
+#endif
+   return assoc;
+}
+
+// Set sampling: an access to a set that is not hot (yet), whose sample_slot is slot.
+// Its sample_slot after the access, which may make it hot.
+uint32_t cache_base_t::count_access(uint64_t index, uint32_t slot, bool pf) {
+   const uint64_t threshold = std::max(HOT_MIN_ACCESSES, (HOT_FACTOR * accesses) >> num_index_bits);
+   set_accesses[index] += !pf;
+   if (set_accesses[index] < threshold)
+      return slot;
+   if (slot == UNSAMPLED) {
+      if (num_promoted_sets == max_promoted_sets)
+         return slot;
+      promoted_accesses += set_accesses[index] - !pf;
+      slot = num_sampled_sets + num_promoted_sets++;
+   }
+   num_hot_sets++;
+   sample_slot[index] = slot | HOT;
+   return sample_slot[index];
+}
+
+// Set sampling: whether an access to a set that is not simulated misses.
+bool cache_base_t::infer_miss(bool pf) {
+   inference_t& f = inference[pf];
+   f.credit += f.accesses ? ((f.misses << 32) / f.accesses) : (1lu << 32);
+   if (f.credit < (1lu << 32))
+      return false;
+   f.credit -= (1lu << 32);
+   return true;
+}
+
+// Set sampling: an access to a simulated set or, with sample_validate, to any other set
+// (UNSAMPLED), once its outcome is known.
+void cache_base_t::sample(uint32_t slot, bool pf, bool miss) {
+   if (slot == UNSAMPLED) {
+      const bool inferred = infer_miss(pf);
+      inferred_accesses += !pf;
+      sampled_mode_misses += (inferred && !pf);
+      inferred_misses += (miss && !pf);
+      return;
+   }
+   sampled_mode_misses += (miss && !pf);
+   if (slot & HOT)   // simulated, but not part of the sample
+      return;
+
+   inference_t& f = inference[pf];
+   f.accesses++;
+   f.misses += miss;
+   if (f.accesses == sample_window) {
+      f.accesses /= 2;
+      f.misses /= 2;
+   }
+   if (!pf) {
+      group_accesses[slot % SAMPLE_GROUPS]++;
+      group_misses[slot % SAMPLE_GROUPS] += miss;
+   }
+}
+
+// The random sample's demand miss ratio.
+double cache_base_t::sample_miss_ratio() const {
+   uint64_t a = 0, m = 0;
+   for (uint64_t g = 0; g < SAMPLE_GROUPS; g++) {
+      a += group_accesses[g];
+      m += group_misses[g];
+   }
+   return a ? ((double)m / a) : 1.0;
 }
 
-cache_t::~cache_t() {
+// Error bound of the (sampled mode's) demand miss ratio. Only the inferred accesses are
+// uncertain: those to a set before it turned hot, which the sample does not represent,
+// at worst all wrong; the others as uncertain as the sample's miss ratio is as an
+// estimate of theirs, 2 standard errors. For those, the sample is split into (up to)
+// SAMPLE_GROUPS groups of sets, and the spread of the groups' miss ratios (ratio
+// estimator over cluster samples) gives its variance, with the finite population
+// correction for the fraction of sets sampled.
+double cache_base_t::sampling_error() const {
+   const uint64_t groups = std::min(SAMPLE_GROUPS, num_sampled_sets);
+   uint64_t a = 0;
+   for (uint64_t g = 0; g < groups; g++)
+      a += group_accesses[g];
+   if (inferred_accesses == 0)
+      return 0.0;
+   if ((groups < 2) || (a == 0))
+      return 1.0;
+   const double r = sample_miss_ratio();
+   double sum = 0.0;
+   for (uint64_t g = 0; g < groups; g++) {
+      const double d = group_misses[g] - r * group_accesses[g];
+      sum += d * d;
+   }
+   const double var = (1.0 - 1.0 / (1lu << sample_bits)) * sum * groups / (groups - 1) / ((double)a * a);
+   return (2.0 * sqrt(var) * (inferred_accesses - promoted_accesses) + promoted_accesses) / accesses;
 }
 
-bool cache_t::is_hit(uint64_t cycle, uint64_t addr) const {
+bool cache_base_t::is_hit(uint64_t cycle, uint64_t addr) const {
+   PROFILE_SCOPE(Cache);
    uint64_t tag = TAG(addr);
    uint64_t index = INDEX(addr);
+   if (sample_bits && !sample_validate) {
+      if (sample_slot[index] == UNSAMPLED)
+         return false;
+      index = sample_slot[index] & ~HOT;
+   }
 
-   for (uint64_t way = 0; way < assoc; way++) {
-      if (C[index][way].valid && (C[index][way].tag == tag)) {
-         auto avail = ((C[index][way].timestamp > (cycle + latency)) ? C[index][way].timestamp : (cycle + latency));
-         return (cycle + latency >= avail);
-      }
+   uint64_t way = find_way(index, tag);
+   if (way < assoc) {
+      auto avail = ((timestamps[index * assoc + way] > (cycle + latency)) ? timestamps[index * assoc + way] : (cycle + latency));
+      return (cycle + latency >= avail);
    }
 
    return false;
 }
 
-uint64_t cache_t::access(uint64_t cycle, bool read, uint64_t addr, bool pf) {
-   uint64_t avail;      // return value: cycle that requested block is available
+// One level of lookup(): on a hit, the cycle the block is available and the replacement
+// update; on a miss, the victim way, filled by fill() once the availability is known.
+template <class Replacement>
+inline bool cache_t<Replacement>::probe(uint64_t cycle, uint64_t addr, bool pf, uint64_t& avail, pending_fill_t& miss) {
+   if (sample_bits)
+      return probe_sampled(cycle, addr, pf, avail, miss);
+   return probe_set(INDEX(addr), cycle, addr, pf, avail, miss);
+}
+
+// probe() in the set stored at index.
+template <class Replacement>
+inline bool cache_t<Replacement>::probe_set(uint64_t index, uint64_t cycle, uint64_t addr, bool pf, uint64_t& avail, pending_fill_t& miss) {
    uint64_t tag = TAG(addr);
-   uint64_t index = INDEX(addr);
-   bool hit = false;
-   uint64_t way;        // if hit, this is the corresponding way
-   uint64_t max_lru_ctr = 0;    // for finding lru block
-   uint64_t victim_way;     // if miss, this is the lru/victim way
+   uint64_t way = find_way(index, tag);   // if hit, this is the corresponding way
 
    accesses+=!pf;
    pf_accesses += pf;
 
-   for (way = 0; way < assoc; way++)
-   {
-      if (C[index][way].valid && (C[index][way].tag == tag))
-      {
-         hit = true;
-         break;
-      }
-      else if (C[index][way].lru >= max_lru_ctr)
-      {
-         max_lru_ctr = C[index][way].lru;
-         victim_way = way;
-      }
+   if (way < assoc) {   // hit
+      // determine when the requested block will be available
+      const uint64_t ts = timestamps[index * assoc + way];
+      avail = ((ts > (cycle + latency)) ? ts : (cycle + latency));
+
+      repl.hit(index, way);
+      last_block = addr >> num_offset_bits;
+      last_index = index;
+      last_way = way;
+      return true;
    }
 
-   if (hit) {   // hit
-      // determine when the requested block will be available
-      avail = ((C[index][way].timestamp > (cycle + latency)) ? C[index][way].timestamp : (cycle + latency));
+   // miss
+   misses+= !pf;
+   pf_misses += pf;
 
-      update_lru(index, way);   // make "way" the MRU way
-   }
-   else {   // miss
-      misses+= !pf;
-      pf_misses += pf;
+   uint64_t victim_way = Replacement::FILL_INVALID_FIRST ? find_way(index, INVALID_TAG) : assoc;
+   if (victim_way >= assoc)
+      victim_way = repl.victim(index);
 
-      assert(max_lru_ctr == (assoc - 1));
-      assert(victim_way < assoc);
-      
-      // TO DO: model writebacks (evictions of dirty blocks)
+   // TO DO: model writebacks (evictions of dirty blocks)
 
-      // determine when the requested block will be available
-      avail = (next_level ? next_level->access((cycle + latency), read, addr, pf) : (cycle + latency + MAIN_MEMORY_LATENCY));
+   miss = {this, index, victim_way, addr >> num_offset_bits};
+   return false;
+}
 
-      // replace the victim block with the requested block
-      C[index][victim_way].valid = true;
-      C[index][victim_way].tag = tag;
-      C[index][victim_way].timestamp = avail;
-      update_lru(index, victim_way);  // make "victim_way" the MRU way
+// probe() with set sampling, out of the way of the exact levels' probe().
+template <class Replacement>
+bool cache_t<Replacement>::probe_sampled(uint64_t cycle, uint64_t addr, bool pf, uint64_t& avail, pending_fill_t& miss) {
+   uint64_t index = INDEX(addr);
+   uint32_t slot = sample_slot[index];
+   if (!(slot & HOT))
+      slot = count_access(index, slot, pf);
+   if (!sample_validate) {
+      if (slot == UNSAMPLED) {
+         accesses += !pf;
+         pf_accesses += pf;
+         inferred_accesses += !pf;
+         if (!infer_miss(pf)) {
+            avail = cycle + latency;
+            return true;
+         }
+         misses += !pf;
+         pf_misses += pf;
+         miss = {NULL, 0, 0, 0};
+         return false;
+      }
+      index = slot & ~HOT;
    }
+   const bool hit = probe_set(index, cycle, addr, pf, avail, miss);
+   sample(slot, pf, !hit);
+   return hit;
+}
 
-   return(avail);
+// replace the victim block with the requested block
+template <class Replacement>
+inline void cache_t<Replacement>::fill(const pending_fill_t& miss, uint64_t avail) {
+   tags[miss.index * tag_stride + miss.way] = miss.block >> num_index_bits;
+   timestamps[miss.index * assoc + miss.way] = avail;
+   repl.fill(miss.index, miss.way);
+   last_block = miss.block;
+   last_index = miss.index;
+   last_way = miss.way;
 }
 
-void cache_t::update_lru(uint64_t index, uint64_t mru_way) {
-   for (uint64_t way = 0; way < assoc; way++) {
-      if (C[index][way].lru < C[index][mru_way].lru) {
-         C[index][way].lru++;
-         assert(C[index][way].lru < assoc);
+// Walks down the levels with this policy in a loop (a level with another policy is
+// looked up through cache_base_t), then fills the levels that missed bottom-up, in the
+// order a recursive access() would.
+template <class Replacement>
+cache_access_t cache_t<Replacement>::lookup(uint64_t cycle, bool read, uint64_t addr, bool pf) {
+   PROFILE_SCOPE(Cache);
+   cache_access_t result = {0, 0, false};
+   pending_fill_t missed[CACHE_MAX_LEVELS];
+   uint64_t num_missed = 0;
+
+   for (cache_t *c = this; ; ) {
+      if (c->probe(cycle, addr, pf, result.avail, missed[num_missed])) {
+         result.hit = (c == this) && (result.avail == cycle + latency);
+         break;
       }
+      num_missed++;
+      cycle += c->latency;
+      result.level++;
+      if (c->next_same) {
+         c = c->next_same;
+      }
+      else if (c->next_level) {
+         const cache_access_t below = c->next_level->lookup(cycle, read, addr, pf);
+         result.avail = below.avail;
+         result.level += below.level;
+         break;
+      }
+      else {
+         result.avail = cycle + MAIN_MEMORY_LATENCY;
+         break;
+      }
+   }
+
+   while (num_missed > 0) {
+      num_missed--;
+      if (missed[num_missed].cache)
+         missed[num_missed].cache->fill(missed[num_missed], result.avail);
    }
-   C[index][mru_way].lru = 0;
+   return result;
+}
+
+template <class Replacement>
+uint64_t cache_t<Replacement>::access(uint64_t cycle, bool read, uint64_t addr, bool pf) {
+   return lookup(cycle, read, addr, pf).avail;
 }
 
-void cache_t::stats() {
+void cache_base_t::stats() {
    printf("\taccesses   = %lu\n", accesses);
    printf("\tmisses     = %lu\n", misses);
    printf("\tmiss ratio = %.2f%%\n", 100.0*((double)misses/(double)accesses));
@@ -148,3 +437,166 @@ void cache_t::stats() {
    printf("\tpf misses     = %lu\n", pf_misses);
    printf("\tpf miss ratio = %.2f%%\n", 100.0*((double)pf_misses/(double)pf_accesses));
 }
+
+void cache_base_t::filter_stats() {
+   printf("\tline filter hits = %lu\n", filter_hits);
+   printf("\tline filter hit ratio = %.2f%%\n", 100.0*((double)filter_hits/(double)accesses));
+}
+
+void cache_base_t::sampling_stats() {
+   uint64_t a = 0;
+   for (uint64_t g = 0; g < SAMPLE_GROUPS; g++)
+      a += group_accesses[g];
+   printf("\tsampled sets = %lu of %lu (1/%lu), hot sets = %lu (%lu of them outside the sample, at most %lu)%s\n",
+          num_sampled_sets, index_mask + 1, 1lu << sample_bits, num_hot_sets, num_promoted_sets, max_promoted_sets,
+          sample_validate ? ", validation: all sets simulated" : "");
+   printf("\tsampled-set accesses = %lu, miss ratio = %.2f%%\n", a, 100.0*sample_miss_ratio());
+   printf("\tinferred accesses = %lu (%.2f%%)\n", inferred_accesses, 100.0*((double)inferred_accesses/(double)accesses));
+   printf("\tmiss ratio error = +/- %.2f%% (2 standard errors, and the %lu accesses before sets turned hot)\n",
+          100.0*sampling_error(), promoted_accesses);
+   if (sample_validate) {
+      const double exact = (double)misses/(double)accesses;
+      const double estimate = (double)sampled_mode_misses/(double)accesses;
+      printf("\tsampled-mode misses = %lu, miss ratio = %.2f%% (exact %.2f%%, error %+.2f%%, %s the +/- bound)\n",
+             sampled_mode_misses, 100.0*estimate, 100.0*exact, 100.0*(estimate - exact),
+             (fabs(estimate - exact) <= sampling_error()) ? "within" : "outside");
+      printf("\tinferred accesses' exact miss ratio = %.2f%% (sample %.2f%%)\n",
+             100.0*((double)inferred_misses/(double)inferred_accesses), 100.0*sample_miss_ratio());
+   }
+}
+
+void cache_base_t::register_stats(stats_t& s, const std::string& name) {
+   s.counter(name + ".accesses", &accesses);
+   s.counter(name + ".misses", &misses);
+   s.counter(name + ".pf_accesses", &pf_accesses);
+   s.counter(name + ".pf_misses", &pf_misses);
+   s.ratio(name + ".miss_ratio", name + ".misses", name + ".accesses");
+   s.ratio(name + ".pf_miss_ratio", name + ".pf_misses", name + ".pf_accesses");
+}
+
+void cache_base_t::register_filter_stats(stats_t& s, const std::string& name) {
+   s.counter(name + ".filter_hits", &filter_hits);
+   s.ratio(name + ".filter_hit_ratio", name + ".filter_hits", name + ".accesses");
+}
+
+void cache_base_t::register_sampling_stats(stats_t& s, const std::string& name) {
+   s.counter(name + ".sampled_accesses", [this]() {
+      uint64_t a = 0;
+      for (uint64_t g = 0; g < SAMPLE_GROUPS; g++)
+         a += group_accesses[g];
+      return a;
+   });
+   s.counter(name + ".sampled_misses", [this]() {
+      uint64_t m = 0;
+      for (uint64_t g = 0; g < SAMPLE_GROUPS; g++)
+         m += group_misses[g];
+      return m;
+   });
+   s.ratio(name + ".sampled_miss_ratio", name + ".sampled_misses", name + ".sampled_accesses");
+   s.counter(name + ".hot_sets", &num_hot_sets);
+   s.counter(name + ".inferred_accesses", &inferred_accesses);
+   s.summary(name + ".miss_ratio_error", [this]() { return sampling_error(); });
+   if (sample_validate) {
+      s.counter(name + ".sampled_mode_misses", &sampled_mode_misses);
+      s.ratio(name + ".sampled_mode_miss_ratio", name + ".sampled_mode_misses", name + ".accesses");
+   }
+}
+
+// Called when functional warm-up ends: keep contents and replacement state, but consider
+// every fill complete (timestamps are from the warm-up clock) and clear the measurements.
+void cache_base_t::end_warmup() {
+   for (uint64_t i = 0; i < num_stored_sets() * assoc; i++)
+      timestamps[i] = 0;
+
+   accesses = 0;
+   pf_accesses = 0;
+   misses = 0;
+   pf_misses = 0;
+   filter_hits = 0;
+   memset(group_accesses, 0, sizeof(group_accesses));
+   memset(group_misses, 0, sizeof(group_misses));
+   sampled_mode_misses = 0;
+   inferred_misses = 0;
+   inferred_accesses = 0;
+   promoted_accesses = 0;
+}
+
+void cache_base_t::checkpoint_geometry(ckpt_t& c) {
+   uint64_t num_sets = index_mask + 1;
+   uint64_t geometry[5] = {num_sets, assoc, num_offset_bits, sample_bits, sample_validate};
+   c.io(geometry);
+   assert((geometry[0] == num_sets) && (geometry[1] == assoc) && (geometry[2] == num_offset_bits));
+   assert((geometry[3] == sample_bits) && (geometry[4] == sample_validate));
+}
+
+// valid, tag (0 when invalid), timestamp
+void cache_base_t::checkpoint_block(ckpt_t& c, uint64_t index, uint64_t way) {
+   uint64_t& tag = tags[index * tag_stride + way];
+   bool valid = (tag != INVALID_TAG);
+   uint64_t saved_tag = valid ? tag : 0;
+   c.io(valid);
+   c.io(saved_tag);
+   c.io(timestamps[index * assoc + way]);
+   if (c.restoring())
+      tag = valid ? saved_tag : INVALID_TAG;
+}
+
+void cache_base_t::checkpoint_stats(ckpt_t& c) {
+   c.io(accesses);
+   c.io(pf_accesses);
+   c.io(misses);
+   c.io(pf_misses);
+   c.io(filter_hits);
+   for (inference_t& f : inference) {
+      c.io(f.accesses);
+      c.io(f.misses);
+      c.io(f.credit);
+   }
+   c.io(group_accesses);
+   c.io(group_misses);
+   c.io(sampled_mode_misses);
+   c.io(inferred_misses);
+   c.io(sample_slot);
+   c.io(set_accesses);
+   c.io(num_promoted_sets);
+   c.io(num_hot_sets);
+   c.io(inferred_accesses);
+   c.io(promoted_accesses);
+}
+
+// Geometry; per (stored) block its state and the policy's (the LRU position for LRU);
+// then the policy's global state, the last-block filter and the measurements.
+template <class Replacement>
+void cache_t<Replacement>::checkpoint(ckpt_t& c) {
+   checkpoint_geometry(c);
+   for (uint64_t i = 0; i < num_stored_sets(); i++) {
+      for (uint64_t j = 0; j < assoc; j++) {
+         checkpoint_block(c, i, j);
+         repl.checkpoint_way(c, i, j);
+      }
+   }
+   repl.checkpoint(c);
+   c.io(last_block);
+   c.io(last_index);
+   c.io(last_way);
+   checkpoint_stats(c);
+}
+
+template class cache_t<lru_repl_t>;
+template class cache_t<plru_repl_t>;
+template class cache_t<srrip_repl_t>;
+template class cache_t<brrip_repl_t>;
+template class cache_t<random_repl_t>;
+
+cache_base_t *new_cache(repl_policy_t policy, uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_base_t *next_level,
+                        uint64_t sample_bits, bool sample_validate) {
+   switch (policy) {
+   case repl_policy_t::LRU:    return new cache_t<lru_repl_t>(size, assoc, blocksize, latency, next_level, sample_bits, sample_validate);
+   case repl_policy_t::PLRU:   return new cache_t<plru_repl_t>(size, assoc, blocksize, latency, next_level, sample_bits, sample_validate);
+   case repl_policy_t::SRRIP:  return new cache_t<srrip_repl_t>(size, assoc, blocksize, latency, next_level, sample_bits, sample_validate);
+   case repl_policy_t::BRRIP:  return new cache_t<brrip_repl_t>(size, assoc, blocksize, latency, next_level, sample_bits, sample_validate);
+   case repl_policy_t::Random: return new cache_t<random_repl_t>(size, assoc, blocksize, latency, next_level, sample_bits, sample_validate);
+   }
+   assert(false);
+   return NULL;
+}
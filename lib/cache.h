@@ -22,22 +22,44 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Author: Eric Rotenberg (ericro@ncsu.edu)
 
 
-struct block_t {
-    bool valid;
-    //bool dirty;   // TO DO
-    uint64_t tag;
-    uint64_t timestamp;
-    uint64_t lru;
-};
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <string>
+#include <vector>
+#include "replacement.h"
+
+class ckpt_t;
+class stats_t;
 
 #define IsPow2(x)   (((x) & (x-1)) == 0)
 
 #define TAG(addr)   ((addr) >> (num_index_bits + num_offset_bits))
 #define INDEX(addr) (((addr) >> num_offset_bits) & index_mask)
 
-class cache_t {
-private:
-    block_t **C;
+// Result of a cache lookup.
+struct cache_access_t {
+    uint64_t avail;   // cycle the requested block is available
+    uint64_t level;   // where it was found: 0 this cache, 1 the next level, ... (the number of levels: main memory)
+    bool hit;         // found in this cache with its fill complete, i.e. is_hit() before the lookup
+};
+
+// What every cache level has in common, whatever its replacement policy: the blocks,
+// the lookup and the measurements. The levels of a hierarchy may use different
+// policies, so they see each other (next_level) and uarchsim_t sees them through this
+// class; access() and checkpoint() are the policy-dependent parts.
+class cache_base_t {
+protected:
+    // Blocks, as parallel arrays in one cache-line aligned allocation (huge pages with -G):
+    // the tags of a set are packed together, padded to tag_stride ways (a multiple of the
+    // SIMD width), so that a lookup is a few vector compares; the timestamps (assoc per
+    // set) follow. An invalid way holds INVALID_TAG, which no address maps to.
+    static constexpr uint64_t INVALID_TAG = ~0lu;
+    void *storage;
+    uint64_t *tags;
+    uint64_t *timestamps;
+    uint64_t tag_stride;
+
     uint64_t num_index_bits;
     uint64_t num_offset_bits;
     uint64_t index_mask;
@@ -47,20 +69,141 @@ private:
     uint64_t latency;
 
     // pointer to next cache level if applicable
-    cache_t *next_level;
+    cache_base_t *next_level;
+
+    // The block the last lookup hit or filled (addr >> num_offset_bits, INVALID_TAG: none)
+    // and where it is. It is present until this cache misses again, and already the most
+    // recently used, so fetch() answers a fetch from it without a lookup.
+    uint64_t last_block;
+    uint64_t last_index;
+    uint64_t last_way;
+
+    // Set sampling (-X). num_sampled_sets sets drawn at random (with a fixed seed) are
+    // simulated, stored at their slot in the draw. A set that gets HOT_FACTOR times its
+    // share of the demand accesses turns hot: a few hot sets can hold most of a level's
+    // hits, so they are simulated from then on (up to max_promoted_sets of those outside
+    // the sample, in the slots after it) and left out of the sample. An access to any
+    // other set is a hit or a miss as often as the sample's recent accesses were (error
+    // diffusion, so deterministic), with no fill; a miss goes on to the next level. With
+    // sample_validate every set is simulated as usual, and the outcome the sampled mode
+    // would have given is only counted (sampled_mode_misses).
+    static constexpr uint64_t SAMPLE_GROUPS = 32;     // for the error estimate
+    static constexpr uint64_t SAMPLE_SPAN = 8192;     // the inference follows the sample over about
+                                                      // this many recent accesses to the level
+    static constexpr uint64_t HOT_FACTOR = 8;
+    static constexpr uint64_t HOT_MIN_ACCESSES = 16;
+    static constexpr uint32_t HOT = 1u << 31;         // sample_slot flag
+    static constexpr uint32_t UNSAMPLED = HOT - 1;
+    struct inference_t {
+        uint64_t accesses;   // recent sampled-set accesses, halved every sample_window
+        uint64_t misses;
+        uint64_t credit;     // 32.32 fixed point
+    };
+    uint64_t sample_bits;          // 0: every set simulated
+    uint64_t num_sampled_sets;
+    uint64_t sample_window;
+    bool sample_validate;
+    std::vector<uint32_t> sample_slot;   // per set: its slot, or UNSAMPLED; | HOT
+    std::vector<uint32_t> set_accesses;  // per set: its demand accesses until it turns hot
+    uint64_t max_promoted_sets;
+    uint64_t num_promoted_sets;
+    uint64_t num_hot_sets;
+    uint64_t inferred_accesses;    // demand accesses to sets not simulated
+    uint64_t promoted_accesses;    // ... of them to sets simulated since (hot)
+    inference_t inference[2];      // demand, prefetch
+    uint64_t group_accesses[SAMPLE_GROUPS];   // demand accesses/misses of the sampled sets, by group
+    uint64_t group_misses[SAMPLE_GROUPS];
+    uint64_t sampled_mode_misses;  // sample_validate: demand misses the sampled mode would count
+    uint64_t inferred_misses;      // sample_validate: actual demand misses of the inferred accesses
 
     // measurements
     uint64_t accesses;
     uint64_t pf_accesses;
     uint64_t misses;
     uint64_t pf_misses;
-
-    void update_lru(uint64_t index, uint64_t mru_way);
+    uint64_t filter_hits;    // fetch()es answered by the last-block filter
+
+    uint64_t find_way(uint64_t index, uint64_t tag) const;
+    uint64_t num_stored_sets() const { return (sample_bits && !sample_validate) ? (num_sampled_sets + max_promoted_sets) : (index_mask + 1); }
+    uint32_t count_access(uint64_t index, uint32_t slot, bool pf);
+    bool infer_miss(bool pf);
+    void sample(uint32_t slot, bool pf, bool miss);
+    double sample_miss_ratio() const;
+    double sampling_error() const;
+    void checkpoint_geometry(ckpt_t& c);
+    void checkpoint_block(ckpt_t& c, uint64_t index, uint64_t way);
+    void checkpoint_stats(ckpt_t& c);
 
 public:
-    cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_t *next_level);
-    ~cache_t();
-    uint64_t access(uint64_t cycle, bool read, uint64_t addr, bool pf = false);
+    cache_base_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_base_t *next_level,
+                 uint64_t sample_bits = 0, bool sample_validate = false);
+    virtual ~cache_base_t();
+    // Looks addr up from this level down and fills the levels that miss. access() is
+    // lookup().avail.
+    virtual cache_access_t lookup(uint64_t cycle, bool read, uint64_t addr, bool pf = false) = 0;
+    virtual uint64_t access(uint64_t cycle, bool read, uint64_t addr, bool pf = false) = 0;
+    // Instruction fetch: access(), with consecutive fetches from one block filtered (see
+    // last_block). Results, replacement state and accesses/misses are the same.
+    virtual uint64_t fetch(uint64_t cycle, uint64_t addr) = 0;
+    virtual void checkpoint(ckpt_t& c) = 0;
     bool is_hit(uint64_t cycle, uint64_t addr) const;
     void stats();
+    void filter_stats();
+    void sampling_stats();
+    void register_stats(stats_t& s, const std::string& name);
+    void register_filter_stats(stats_t& s, const std::string& name);
+    void register_sampling_stats(stats_t& s, const std::string& name);
+    void end_warmup();
+};
+
+// A cache level with replacement policy Replacement (replacement.h). Instantiated in
+// cache.cc for each policy; calls through a cache_t<> are direct, and a lookup walks the
+// next levels with the same policy in the same loop.
+template <class Replacement>
+class cache_t final : public cache_base_t {
+private:
+    // Levels of one policy looked up by a single lookup() loop.
+    static constexpr uint64_t CACHE_MAX_LEVELS = 8;
+
+    // A level that missed, and the way it will fill.
+    struct pending_fill_t {
+        cache_t *cache;   // NULL: a miss inferred for a set that is not sampled, no fill
+        uint64_t index;
+        uint64_t way;
+        uint64_t block;   // addr >> num_offset_bits
+    };
+
+    Replacement repl;
+    cache_t *next_same;   // next_level if it has the same policy, NULL otherwise
+
+    bool probe(uint64_t cycle, uint64_t addr, bool pf, uint64_t& avail, pending_fill_t& miss);
+    bool probe_set(uint64_t index, uint64_t cycle, uint64_t addr, bool pf, uint64_t& avail, pending_fill_t& miss);
+    bool probe_sampled(uint64_t cycle, uint64_t addr, bool pf, uint64_t& avail, pending_fill_t& miss);
+    void fill(const pending_fill_t& miss, uint64_t avail);
+
+public:
+    cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_base_t *next_level,
+            uint64_t sample_bits = 0, bool sample_validate = false);
+    cache_access_t lookup(uint64_t cycle, bool read, uint64_t addr, bool pf = false) override;
+    uint64_t access(uint64_t cycle, bool read, uint64_t addr, bool pf = false) override;
+    void checkpoint(ckpt_t& c) override;
+
+    uint64_t fetch(uint64_t cycle, uint64_t addr) override
+    {
+        if ((addr >> num_offset_bits) != last_block)
+            return lookup(cycle, true, addr).avail;
+
+        accesses++;
+        filter_hits++;
+        if (!Replacement::REPEAT_HIT_IS_NOOP)
+            repl.hit(last_index, last_way);
+        const uint64_t ts = timestamps[last_index * assoc + last_way];
+        return ((ts > (cycle + latency)) ? ts : (cycle + latency));
+    }
 };
+
+// A cache level with the given replacement policy, simulating 2^-sample_bits of its sets.
+cache_base_t *new_cache(repl_policy_t policy, uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_base_t *next_level,
+                        uint64_t sample_bits = 0, bool sample_validate = false);
+
+#endif
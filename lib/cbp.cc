@@ -34,8 +34,17 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "bp.h"
 #include "resource_schedule.h"
 #include "uarchsim.h"
+#include "predsim.h"
 #include "parameters.h"
 #include "log.h"
+#include "checkpoint.h"
+#include "profiler.h"
+#include "perfcount.h"
+#include "hugepage.h"
+#include "heartbeat.h"
+#include "pipetrace.h"
+#include "memstats.h"
+#include "mrc.h"
 
 uarchsim_t *sim;
 log_files files;
@@ -62,6 +71,16 @@ int parseargs(int argc, char ** argv)
      //   PERFECT_INDIRECT_PRED = true;
      //   i++;
      //}
+     else if (!strcmp(argv[i], "-g"))
+     {
+        STEP_SPECIALIZE = false;
+        i++;
+     }
+     else if (!strcmp(argv[i], "-H"))
+     {
+        HOST_PERF_COUNTERS = true;
+        i++;
+     }
      else if (!strcmp(argv[i], "-P"))
      {
         PREFETCHER_ENABLE = true;
@@ -272,6 +291,241 @@ int parseargs(int argc, char ** argv)
            i++;
         }
      }
+     else if (!strcmp(argv[i], "-W"))
+     {
+        i++;
+        uint64_t warmup_insts;
+        if ((i < argc) && (sscanf(argv[i], "%lu", &warmup_insts) == 1))
+        {
+           WARMUP_INSTS = warmup_insts;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing warm-up length: -W <warmup_insts>\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-C"))
+     {
+        i++;
+        static char ckpt_file[4096];
+        uint64_t ckpt_insts;
+        if ((i < argc) && (sscanf(argv[i], "%lu,%4095s", &ckpt_insts, ckpt_file) == 2) && (ckpt_insts > 0))
+        {
+           CKPT_SAVE_INSTS = ckpt_insts;
+           CKPT_SAVE_FILE = ckpt_file;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing checkpoint: -C <num_insts>,<checkpoint_file>\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-R"))
+     {
+        i++;
+        if (i < argc)
+        {
+           CKPT_RESTORE_FILE = argv[i];
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing checkpoint file: -R <checkpoint_file>\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-S"))
+     {
+        i++;
+        if ((i < argc) && (!strcmp(argv[i], "json") || !strcmp(argv[i], "csv") || !strcmp(argv[i], "json,csv") || !strcmp(argv[i], "csv,json")))
+        {
+           STATS_JSON = (strstr(argv[i], "json") != NULL);
+           STATS_CSV = (strstr(argv[i], "csv") != NULL);
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing stats format: -S json|csv|json,csv\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-B"))
+     {
+        i++;
+        static char heartbeat_file[4096];
+        uint64_t heartbeat_insts;
+        int n = (i < argc) ? sscanf(argv[i], "%lu,%4095s", &heartbeat_insts, heartbeat_file) : 0;
+        if ((n >= 1) && (heartbeat_insts > 0))
+        {
+           HEARTBEAT_INSTS = heartbeat_insts;
+           HEARTBEAT_FILE = (n == 2) ? heartbeat_file : NULL;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing heartbeat interval: -B <num_insts>[,<file_or_fifo>]\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-m"))
+     {
+        i++;
+        uint64_t max_mb;
+        if ((i < argc) && (sscanf(argv[i], "%lu", &max_mb) == 1))
+        {
+           MEMSTATS_ENABLE = true;
+           MEMSTATS_MAX_MB = max_mb;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing memory cap: -m <max_MB> (0: report only)\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-G"))
+     {
+        i++;
+        if ((i < argc) && !strcmp(argv[i], "thp"))
+           HUGEPAGE_MODE = hugepage_mode_t::Transparent;
+        else if ((i < argc) && !strcmp(argv[i], "explicit"))
+           HUGEPAGE_MODE = hugepage_mode_t::Explicit;
+        else if ((i < argc) && !strcmp(argv[i], "off"))
+           HUGEPAGE_MODE = hugepage_mode_t::Off;
+        else
+        {
+           printf("Usage: missing huge page mode: -G thp|explicit|off\n");
+           exit(0);
+        }
+        i++;
+     }
+     else if (!strcmp(argv[i], "-r"))
+     {
+        // One policy for all levels, or one per level.
+        i++;
+        char ic[16], l1[16], l2[16], l3[16];
+        if ((i < argc) && (sscanf(argv[i], "%15[a-z],%15[a-z],%15[a-z],%15[a-z]", ic, l1, l2, l3) == 4)
+            && parse_repl_policy(ic, IC_REPL) && parse_repl_policy(l1, L1_REPL) && parse_repl_policy(l2, L2_REPL) && parse_repl_policy(l3, L3_REPL))
+        {
+           i++;
+        }
+        else if ((i < argc) && parse_repl_policy(argv[i], L1_REPL))
+        {
+           IC_REPL = L2_REPL = L3_REPL = L1_REPL;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing replacement policies: -r <policy> | -r <IC_policy>,<L1_policy>,<L2_policy>,<L3_policy> (lru, plru, srrip, brrip, random)\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-T"))
+     {
+        i++;
+        uint64_t a, b, c;
+        if ((i < argc) && (sscanf(argv[i], "cycles,%lu,%lu", &a, &b) == 2) && (a <= b))
+        {
+           PIPETRACE_TRIGGER = pipetrace_trigger_t::Cycles;
+           PIPETRACE_FIRST = a;
+           PIPETRACE_LAST = b;
+        }
+        else if ((i < argc) && (sscanf(argv[i], "insts,%lu,%lu", &a, &b) == 2) && (a <= b))
+        {
+           PIPETRACE_TRIGGER = pipetrace_trigger_t::Insts;
+           PIPETRACE_FIRST = a;
+           PIPETRACE_LAST = b;
+        }
+        else if ((i < argc) && (sscanf(argv[i], "misp,%lx,%lu,%lu", &a, &b, &c) == 3) && (b > 0))
+        {
+           PIPETRACE_TRIGGER = pipetrace_trigger_t::Mispredict;
+           PIPETRACE_PC = a;
+           PIPETRACE_MISP_K = b;
+           PIPETRACE_CYCLES = c;
+        }
+        else
+        {
+           printf("Usage: missing pipeline trace trigger: -T cycles,<first>,<last> | insts,<first>,<last> | misp,<hex_pc>,<k>,<num_cycles>\n");
+           exit(0);
+        }
+        i++;
+     }
+     else if (!strcmp(argv[i], "-K"))
+     {
+        i++;
+        uint64_t sampling, min_size, max_size;
+        int n = (i < argc) ? sscanf(argv[i], "%lu,%lu,%lu", &sampling, &min_size, &max_size) : 0;
+        if (((n == 1) || ((n == 3) && (min_size <= max_size) && (max_size <= 40))) && (sampling < 32))
+        {
+           MRC_ENABLE = true;
+           MRC_LOG2_SAMPLING = sampling;
+           if (n == 3)
+           {
+              MRC_LOG2_MIN_SIZE = min_size;
+              MRC_LOG2_MAX_SIZE = max_size;
+           }
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing miss ratio curve sampling: -K <log2_sampling>[,<log2_min_size>,<log2_max_size>] (0: exact; sizes up to 2^40, set-associative up to 2^20 blocks)\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-X"))
+     {
+        i++;
+        uint64_t l2_bits, l3_bits;
+        char validate[16] = "";
+        int n = (i < argc) ? sscanf(argv[i], "%lu,%lu,%15s", &l2_bits, &l3_bits, validate) : 0;
+        if (((n == 2) || ((n == 3) && !strcmp(validate, "validate"))) && (l2_bits < 32) && (l3_bits < 32))
+        {
+           L2_SAMPLE_BITS = l2_bits;
+           L3_SAMPLE_BITS = l3_bits;
+           CACHE_SAMPLE_VALIDATE = (n == 3);
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing set sampling: -X <log2_L2_sampling>,<log2_L3_sampling>[,validate] (0: all sets)\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-L"))
+     {
+        i++;
+        uint64_t size;
+        if ((i < argc) && (sscanf(argv[i], "%lu", &size) == 1) && (size > 0) && (size < UINT32_MAX))
+        {
+           LOAD_PROFILE_SIZE = size;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing load profile size: -L <num_load_pcs>\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-O"))
+     {
+        i++;
+        uint64_t decode_delay, resolve_delay;
+        if ((i < argc) && (sscanf(argv[i], "%lu,%lu", &decode_delay, &resolve_delay) == 2) && (decode_delay <= resolve_delay))
+        {
+           PRED_ONLY = true;
+           PRED_ONLY_DECODE_DELAY = decode_delay;
+           PRED_ONLY_RESOLVE_DELAY = resolve_delay;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing predictor-only delays: -O <decode_delay>,<resolve_delay> (decode_delay <= resolve_delay)\n");
+           exit(0);
+        }
+     }
 
      else
      {
@@ -279,6 +533,16 @@ int parseargs(int argc, char ** argv)
      }
   }
 
+  if (PRED_ONLY && (WARMUP_INSTS || CKPT_SAVE_FILE || CKPT_RESTORE_FILE || (PIPETRACE_TRIGGER != pipetrace_trigger_t::Off) || LOAD_PROFILE_SIZE)) {
+     printf("Usage: -O cannot be combined with -W, -C, -R, -T or -L.\n");
+     exit(0);
+  }
+
+  if (MRC_ENABLE && (PRED_ONLY || CKPT_SAVE_FILE || CKPT_RESTORE_FILE || (PIPETRACE_TRIGGER != pipetrace_trigger_t::Off) || L2_SAMPLE_BITS || L3_SAMPLE_BITS || LOAD_PROFILE_SIZE)) {
+     printf("Usage: -K cannot be combined with -O, -C, -R, -T, -X or -L.\n");
+     exit(0);
+  }
+
   if (i < argc) {
      return(i);
   }
@@ -297,18 +561,167 @@ int parseargs(int argc, char ** argv)
              "\t[optional: -F <fetch_width>,<fetch_num_branch>,<fetch_stop_at_indirect>,<fetch_stop_at_taken>,<fetch_model_icache>]\n"
              "\t[optional: -I <log2_ic_size>,<ic_assoc>,<ic_blocksize>]\n"
              "\t[optional: -D <log2_L1_size>,<L1_assoc>,<L1_blocksize>,<L1_latency>,<log2_L2_size>,<L2_assoc>,<L2_blocksize>,<L2_latency>,<log2_L3_size>,<L3_assoc>,<L3_blocksize>,<L3_latency>,<main_memory_latency>]\n"
+             "\t[optional: -r <policy> | <IC_policy>,<L1_policy>,<L2_policy>,<L3_policy> cache replacement: lru (default), plru, srrip, brrip or random]\n"
              "\t[optional: -w <window_size>]\n"
              "\t[optional: -E <epoch_size_insts> to enable dumping per-epoch conditional branch info\n"
+             "\t[optional: -W <warmup_insts> to warm up caches and predictors functionally, then reset all stats]\n"
+             "\t[optional: -C <num_insts>,<checkpoint_file> to save a checkpoint after <num_insts> instructions]\n"
+             "\t[optional: -R <checkpoint_file> to resume from a checkpoint]\n"
+             "\t[optional: -B <num_insts>[,<file_or_fifo>] to print a progress line every <num_insts> instructions (default: stderr)]\n"
+             "\t[optional: -m <max_MB> to report memory per structure every epoch (<trace>_memory.csv) and at the end; stop if the RSS exceeds <max_MB> (0: no cap)]\n"
+             "\t[optional: -G thp|explicit to back the cache and predictor tables with 2 MB transparent or MAP_HUGETLB pages]\n"
+             "\t[optional: -T cycles,<first>,<last> | insts,<first>,<last> | misp,<hex_pc>,<k>,<num_cycles> to write a Chrome/Perfetto pipeline timeline to <trace>_pipetrace.json]\n"
+             "\t[optional: -g to use the generic step() instead of the one specialized for this configuration (same results, slower)]\n"
+             "\t[optional: -H to report the simulator's own host hardware counters per phase on stderr]\n"
+             "\t[optional: -S json|csv|json,csv to also write all measurements to <trace>_stats.json/.csv (per epoch with -E)]\n"
+             "\t[optional: -O <decode_delay>,<resolve_delay> to run the predictor only, in order, without the timing model]\n"
+             "\t[optional: -K <log2_sampling>[,<log2_min_size>,<log2_max_size>] to only compute the miss ratio curves of each cache level (<trace>_mrc.csv), 2^-<log2_sampling> sampled]\n"
+             "\t[optional: -X <log2_L2_sampling>,<log2_L3_sampling>[,validate] to simulate 2^-<log2_sampling> of the L2/L3 sets and infer the others' misses; validate: simulate all, report the estimate's error]\n"
+             "\t[optional: -L <num_load_pcs> to profile the <num_load_pcs> load PCs with the most L1 misses: hit levels, mean latency, dependent branches (<trace>_loads.csv)]\n"
              "\t[REQUIRED: .gz trace file]\n", argv[0]);
      exit(0);
   }
 }
 
+// Saves, restores or digests the whole simulator state. Only valid between instructions.
+void checkpoint_simulator(ckpt_t& c, TraceReader& reader)
+{
+  c.begin();
+  checkpoint_parameters(c);
+  c.section("trace_reader");
+  reader.checkpoint(c);
+  c.section("uarchsim");
+  sim->checkpoint(c);
+  checkpoint_cond_dir_predictor(c);
+  c.finish();
+}
+
+void save_checkpoint(TraceReader& reader)
+{
+  ckpt_t c(CKPT_SAVE_FILE, ckpt_t::mode_t::Save);
+  checkpoint_simulator(c, reader);
+  fprintf(stderr, "Checkpoint: saved %lu instrs to %s (%lu bytes, digest %016lx).\n", reader.nInstr, CKPT_SAVE_FILE, c.bytes(), c.digest());
+}
+
+void restore_checkpoint(TraceReader& reader)
+{
+  ckpt_t c(CKPT_RESTORE_FILE, ckpt_t::mode_t::Restore);
+  checkpoint_simulator(c, reader);
+
+  // Consistency check: the restored state must serialize back to exactly what was saved.
+  ckpt_t check("", ckpt_t::mode_t::Digest);
+  checkpoint_simulator(check, reader);
+  if (check.digest() != c.digest())
+  {
+     fprintf(stderr, "Checkpoint %s: restored state does not match the saved state.\n", CKPT_RESTORE_FILE);
+     exit(EXIT_FAILURE);
+  }
+  fprintf(stderr, "Checkpoint: resumed %s at %lu instrs (digest %016lx).\n", CKPT_RESTORE_FILE, reader.nInstr, c.digest());
+}
+
+typedef void (uarchsim_t::*step_fn_t)(db_t *inst);
+
+// Picks the step() compiled for this run's configuration (uarchsim.h), or the generic one.
+step_fn_t select_step()
+{
+#define STEP_CASE(icache, prefetcher, perfect_cache)                                           \
+  if (fixed_step_config_t<icache, prefetcher, perfect_cache, true>::matches())                \
+     return &uarchsim_t::step_impl<fixed_step_config_t<icache, prefetcher, perfect_cache, true>>; \
+  if (fixed_step_config_t<icache, prefetcher, perfect_cache, false>::matches())               \
+     return &uarchsim_t::step_impl<fixed_step_config_t<icache, prefetcher, perfect_cache, false>>;
+
+  if (STEP_SPECIALIZE)
+  {
+     STEP_CASE(true, true, false)     // defaults
+     STEP_CASE(true, true, true)
+     STEP_CASE(true, false, false)
+     STEP_CASE(true, false, true)
+     STEP_CASE(false, true, false)
+     STEP_CASE(false, true, true)
+     STEP_CASE(false, false, false)
+     STEP_CASE(false, false, true)
+  }
+#undef STEP_CASE
+  return &uarchsim_t::step;
+}
+
+// Predictor-only fast mode (-O): no caches, lanes or window, just the predictor hooks in order.
+void run_predictor_only(TraceReader& reader, const char *trace_path)
+{
+  beginCondDirPredictor();
+
+  predsim_t psim;
+  heartbeat_t heartbeat(trace_path, reader.nInstr, reader.compressed_offset());
+  memstats_t& memstats = psim.memory();
+  db_t *inst = reader.get_inst();
+  while (inst != nullptr)
+  {
+      psim.step(inst);
+      if (heartbeat.due(reader.nInstr))
+         heartbeat.beat(reader.nInstr, reader.compressed_offset(), psim.progress());
+      if (memstats.due(reader.nInstr))
+         memstats.sample(reader.nInstr);
+      delete inst;
+      inst = reader.get_inst();
+  }
+  psim.finish();
+  heartbeat.beat(reader.nInstr, reader.compressed_offset(), psim.progress(), true/*done*/);
+  if (MEMSTATS_ENABLE)
+     memstats.sample(reader.nInstr);
+
+  endCondDirPredictor();
+  psim.output();
+  profiler_report(reader.nInstr);
+  perf_report(reader.nInstr);
+  hugepage_report();
+}
+
+// Miss-ratio curve mode (-K): the cache reference streams only, no predictor or timing model.
+void run_miss_ratio_curves(TraceReader& reader, const char *trace_path)
+{
+  mrcsim_t msim;
+  heartbeat_t heartbeat(trace_path, reader.nInstr, reader.compressed_offset());
+  db_t *inst = reader.get_inst();
+  while (inst != nullptr)
+  {
+      msim.step(inst);
+      if (inst->is_last_piece && (reader.nInstr == WARMUP_INSTS))
+         msim.end_warmup();
+      if (heartbeat.due(reader.nInstr))
+         heartbeat.beat(reader.nInstr, reader.compressed_offset(), sim_progress_t{0, 0, 0});
+      delete inst;
+      inst = reader.get_inst();
+  }
+  heartbeat.beat(reader.nInstr, reader.compressed_offset(), sim_progress_t{0, 0, 0}, true/*done*/);
+
+  msim.output(files.prefix);
+  profiler_report(reader.nInstr);
+  perf_report(reader.nInstr);
+  hugepage_report();
+}
+
 int main(int argc, char ** argv)
 {
+  profiler_start();
   int i = parseargs(argc, argv);
-  TraceReader reader(argv[i]);
-  files.init(string(argv[i]));
+  const char *trace_path = argv[i];
+  TraceReader reader(trace_path);
+  files.init(string(trace_path));
+
+  if (HOST_PERF_COUNTERS)
+     perf_start();
+
+  if (PRED_ONLY)
+  {
+     run_predictor_only(reader, trace_path);
+     return(0);
+  }
+
+  if (MRC_ENABLE)
+  {
+     run_miss_ratio_curves(reader, trace_path);
+     return(0);
+  }
 
   // Need to create simulator after parsing arguments (for global parameters).
   sim = new uarchsim_t;
@@ -326,6 +739,12 @@ int main(int argc, char ** argv)
   //   beginCondDirPredictor(0, (char **)NULL);
   beginCondDirPredictor();
 
+  if (CKPT_RESTORE_FILE)
+     restore_checkpoint(reader);
+
+  heartbeat_t heartbeat(trace_path, reader.nInstr, reader.compressed_offset());
+  memstats_t& memstats = sim->memory();
+  const step_fn_t step = select_step();
   db_t *inst = reader.get_inst(); 
 
   //bool dump_activity = true;
@@ -339,7 +758,25 @@ int main(int argc, char ** argv)
       //    dump_activity = false;
       //}
 
-      sim->step(inst);
+      if (reader.nInstr <= WARMUP_INSTS)
+      {
+         sim->warmup(inst);
+         if (inst->is_last_piece && (reader.nInstr == WARMUP_INSTS))
+            sim->end_warmup();
+      }
+      else
+      {
+         (sim->*step)(inst);
+      }
+
+      if (CKPT_SAVE_FILE && inst->is_last_piece && (reader.nInstr == CKPT_SAVE_INSTS))
+         save_checkpoint(reader);
+
+      if (heartbeat.due(reader.nInstr))
+         heartbeat.beat(reader.nInstr, reader.compressed_offset(), sim->progress());
+
+      if (memstats.due(reader.nInstr))
+         memstats.sample(reader.nInstr);
 
       //const uint64_t next_fetch_cycle = sim->get_current_fetch_cycle();
       //if(logging_activated && next_fetch_cycle != current_fetch_cycle)
@@ -352,7 +789,14 @@ int main(int argc, char ** argv)
       inst = reader.get_inst();
   }
 
+  heartbeat.beat(reader.nInstr, reader.compressed_offset(), sim->progress(), true/*done*/);
+  if (MEMSTATS_ENABLE)
+     memstats.sample(reader.nInstr);
+
   endPredictor();
   endCondDirPredictor();
   sim->output();
+  profiler_report(reader.nInstr);
+  perf_report(reader.nInstr);
+  hugepage_report();
 }
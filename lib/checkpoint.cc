@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "parameters.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325lu
+#define FNV_PRIME        0x100000001b3lu
+
+ckpt_t::ckpt_t(const std::string& path, mode_t mode)
+   : fp(NULL)
+   , mode(mode)
+   , path(path)
+   , hash(FNV_OFFSET_BASIS)
+   , num_bytes(0)
+{
+   if (mode == mode_t::Digest)
+      return;
+
+   fp = fopen(path.c_str(), (mode == mode_t::Save) ? "wb" : "rb");
+   if (!fp)
+   {
+      fprintf(stderr, "Checkpoint: cannot open %s for %s.\n", path.c_str(), (mode == mode_t::Save) ? "writing" : "reading");
+      exit(EXIT_FAILURE);
+   }
+   setvbuf(fp, NULL, _IOFBF, 1 << 20);
+}
+
+ckpt_t::~ckpt_t()
+{
+   if (fp)
+      fclose(fp);
+}
+
+void ckpt_t::fail(const char *what) const
+{
+   fprintf(stderr, "Checkpoint %s: %s (offset %lu).\n", path.c_str(), what, num_bytes);
+   exit(EXIT_FAILURE);
+}
+
+void ckpt_t::raw(void *p, uint64_t size)
+{
+   if (mode == mode_t::Save)
+   {
+      if (fwrite(p, 1, size, fp) != size)
+         fail("write failed");
+   }
+   else if (mode == mode_t::Restore)
+   {
+      if (fread(p, 1, size, fp) != size)
+         fail("truncated file");
+   }
+
+   const uint8_t *b = (const uint8_t *)p;
+   for (uint64_t i = 0; i < size; i++)
+      hash = (hash ^ b[i]) * FNV_PRIME;
+   num_bytes += size;
+}
+
+void ckpt_t::section(const char *name)
+{
+   uint64_t tag = FNV_OFFSET_BASIS;
+   for (const char *s = name; *s; s++)
+      tag = (tag ^ (uint8_t)*s) * FNV_PRIME;
+
+   const uint64_t expected = tag;
+   io(tag);
+   if (restoring() && (tag != expected))
+   {
+      std::string msg = std::string("layout mismatch at section \"") + name + "\"";
+      fail(msg.c_str());
+   }
+}
+
+void ckpt_t::begin()
+{
+   uint64_t magic = CKPT_MAGIC;
+   uint32_t version = CKPT_VERSION;
+   io(magic);
+   io(version);
+   if (restoring())
+   {
+      if (magic != CKPT_MAGIC)
+         fail("not a checkpoint file");
+      if (version != CKPT_VERSION)
+      {
+         char msg[128];
+         snprintf(msg, sizeof(msg), "version %u, this simulator reads version %u", version, CKPT_VERSION);
+         fail(msg);
+      }
+   }
+}
+
+void ckpt_t::finish()
+{
+   uint64_t computed = hash;
+   uint64_t stored = hash;
+
+   if (mode == mode_t::Save)
+   {
+      if (fwrite(&stored, 1, sizeof(stored), fp) != sizeof(stored))
+         fail("write failed");
+      if (fflush(fp) != 0)
+         fail("write failed");
+   }
+   else if (mode == mode_t::Restore)
+   {
+      if (fread(&stored, 1, sizeof(stored), fp) != sizeof(stored))
+         fail("truncated file");
+      if (stored != computed)
+         fail("digest mismatch, file is corrupt");
+   }
+}
+
+#define CKPT_PARAM(p)                                                                               \
+   {                                                                                                \
+      auto v = p;                                                                                   \
+      c.io(v);                                                                                      \
+      if (c.restoring() && (v != p))                                                                \
+      {                                                                                             \
+         fprintf(stderr, "Checkpoint was taken with %s = %lu, this run has %s = %lu.\n",           \
+                 #p, (uint64_t)v, #p, (uint64_t)p);                                                 \
+         exit(EXIT_FAILURE);                                                                        \
+      }                                                                                             \
+   }
+
+void checkpoint_parameters(ckpt_t& c)
+{
+   c.section("parameters");
+   CKPT_PARAM(VP_ENABLE);
+   CKPT_PARAM(VP_PERFECT);
+   CKPT_PARAM(VP_TRACK);
+   CKPT_PARAM(WINDOW_SIZE);
+   CKPT_PARAM(FETCH_WIDTH);
+   CKPT_PARAM(FETCH_NUM_BRANCH);
+   CKPT_PARAM(FETCH_STOP_AT_INDIRECT);
+   CKPT_PARAM(FETCH_STOP_AT_TAKEN);
+   CKPT_PARAM(FETCH_MODEL_ICACHE);
+   CKPT_PARAM(PERFECT_BRANCH_PRED);
+   CKPT_PARAM(PERFECT_INDIRECT_PRED);
+   CKPT_PARAM(PIPELINE_FILL_LATENCY);
+   CKPT_PARAM(NUM_LDST_LANES);
+   CKPT_PARAM(NUM_ALU_LANES);
+   CKPT_PARAM(PREFETCHER_ENABLE);
+   CKPT_PARAM(PERFECT_CACHE);
+   CKPT_PARAM(WRITE_ALLOCATE);
+   CKPT_PARAM(IC_SIZE);
+   CKPT_PARAM(IC_ASSOC);
+   CKPT_PARAM(IC_BLOCKSIZE);
+   CKPT_PARAM(L1_SIZE);
+   CKPT_PARAM(L1_ASSOC);
+   CKPT_PARAM(L1_BLOCKSIZE);
+   CKPT_PARAM(L1_LATENCY);
+   CKPT_PARAM(L2_SIZE);
+   CKPT_PARAM(L2_ASSOC);
+   CKPT_PARAM(L2_BLOCKSIZE);
+   CKPT_PARAM(L2_LATENCY);
+   CKPT_PARAM(L3_SIZE);
+   CKPT_PARAM(L3_ASSOC);
+   CKPT_PARAM(L3_BLOCKSIZE);
+   CKPT_PARAM(L3_LATENCY);
+   CKPT_PARAM(IC_REPL);
+   CKPT_PARAM(L1_REPL);
+   CKPT_PARAM(L2_REPL);
+   CKPT_PARAM(L3_REPL);
+   CKPT_PARAM(L2_SAMPLE_BITS);
+   CKPT_PARAM(L3_SAMPLE_BITS);
+   CKPT_PARAM(CACHE_SAMPLE_VALIDATE);
+   CKPT_PARAM(LOAD_PROFILE_SIZE);
+   CKPT_PARAM(MAIN_MEMORY_LATENCY);
+   CKPT_PARAM(DEFAULT_EXEC_LATENCY);
+   CKPT_PARAM(FP_EXEC_LATENCY);
+   CKPT_PARAM(SLOW_ALU_EXEC_LATENCY);
+   CKPT_PARAM(DQ_LATENCY);
+   CKPT_PARAM(MISP_REDUCTION_PERC);
+   CKPT_PARAM(EPOCH_SIZE_INSTS);
+   CKPT_PARAM(LOAD_DEPENDENT_BRANCHES);
+   CKPT_PARAM(U_incrment);
+   CKPT_PARAM(WARMUP_INSTS);
+}
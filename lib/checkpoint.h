@@ -0,0 +1,280 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <array>
+#include <tuple>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
+#include "sim_common_structs.h"
+
+// Binary snapshot/restore of the whole simulator at an instruction boundary.
+//
+// Every stateful component exposes a single "void checkpoint(ckpt_t& c)" method that
+// calls c.io() on each of its fields. The same method is used to save, to restore and
+// to compute a digest of the state, so the save and restore layouts cannot drift apart.
+//
+// File layout: magic, version, parameter fingerprint, then one tagged section per
+// component, then the FNV-1a digest of everything before it.
+// Unordered containers are written in key order so the digest does not depend on
+// hash-table iteration order.
+
+constexpr uint64_t CKPT_MAGIC = 0x0054504b43504243lu; // "CBPCKPT"
+constexpr uint32_t CKPT_VERSION = 8;
+
+class ckpt_t;
+
+template <typename T, typename = void>
+struct ckpt_has_member : std::false_type {};
+template <typename T>
+struct ckpt_has_member<T, std::void_t<decltype(std::declval<T&>().checkpoint(std::declval<ckpt_t&>()))>> : std::true_type {};
+
+class ckpt_t {
+public:
+   enum class mode_t { Save, Restore, Digest };
+
+   ckpt_t(const std::string& path, mode_t mode);
+   ~ckpt_t();
+
+   bool saving() const { return mode != mode_t::Restore; }
+   bool restoring() const { return mode == mode_t::Restore; }
+   uint64_t digest() const { return hash; }
+   uint64_t bytes() const { return num_bytes; }
+
+   // Writes (or checks on restore) a tag so that a layout mismatch is reported by name
+   // instead of silently mis-assigning fields.
+   void section(const char *name);
+
+   // Header and trailer; finish() verifies the stored digest on restore.
+   void begin();
+   void finish();
+
+   void raw(void *p, uint64_t size);
+
+   template <typename T>
+   void io(T& v)
+   {
+      if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>)
+         raw(&v, sizeof(T));
+      else if constexpr (ckpt_has_member<T>::value)
+         v.checkpoint(*this);
+      else
+         ckpt_io(*this, v);
+   }
+
+   template <typename T>
+   void io_array(T *p, uint64_t n)
+   {
+      if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>)
+         raw(p, n * sizeof(T));
+      else
+         for (uint64_t i = 0; i < n; i++)
+            io(p[i]);
+   }
+
+   template <typename T, size_t N>
+   void io(T (&a)[N]) { io_array(&a[0], N); }
+
+   template <typename T, size_t N>
+   void io(std::array<T, N>& a) { io_array(a.data(), N); }
+
+   template <typename T>
+   void io(std::optional<T>& o)
+   {
+      bool valid = o.has_value();
+      io(valid);
+      if (restoring())
+      {
+         if (valid)
+            o.emplace();
+         else
+            o.reset();
+      }
+      if (valid)
+         io(*o);
+   }
+
+   template <typename A, typename B>
+   void io(std::pair<A, B>& p) { io(p.first); io(p.second); }
+
+   template <typename... Ts>
+   void io(std::tuple<Ts...>& t) { std::apply([this](auto&... e) { (io(e), ...); }, t); }
+
+   void io(std::string& s)
+   {
+      uint64_t n = s.size();
+      io(n);
+      if (restoring())
+         s.resize(n);
+      raw(s.data(), n);
+   }
+
+   template <typename T>
+   void io(std::vector<T>& v)
+   {
+      uint64_t n = io_size(v.size());
+      if (restoring())
+         v.resize(n);
+      io_array(v.data(), n);
+   }
+
+   template <typename T>
+   void io(std::deque<T>& v) { io_sequence(v); }
+
+   template <typename T>
+   void io(std::list<T>& v) { io_sequence(v); }
+
+   template <typename K, typename V>
+   void io(std::map<K, V>& m)
+   {
+      uint64_t n = io_size(m.size());
+      if (restoring())
+      {
+         m.clear();
+         for (uint64_t i = 0; i < n; i++)
+         {
+            K k; V val;
+            io(k); io(val);
+            m.emplace(std::move(k), std::move(val));
+         }
+      }
+      else
+         for (auto& [k, val] : m)
+         {
+            K key = k;
+            io(key); io(val);
+         }
+   }
+
+   template <typename K, typename V>
+   void io(std::unordered_map<K, V>& m)
+   {
+      uint64_t n = io_size(m.size());
+      if (restoring())
+      {
+         m.clear();
+         m.reserve(n);
+         for (uint64_t i = 0; i < n; i++)
+         {
+            K k; V val;
+            io(k); io(val);
+            m.emplace(std::move(k), std::move(val));
+         }
+      }
+      else
+      {
+         std::vector<K> keys;
+         keys.reserve(n);
+         for (const auto& kv : m)
+            keys.push_back(kv.first);
+         std::sort(keys.begin(), keys.end());
+         for (K& k : keys)
+         {
+            io(k); io(m.at(k));
+         }
+      }
+   }
+
+   template <typename K>
+   void io(std::unordered_set<K>& s)
+   {
+      uint64_t n = io_size(s.size());
+      if (restoring())
+      {
+         s.clear();
+         s.reserve(n);
+         for (uint64_t i = 0; i < n; i++)
+         {
+            K k;
+            io(k);
+            s.insert(std::move(k));
+         }
+      }
+      else
+      {
+         std::vector<K> keys(s.begin(), s.end());
+         std::sort(keys.begin(), keys.end());
+         for (K& k : keys)
+            io(k);
+      }
+   }
+
+private:
+   FILE *fp;
+   mode_t mode;
+   std::string path;
+   uint64_t hash;
+   uint64_t num_bytes;
+
+   uint64_t io_size(uint64_t n) { io(n); return n; }
+
+   template <typename C>
+   void io_sequence(C& v)
+   {
+      uint64_t n = io_size(v.size());
+      if (restoring())
+         v.resize(n);
+      for (auto& e : v)
+         io(e);
+   }
+
+   [[noreturn]] void fail(const char *what) const;
+};
+
+// Fingerprint of the configuration parameters; a restore under a different
+// configuration is rejected with the name of the first mismatching parameter.
+void checkpoint_parameters(ckpt_t& c);
+
+// Hooks into the predictor side of the interface, implemented next to the other
+// cbp.h hooks in cond_branch_predictor_interface.cc.
+extern void checkpoint_cond_dir_predictor(ckpt_t& c);
+
+// Structures shared with the predictor interface (sim_common_structs.h).
+inline void ckpt_io(ckpt_t& c, DecodeInfo& d)
+{
+   c.io(d.insn_class);
+   c.io(d.src_reg_info);
+   c.io(d.dst_reg_info);
+}
+
+inline void ckpt_io(ckpt_t& c, ExecuteInfo& e)
+{
+   ckpt_io(c, e.dec_info);
+   c.io(e.taken);
+   c.io(e.next_pc);
+   c.io(e.taken_target);
+   c.io(e.mem_va);
+   c.io(e.mem_sz);
+   c.io(e.dst_reg_value);
+}
+
+inline void ckpt_io(ckpt_t& c, DebugLog& l)
+{
+   c.io(l.pc);
+   c.io(l.next_pc);
+   c.io(l.pred_cycle);
+   c.io(l.fetch_cycle);
+   c.io(l.execute_cycle);
+   c.io(l.pred_dir);
+   c.io(l.taken);
+   c.io(l.predictor_used);
+   c.io(l.src_regs_string);
+   c.io(l.dst_reg);
+   c.io(l.mem_va);
+   c.io(l.inst_class);
+   c.io(l.GHIST);
+   c.io(l.load_dependence);
+   c.io(l.executed);
+}
+
+#endif
@@ -100,6 +100,25 @@ int gzstreambuf::underflow() { // used for input buffer only
     return * reinterpret_cast<unsigned char *>( gptr());    
 }
 
+uint64_t gzstreambuf::tell() {
+    // bytes handed to gzread() minus those still waiting in the get area
+    return gztell( file) - ( egptr() - gptr());
+}
+
+bool gzstreambuf::seek( uint64_t offset) {
+    if ( ! ( mode & std::ios::in) || ! opened)
+        return false;
+    if ( gzseek( file, offset, SEEK_SET) < 0)
+        return false;
+    setg( buffer + 4, buffer + 4, buffer + 4);
+    return true;
+}
+
+uint64_t gzstreambuf::compressed_tell() {
+    z_off_t offset = gzoffset( file);
+    return ( offset < 0) ? 0 : offset;
+}
+
 int gzstreambuf::flush_buffer() {
     // Separate the writing of the buffer from overflow() and
     // sync() operation.
@@ -32,6 +32,7 @@
 // standard C++ with new header file names and std:: namespace
 #include <iostream>
 #include <fstream>
+#include <stdint.h>
 #include <zlib.h>
 
 #ifdef GZSTREAM_NAMESPACE
@@ -65,6 +66,13 @@ public:
     gzstreambuf* open( const char* name, int open_mode);
     gzstreambuf* close();
     ~gzstreambuf() { close(); }
+
+    // Position in the uncompressed stream (input only). seek() is forward
+    // decompression without simulation, used to resume from a checkpoint.
+    uint64_t tell();
+    bool seek( uint64_t offset);
+    // Bytes consumed from the compressed file so far (input only).
+    uint64_t compressed_tell();
     
     virtual int     overflow( int c = EOF);
     virtual int     underflow();
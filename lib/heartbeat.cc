@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "heartbeat.h"
+#include "memstats.h"
+#include "parameters.h"
+
+heartbeat_t::heartbeat_t(const char *trace_path, uint64_t num_inst, uint64_t trace_offset)
+   : next(UINT64_MAX)
+   , fd(-1)
+   , fifo(false)
+   , trace_bytes(0)
+   , start_time(clock_t::now())
+   , last_time(start_time)
+   , start_inst(num_inst)
+   , last_inst(num_inst)
+   , start_offset(trace_offset)
+{
+   if (!HEARTBEAT_INSTS)
+      return;
+   next = num_inst + HEARTBEAT_INSTS;
+
+   struct stat st;
+   if ((stat(trace_path, &st) == 0) && S_ISREG(st.st_mode))
+      trace_bytes = st.st_size;
+
+   if (!HEARTBEAT_FILE)
+      fd = STDERR_FILENO;
+   else if ((stat(HEARTBEAT_FILE, &st) == 0) && S_ISFIFO(st.st_mode))
+   {
+      // A reader that goes away must not kill the run.
+      fifo = true;
+      signal(SIGPIPE, SIG_IGN);
+      open_output();
+   }
+   else if (!open_output())
+   {
+      fprintf(stderr, "Heartbeat: cannot open %s: %s.\n", HEARTBEAT_FILE, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+}
+
+heartbeat_t::~heartbeat_t()
+{
+   if ((fd >= 0) && (fd != STDERR_FILENO))
+      close(fd);
+}
+
+bool heartbeat_t::open_output()
+{
+   if (fifo)
+      fd = open(HEARTBEAT_FILE, O_WRONLY | O_NONBLOCK);   // ENXIO while no reader
+   else
+      fd = open(HEARTBEAT_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+   return (fd >= 0);
+}
+
+void heartbeat_t::emit(const char *line, int len)
+{
+   if ((fd < 0) && !open_output())
+      return;
+   if ((write(fd, line, len) < 0) && fifo && (errno == EPIPE))
+   {
+      // Reader closed the pipe; reopen at the next line.
+      close(fd);
+      fd = -1;
+   }
+}
+
+void heartbeat_t::beat(uint64_t num_inst, uint64_t trace_offset, const sim_progress_t& p, bool done)
+{
+   if (!HEARTBEAT_INSTS)
+      return;
+   next = num_inst + HEARTBEAT_INSTS;
+
+   const clock_t::time_point now = clock_t::now();
+   const double elapsed = std::chrono::duration<double>(now - start_time).count();
+   const double interval = std::chrono::duration<double>(now - last_time).count();
+   const double cur_kips = (interval > 0.0) ? ((num_inst - last_inst) / interval / 1000.0) : 0.0;
+   const double avg_kips = (elapsed > 0.0) ? ((num_inst - start_inst) / elapsed / 1000.0) : 0.0;
+   last_time = now;
+   last_inst = num_inst;
+
+   char line[512];
+   int n = snprintf(line, sizeof(line), "heartbeat: %lu instrs, %.1f KIPS (avg %.1f)", num_inst, cur_kips, avg_kips);
+
+   if (num_inst <= WARMUP_INSTS)
+      n += snprintf(line + n, sizeof(line) - n, ", warm-up");
+   else if (p.instructions)
+   {
+      // The -O clock is synthetic, so only the detailed model has a meaningful IPC.
+      if (!PRED_ONLY && p.cycles)
+         n += snprintf(line + n, sizeof(line) - n, ", IPC %.3f", (double)p.instructions / p.cycles);
+      n += snprintf(line + n, sizeof(line) - n, ", MPKI %.4f", 1000.0 * p.cond_mispredicts / p.instructions);
+   }
+
+   // ru_maxrss can lag the current RSS slightly.
+   const uint64_t rss = resident_bytes();
+   n += snprintf(line + n, sizeof(line) - n, ", RSS %.1f MB (peak %.1f)", rss / (1024.0 * 1024.0), std::max(rss, peak_resident_bytes()) / (1024.0 * 1024.0));
+
+   if (done)
+      n += snprintf(line + n, sizeof(line) - n, ", done in %.1f s", elapsed);
+   else if (trace_bytes)
+   {
+      const double frac = (double)trace_offset / trace_bytes;
+      n += snprintf(line + n, sizeof(line) - n, ", %.1f%% of trace", 100.0 * frac);
+
+      // Extrapolate from the part of the trace read since this process started (a
+      // checkpoint restore has already skipped the rest).
+      const double read = (double)(trace_offset - start_offset) / trace_bytes;
+      if ((read > 0.0) && (frac < 1.0))
+      {
+         const uint64_t eta = (uint64_t)(elapsed * (1.0 - frac) / read);
+         n += snprintf(line + n, sizeof(line) - n, ", ETA %luh%02lum%02lus", eta / 3600, (eta / 60) % 60, eta % 60);
+      }
+   }
+
+   n += snprintf(line + n, sizeof(line) - n, "\n");
+   emit(line, n);
+}
@@ -0,0 +1,51 @@
+#ifndef _HEARTBEAT_H_
+#define _HEARTBEAT_H_
+
+#include <inttypes.h>
+#include <chrono>
+
+// Live progress line (-B <n>[,<path>]).
+//
+// Every n trace instructions one line is written with the instructions simulated, the
+// current and average KIPS, the simulated IPC and conditional MPKI so far, the resident
+// set size, the fraction of the compressed trace consumed and an ETA extrapolated from
+// it. The line goes to stderr, or to <path>: a regular file is appended to (tail -f it),
+// a named pipe is opened non-blocking so a run never waits for, or dies with, a reader;
+// lines are dropped while nobody is listening.
+//
+// The main loop pays one compare per instruction (due()); everything else happens only
+// when a line is written, so the heartbeat can stay on in long sweeps.
+
+struct sim_progress_t {
+   uint64_t instructions;
+   uint64_t cycles;
+   uint64_t cond_mispredicts;
+};
+
+class heartbeat_t {
+private:
+   typedef std::chrono::steady_clock clock_t;
+
+   uint64_t next;               // nInstr of the next line, UINT64_MAX when off
+   int fd;                      // -1 while a pipe has no reader
+   bool fifo;
+   uint64_t trace_bytes;        // compressed trace size, 0 if unknown
+
+   clock_t::time_point start_time;
+   clock_t::time_point last_time;
+   uint64_t start_inst;
+   uint64_t last_inst;
+   uint64_t start_offset;
+
+   bool open_output();
+   void emit(const char *line, int len);
+
+public:
+   heartbeat_t(const char *trace_path, uint64_t num_inst, uint64_t trace_offset);
+   ~heartbeat_t();
+
+   bool due(uint64_t num_inst) const { return num_inst >= next; }
+   void beat(uint64_t num_inst, uint64_t trace_offset, const sim_progress_t& p, bool done = false);
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <vector>
+#include <algorithm>
+#include "hugepage.h"
+#include "parameters.h"
+
+#define MB(bytes) ((double)(bytes) / (1024.0 * 1024.0))
+
+enum class backing_t : uint8_t {
+   Heap,          // operator new (-G off)
+   Transparent,   // madvise(MADV_HUGEPAGE)
+   Explicit       // MAP_HUGETLB
+};
+
+struct table_region_t {
+   void *p;
+   size_t bytes;
+   size_t mapped;        // length of its own mapping; 0: heap or a shared chunk
+   backing_t backing;
+};
+
+struct table_chunk_t {
+   char *base;
+   size_t used;
+   backing_t backing;
+};
+
+struct table_storage_t {
+   std::vector<table_region_t> tables;
+   std::vector<table_chunk_t> chunks;
+   uint64_t explicit_fallbacks = 0;   // MAP_HUGETLB failed, THP used instead
+   uint64_t madvise_failures = 0;
+};
+
+// Tables are allocated from static constructors too (CBP2016_TAGE_SC_L), so the
+// bookkeeping must not depend on the initialization order of this file.
+static table_storage_t& storage()
+{
+   static table_storage_t s;
+   return s;
+}
+
+static const char *mode_name()
+{
+   return (HUGEPAGE_MODE == hugepage_mode_t::Explicit) ? "explicit" : "thp";
+}
+
+// A len-byte (multiple of HUGEPAGE_SIZE) mapping aligned on HUGEPAGE_SIZE.
+static void *map_huge(size_t len, backing_t& backing)
+{
+   table_storage_t& s = storage();
+   if (HUGEPAGE_MODE == hugepage_mode_t::Explicit) {
+      void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED) {
+         backing = backing_t::Explicit;
+         return p;
+      }
+      s.explicit_fallbacks++;
+   }
+
+   // Over-map by one huge page and keep the aligned window.
+   char *raw = (char *)mmap(NULL, len + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (raw == MAP_FAILED) {
+      fprintf(stderr, "Huge pages (-G %s): cannot map %zu bytes for a table.\n", mode_name(), len);
+      exit(EXIT_FAILURE);
+   }
+   char *p = (char *)(((uintptr_t)raw + HUGEPAGE_SIZE - 1) & ~(uintptr_t)(HUGEPAGE_SIZE - 1));
+   if (p > raw)
+      munmap(raw, p - raw);
+   if (raw + HUGEPAGE_SIZE > p)
+      munmap(p + len, raw + HUGEPAGE_SIZE - p);
+   if (madvise(p, len, MADV_HUGEPAGE) != 0)
+      s.madvise_failures++;
+   backing = backing_t::Transparent;
+   return p;
+}
+
+void *table_alloc(size_t bytes)
+{
+   table_storage_t& s = storage();
+   table_region_t r = {NULL, std::max(bytes, (size_t)1), 0, backing_t::Heap};
+
+   if (HUGEPAGE_MODE == hugepage_mode_t::Off) {
+      r.p = ::operator new(r.bytes, std::align_val_t(64));
+   }
+   else if (r.bytes >= HUGEPAGE_OWN_MAPPING) {
+      r.mapped = (r.bytes + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+      r.p = map_huge(r.mapped, r.backing);
+   }
+   else {
+      const size_t size = (r.bytes + 63) & ~(size_t)63;
+      if (s.chunks.empty() || (s.chunks.back().used + size > HUGEPAGE_SIZE)) {
+         table_chunk_t c = {NULL, 0, backing_t::Heap};
+         c.base = (char *)map_huge(HUGEPAGE_SIZE, c.backing);
+         s.chunks.push_back(c);
+      }
+      table_chunk_t& c = s.chunks.back();
+      r.p = c.base + c.used;
+      r.backing = c.backing;
+      c.used += size;
+   }
+
+   s.tables.push_back(r);
+   return r.p;
+}
+
+void table_free(void *p)
+{
+   table_storage_t& s = storage();
+   auto it = std::find_if(s.tables.begin(), s.tables.end(), [p](const table_region_t& r) { return r.p == p; });
+   assert(it != s.tables.end());
+   if (it->backing == backing_t::Heap)
+      ::operator delete(p, std::align_val_t(64));
+   else if (it->mapped)
+      munmap(p, it->mapped);
+   s.tables.erase(it);
+}
+
+// AnonHugePages of the whole process, in bytes (THP only; MAP_HUGETLB pages are not counted).
+static uint64_t anon_huge_bytes()
+{
+   FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+   if (!fp)
+      return 0;
+   char line[256];
+   uint64_t kb = 0;
+   while (fgets(line, sizeof(line), fp))
+      if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+         break;
+   fclose(fp);
+   return kb * 1024;
+}
+
+void hugepage_report()
+{
+   if (HUGEPAGE_MODE == hugepage_mode_t::Off)
+      return;
+
+   const table_storage_t& s = storage();
+   uint64_t bytes = 0, own = 0, own_bytes = 0, chunked = 0;
+   uint64_t mapped[3] = {0, 0, 0};
+   for (const table_region_t& r : s.tables) {
+      bytes += r.bytes;
+      if (r.mapped) {
+         own++;
+         own_bytes += r.bytes;
+         mapped[(int)r.backing] += r.mapped;
+      }
+      else {
+         chunked++;
+      }
+   }
+   for (const table_chunk_t& c : s.chunks)
+      mapped[(int)c.backing] += HUGEPAGE_SIZE;
+
+   fprintf(stderr, "Huge pages (-G %s): %zu tables, %.1f MB: %lu in their own mappings (%.1f MB), %lu packed in %zu shared 2 MB chunk(s).\n",
+           mode_name(), s.tables.size(), MB(bytes), own, MB(own_bytes), chunked, s.chunks.size());
+   if (mapped[(int)backing_t::Explicit])
+      fprintf(stderr, "Huge pages (-G %s): %.1f MB on MAP_HUGETLB pages.\n", mode_name(), MB(mapped[(int)backing_t::Explicit]));
+   if (s.explicit_fallbacks)
+      fprintf(stderr, "Huge pages (-G %s): no free MAP_HUGETLB pages for %lu mapping(s), used THP instead (reserve them in /proc/sys/vm/nr_hugepages).\n",
+              mode_name(), s.explicit_fallbacks);
+   if (mapped[(int)backing_t::Transparent]) {
+      if (s.madvise_failures)
+         fprintf(stderr, "Huge pages (-G %s): madvise(MADV_HUGEPAGE) failed for %lu mapping(s); the kernel has no THP support.\n",
+                 mode_name(), s.madvise_failures);
+      fprintf(stderr, "Huge pages (-G %s): %.1f MB madvised for THP; the process has %.1f MB on transparent huge pages "
+              "(none: see /sys/kernel/mm/transparent_hugepage/enabled).\n",
+              mode_name(), MB(mapped[(int)backing_t::Transparent]), MB(anon_huge_bytes()));
+   }
+}
@@ -0,0 +1,70 @@
+#ifndef _HUGEPAGE_H_
+#define _HUGEPAGE_H_
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <new>
+#include <memory>
+
+// Storage for the fixed-size tables that are indexed at random on every branch or memory
+// access: the cache_t arrays and the TAGE-SC-L and ITTAGE banks. With -G they are backed
+// by 2 MB pages, so they cost the host a few TLB entries instead of one per 4 KB.
+//
+// Each table is one contiguous, cache-line aligned allocation:
+//  - -G off (default): operator new.
+//  - tables of HUGEPAGE_OWN_MAPPING bytes or more get a mapping of their own, rounded up
+//    to and aligned on 2 MB; smaller ones are packed into shared 2 MB chunks, so that all
+//    predictor tables together take a couple of huge pages. Space freed in a shared
+//    chunk is not reused.
+//  - -G explicit maps with MAP_HUGETLB (pages reserved in /proc/sys/vm/nr_hugepages); when
+//    none are free it falls back to -G thp for that mapping.
+//  - -G thp madvise(MADV_HUGEPAGE)s an aligned anonymous mapping; the kernel backs it with
+//    huge pages if /sys/kernel/mm/transparent_hugepage/enabled is "always" or "madvise",
+//    otherwise it stays on 4 KB pages.
+// hugepage_report() says on stderr what each table ended up on.
+
+enum class hugepage_mode_t : uint8_t {
+   Off,
+   Transparent,
+   Explicit
+};
+
+constexpr size_t HUGEPAGE_SIZE = 2 * 1024 * 1024;
+constexpr size_t HUGEPAGE_OWN_MAPPING = HUGEPAGE_SIZE / 2;
+
+void *table_alloc(size_t bytes);
+void table_free(void *p);
+
+// new T[n] / delete[] on table storage.
+template <typename T>
+T *table_new(size_t n)
+{
+   T *p = (T *)table_alloc(n * sizeof(T));
+   for (size_t i = 0; i < n; i++)
+      new (&p[i]) T;
+   return p;
+}
+
+template <typename T>
+void table_delete(T *p, size_t n)
+{
+   if (!p)
+      return;
+   for (size_t i = 0; i < n; i++)
+      p[i].~T();
+   table_free(p);
+}
+
+// Moves a table allocated before -G was parsed (static initialization) to table storage.
+template <typename T>
+T *table_move(T *p, size_t n)
+{
+   T *q = (T *)table_alloc(n * sizeof(T));
+   std::uninitialized_move(p, p + n, q);
+   table_delete(p, n);
+   return q;
+}
+
+void hugepage_report();
+
+#endif
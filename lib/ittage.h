@@ -33,6 +33,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
+#include "checkpoint.h"
+#include "hugepage.h"
 
 #ifndef _ITTAGE_H
 #define _ITTAGE_H
@@ -90,6 +92,13 @@ public:
     u = 0;
     tag = 0;
   }
+
+  void checkpoint(ckpt_t &c) {
+    c.io(target);
+    c.io(ctr);
+    c.io(tag);
+    c.io(u);
+  }
 };
 
 class IPREDICTOR {
@@ -137,6 +146,7 @@ public:
   uint64_t target_inter;
 
   IPREDICTOR(void) { reinit(); }
+  ~IPREDICTOR() { table_delete(itable[0], (NHIST + 1) << LOGG); }
 
   void reinit() {
     m[0] = 0;
@@ -153,8 +163,10 @@ public:
       logg[i] = LOGG;
     }
 
-    for (int i = 0; i <= NHIST; i++)
-      itable[i] = new ientry[(1 << LOGG)];
+    // All banks in one contiguous table (huge pages with -G).
+    itable[0] = table_new<ientry>((NHIST + 1) << LOGG);
+    for (int i = 1; i <= NHIST; i++)
+      itable[i] = itable[0] + (i << LOGG);
 
     for (int i = 0; i <= NHIST; i++) {
       ch_i[i].init(m[i], (logg[i]));
@@ -423,6 +435,32 @@ public:
 
     // END PREDICTOR UPDATE
   }
+
+  // Table geometry (m, TB, logg) is fixed at construction and not saved.
+  void checkpoint(ckpt_t &c) {
+    c.io(use_alt_on_na);
+    c.io(GHIST);
+    c.io(TICK);
+    c.io(ghist);
+    c.io(ptghist);
+    c.io(phist);
+    for (int i = 0; i <= NHIST; i++) {
+      c.io(ch_i[i].comp);
+      c.io(ch_t[0][i].comp);
+      c.io(ch_t[1][i].comp);
+      c.io_array(itable[i], (1 << LOGG));
+    }
+    c.io(GI);
+    c.io(GTAG);
+    c.io(pred_target);
+    c.io(alt_target);
+    c.io(tage_target);
+    c.io(LongestMatchPred);
+    c.io(HitBank);
+    c.io(AltBank);
+    c.io(Seed);
+    c.io(target_inter);
+  }
 #undef NHIST
 #undef MINHIST
 #undef MAXHIST
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string>
+#include <algorithm>
+#include "loadprof.h"
+#include "trace_reader.h"
+
+static constexpr uint32_t NO_SLOT = UINT32_MAX;
+static constexpr uint8_t L1_LEVEL = 1;
+
+load_profiler_t::load_profiler_t(uint64_t size, uint64_t num_regs, uint64_t zero_reg)
+   : slots(size)
+   , heap(size)
+   , heap_pos(size)
+   , reg_source(size ? num_regs : 0)
+   , zero_reg(zero_reg)
+{
+   index.reserve(size);
+   reset();
+}
+
+// All slots free (0 misses), in slot order, which is a valid heap.
+void load_profiler_t::reset()
+{
+   for (uint64_t s = 0; s < slots.size(); s++) {
+      slots[s] = entry_t{};
+      heap[s] = s;
+      heap_pos[s] = s;
+   }
+   index.clear();
+   for (reg_source_t& r : reg_source)
+      r = reg_source_t{0, NO_SLOT, 0};
+   total_loads = 0;
+   total_misses = 0;
+}
+
+void load_profiler_t::end_warmup()
+{
+   if (enabled())
+      reset();
+}
+
+void load_profiler_t::heap_swap(uint64_t a, uint64_t b)
+{
+   std::swap(heap[a], heap[b]);
+   heap_pos[heap[a]] = a;
+   heap_pos[heap[b]] = b;
+}
+
+// The slot at pos just had its count incremented.
+void load_profiler_t::sift_down(uint64_t pos)
+{
+   const uint64_t n = heap.size();
+   for (;;) {
+      uint64_t least = pos;
+      const uint64_t left = 2 * pos + 1;
+      const uint64_t right = left + 1;
+      if ((left < n) && (slots[heap[left]].misses < slots[heap[least]].misses))
+         least = left;
+      if ((right < n) && (slots[heap[right]].misses < slots[heap[least]].misses))
+         least = right;
+      if (least == pos)
+         return;
+      heap_swap(pos, least);
+      pos = least;
+   }
+}
+
+// Counts a miss of pc (in slot, or NO_SLOT if untracked); returns its slot.
+uint32_t load_profiler_t::miss(uint64_t pc, uint32_t slot)
+{
+   if (slot == NO_SLOT) {
+      slot = heap[0];
+      entry_t& e = slots[slot];
+      const uint64_t inherited = e.misses;
+      if (inherited)
+         index.erase(e.pc);
+      e = entry_t{};
+      e.pc = pc;
+      e.misses = inherited;
+      e.error = inherited;
+      index.emplace(pc, slot);
+   }
+   slots[slot].misses++;
+   sift_down(heap_pos[slot]);
+   return slot;
+}
+
+const load_profiler_t::reg_source_t *load_profiler_t::source(bool valid, uint64_t reg) const
+{
+   if (!valid || (reg == zero_reg) || !reg_source[reg].pc)
+      return NULL;
+   return &reg_source[reg];
+}
+
+void load_profiler_t::dependent_branch(const reg_source_t& s)
+{
+   uint32_t slot = s.slot;
+   if ((slot == NO_SLOT) || (slots[slot].pc != s.pc)) {
+      // Not tracked when it executed, or evicted since: look it up again.
+      auto it = index.find(s.pc);
+      if (it == index.end())
+         return;
+      slot = it->second;
+   }
+   slots[slot].dependent_branches++;
+}
+
+void load_profiler_t::step(const db_t *inst, uint8_t level, uint64_t latency)
+{
+   const reg_source_t *a = source(inst->A.valid, inst->A.log_reg);
+   const reg_source_t *b = source(inst->B.valid, inst->B.log_reg);
+   const reg_source_t *c = source(inst->C.valid, inst->C.log_reg);
+
+   // Each load a branch depends on counts the branch once.
+   if (is_cond_br(inst->insn_class)) {
+      if (a)
+         dependent_branch(*a);
+      if (b && !(a && (a->pc == b->pc)))
+         dependent_branch(*b);
+      if (c && !(a && (a->pc == c->pc)) && !(b && (b->pc == c->pc)))
+         dependent_branch(*c);
+   }
+
+   const bool writes_reg = inst->D.valid && (inst->D.log_reg != zero_reg);
+   if (inst->is_load) {
+      total_loads++;
+      auto it = index.find(inst->pc);
+      uint32_t slot = (it == index.end()) ? NO_SLOT : it->second;
+      if (level > L1_LEVEL) {
+         total_misses++;
+         slot = miss(inst->pc, slot);
+      }
+      if (slot != NO_SLOT) {
+         entry_t& e = slots[slot];
+         e.loads++;
+         e.level[level]++;
+         e.latency += latency;
+      }
+      if (writes_reg)
+         reg_source[inst->D.log_reg] = reg_source_t{inst->pc, slot, 0};
+   }
+   else if (writes_reg) {
+      const reg_source_t *nearest = a;
+      if (b && (!nearest || (b->hops < nearest->hops)))
+         nearest = b;
+      if (c && (!nearest || (c->hops < nearest->hops)))
+         nearest = c;
+      const reg_source_t r = (nearest && (nearest->hops < MAX_HOPS))
+                              ? reg_source_t{nearest->pc, nearest->slot, (uint8_t)(nearest->hops + 1)}
+                              : reg_source_t{0, NO_SLOT, 0};
+      reg_source[inst->D.log_reg] = r;
+   }
+}
+
+// Tracked slots, most misses first.
+std::vector<uint32_t> load_profiler_t::ranked() const
+{
+   std::vector<uint32_t> r;
+   for (uint64_t s = 0; s < slots.size(); s++)
+      if (slots[s].misses)
+         r.push_back(s);
+   std::sort(r.begin(), r.end(), [this](uint32_t x, uint32_t y) {
+      if (slots[x].misses != slots[y].misses)
+         return slots[x].misses > slots[y].misses;
+      return slots[x].pc < slots[y].pc;
+   });
+   return r;
+}
+
+void load_profiler_t::output(const std::string& prefix) const
+{
+   if (!enabled())
+      return;
+
+   const std::vector<uint32_t> r = ranked();
+   uint64_t guaranteed = 0;
+   for (uint32_t s : r)
+      guaranteed += slots[s].misses - slots[s].error;
+
+   auto pct = [](uint64_t n, uint64_t d) { return d ? (100.0 * (double)n / (double)d) : 0.0; };
+
+   printf("---------------------------------LOAD PROFILE (top %lu load PCs by L1 misses)---------------------------------------------------------\n", slots.size());
+   printf("loads = %lu, L1 misses = %lu (not served by the SQ or the L1)\n", total_loads, total_misses);
+   printf("tracked PCs = %lu, their guaranteed misses (misses - error) = %lu (%.2f%% of all L1 misses)\n",
+          r.size(), guaranteed, pct(guaranteed, total_misses));
+   printf("(since each PC entered the table: %% of its loads served by each level, mean AGEN-to-data latency, dependent conditional branches)\n");
+   printf("%18s %12s %10s %12s %6s %6s %6s %6s %6s %8s %12s\n",
+          "pc", "misses", "+-error", "loads", "SQ%", "L1%", "L2%", "L3%", "mem%", "latency", "dep_branches");
+   for (uint64_t k = 0; (k < r.size()) && (k < PRINT_ROWS); k++) {
+      const entry_t& e = slots[r[k]];
+      printf("%18lx %12lu %10lu %12lu %6.2f %6.2f %6.2f %6.2f %6.2f %8.2f %12lu\n",
+             e.pc, e.misses, e.error, e.loads,
+             pct(e.level[0], e.loads), pct(e.level[1], e.loads), pct(e.level[2], e.loads),
+             pct(e.level[3], e.loads), pct(e.level[4], e.loads),
+             e.loads ? ((double)e.latency / (double)e.loads) : 0.0, e.dependent_branches);
+   }
+
+   const std::string path = prefix + "_loads.csv";
+   FILE *csv = fopen(path.c_str(), "w");
+   if (!csv) {
+      fprintf(stderr, "Load profile: cannot open %s for writing.\n", path.c_str());
+      exit(EXIT_FAILURE);
+   }
+   fprintf(csv, "pc,misses,error,loads,sq,l1,l2,l3,memory,mean_latency,dependent_branches\n");
+   for (uint32_t s : r) {
+      const entry_t& e = slots[s];
+      fprintf(csv, "0x%lx,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.4f,%lu\n",
+              e.pc, e.misses, e.error, e.loads, e.level[0], e.level[1], e.level[2], e.level[3], e.level[4],
+              e.loads ? ((double)e.latency / (double)e.loads) : 0.0, e.dependent_branches);
+   }
+   fclose(csv);
+   printf("Load profile (all %lu tracked PCs): %s\n", r.size(), path.c_str());
+}
+
+void load_profiler_t::entry_t::checkpoint(ckpt_t& c)
+{
+   c.io(pc);
+   c.io(misses);
+   c.io(error);
+   c.io(loads);
+   c.io(level);
+   c.io(latency);
+   c.io(dependent_branches);
+}
+
+void load_profiler_t::reg_source_t::checkpoint(ckpt_t& c)
+{
+   c.io(pc);
+   c.io(slot);
+   c.io(hops);
+}
+
+void load_profiler_t::checkpoint(ckpt_t& c)
+{
+   c.io(slots);
+   c.io(index);
+   c.io(heap);
+   c.io(heap_pos);
+   c.io(reg_source);
+   c.io(total_loads);
+   c.io(total_misses);
+}
+
+mem_usage_t load_profiler_t::memory() const
+{
+   mem_usage_t u = mem_usage(slots);
+   u += mem_usage(index);
+   u += mem_usage(heap);
+   u += mem_usage(heap_pos);
+   u += mem_usage(reg_source);
+   return u;
+}
@@ -0,0 +1,94 @@
+#ifndef _LOADPROF_H_
+#define _LOADPROF_H_
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "checkpoint.h"
+#include "memstats.h"
+
+struct db_t;
+
+// Per-PC load profile (-L <K>): the K load PCs with the most L1 misses, written to the
+// result log and to <trace>_loads.csv.
+//
+// The table is a space-saving summary (Metwally et al., ICDT 2005) of the L1-missing loads,
+// so its memory is fixed by K whatever the trace: a miss of a tracked PC increments its
+// count; a miss of an untracked one takes over the entry with the fewest misses, inheriting
+// its count as the error bound. Every PC whose true miss count exceeds (all misses) / K
+// is in the table, and a count minus its error is a lower bound of the true count. A miss
+// is a load that read some byte from the cache hierarchy (not the SQ) and did not find
+// it in the L1.
+//
+// For each tracked PC, since it (last) entered the table: its loads, where each one was
+// served from (SQ: all bytes forwarded, else the level that had the block), the mean of
+// their latency as step() computes it (AGEN to data), and the conditional branches that
+// depend on it. A branch depends on the load whose value reaches one of its sources
+// through at most MAX_HOPS other instructions (a compare, an extend, ...): each register
+// remembers the nearest load its value comes from.
+
+class load_profiler_t {
+public:
+   static constexpr uint64_t NUM_LEVELS = 5;     // SQ, L1, L2, L3, memory
+   static constexpr uint8_t SQ_LEVEL = 0;
+   static constexpr uint8_t MAX_HOPS = 2;
+   static constexpr uint64_t PRINT_ROWS = 20;    // of the result log table; the csv has all K
+
+   load_profiler_t(uint64_t size, uint64_t num_regs, uint64_t zero_reg);
+
+   bool enabled() const { return !slots.empty(); }
+
+   // Every micro-op, once its latency is known; level: where a load was served from
+   // (SQ_LEVEL, or 1 + the cache_access_t level of its L1 lookup).
+   void step(const db_t *inst, uint8_t level, uint64_t latency);
+
+   void end_warmup();
+   void output(const std::string& prefix) const;
+   void checkpoint(ckpt_t& c);
+   mem_usage_t memory() const;
+
+private:
+   struct entry_t {
+      uint64_t pc;
+      uint64_t misses;               // overestimate, by at most error
+      uint64_t error;
+      uint64_t loads;
+      uint64_t level[NUM_LEVELS];
+      uint64_t latency;              // sum over loads
+      uint64_t dependent_branches;
+
+      void checkpoint(ckpt_t& c);
+   };
+
+   // Nearest load a register's value comes from; slot lets a branch find its entry
+   // without a lookup, valid while slots[slot].pc is still pc.
+   struct reg_source_t {
+      uint64_t pc;                   // 0: none
+      uint32_t slot;
+      uint8_t hops;
+
+      void checkpoint(ckpt_t& c);
+   };
+
+   std::vector<entry_t> slots;
+   std::unordered_map<uint64_t, uint32_t> index;   // pc -> slot
+   std::vector<uint32_t> heap;                     // all slots, min-heap on misses (0: free)
+   std::vector<uint32_t> heap_pos;                 // slot -> position in heap
+   std::vector<reg_source_t> reg_source;
+   uint64_t zero_reg;
+
+   uint64_t total_loads;
+   uint64_t total_misses;
+
+   void reset();
+   void sift_down(uint64_t pos);
+   void heap_swap(uint64_t a, uint64_t b);
+   uint32_t miss(uint64_t pc, uint32_t slot);
+   const reg_source_t *source(bool valid, uint64_t reg) const;
+   void dependent_branch(const reg_source_t& s);
+   std::vector<uint32_t> ranked() const;
+};
+
+#endif
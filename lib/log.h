@@ -8,10 +8,11 @@ extern int U_incrment;
 struct log_files
 {
     std::string file_name;
-    FILE *result;
-    FILE *history;
-    FILE *pred_history;
-    FILE *CyclWP_summary;
+    std::string prefix;     // output/<config>/<trace>/<trace>, for the other per-run files
+    FILE *result = NULL;        // all NULL until init(), e.g. on a usage error
+    FILE *history = NULL;
+    FILE *pred_history = NULL;
+    FILE *CyclWP_summary = NULL;
 
     void init(std::string path_str){
         std::string file_name = std::filesystem::path(path_str).filename();
@@ -23,6 +24,7 @@ struct log_files
         std::filesystem::path output_path = std::filesystem::path("output") / sub_dir / file_name;
         std::filesystem::create_directories(output_path);
         output_path /= file_name;
+        prefix = output_path.string();
         
         std::string result_filename = output_path.string() + "_result.log";
         std::string history_filename = output_path.string() + "_history.log";
@@ -40,6 +42,9 @@ struct log_files
           fclose(result); // Close the file if redirection fails
           return; // Handle the error as needed
       }
+        // Share one stream: two independent FILEs on the same path overwrite each other.
+        fclose(result);
+        result = stdout;
       
         printf("Result log file: %s\n", result_filename.c_str());
         printf("History log file: %s\n", history_filename.c_str());
@@ -48,9 +53,10 @@ struct log_files
     }
 
     ~log_files(){
-        fclose(result);
-        fclose(history);
-        fclose(pred_history);
-        fclose(CyclWP_summary);
+        if (result && (result != stdout))
+            fclose(result);
+        for (FILE *fp : {history, pred_history, CyclWP_summary})
+            if (fp)
+                fclose(fp);
     }
 };
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include "memstats.h"
+#include "parameters.h"
+#include "log.h"
+
+extern log_files files;
+
+#define MB(bytes) ((double)(bytes) / (1024.0 * 1024.0))
+
+uint64_t resident_bytes()
+{
+   unsigned long size, resident;
+   FILE *fp = fopen("/proc/self/statm", "r");
+   if (!fp)
+      return 0;
+   const bool ok = (fscanf(fp, "%lu %lu", &size, &resident) == 2);
+   fclose(fp);
+   return ok ? ((uint64_t)resident * sysconf(_SC_PAGESIZE)) : 0;
+}
+
+uint64_t peak_resident_bytes()
+{
+   struct rusage ru;
+   return (getrusage(RUSAGE_SELF, &ru) == 0) ? ((uint64_t)ru.ru_maxrss * 1024) : 0;
+}
+
+memstats_t::memstats_t()
+   : next(MEMSTATS_ENABLE ? EPOCH_SIZE_INSTS : UINT64_MAX)
+   , csv(NULL)
+   , num_samples(0)
+   , last_inst(0)
+   , peak_rss(0)
+   , peak_rss_inst(0)
+{
+}
+
+memstats_t::~memstats_t()
+{
+   if (csv)
+      fclose(csv);
+}
+
+void memstats_t::track(const std::string& name, std::function<mem_usage_t()> usage)
+{
+   tracked.push_back({name, usage, {0, 0}, {0, 0}, 0, 0});
+}
+
+void memstats_t::sample(uint64_t num_inst)
+{
+   next = (num_inst / EPOCH_SIZE_INSTS + 1) * EPOCH_SIZE_INSTS;
+   if (num_inst == last_inst && num_samples)
+      return;
+
+   if (!csv)
+   {
+      const std::string path = files.prefix + "_memory.csv";
+      csv = fopen(path.c_str(), "w");
+      if (!csv)
+      {
+         fprintf(stderr, "Memory report: cannot open %s for writing.\n", path.c_str());
+         exit(EXIT_FAILURE);
+      }
+      fprintf(csv, "instructions,rss_bytes,tracked_bytes");
+      for (const tracked_t& t : tracked)
+         fprintf(csv, ",%s.entries,%s.bytes", t.name.c_str(), t.name.c_str());
+      fprintf(csv, "\n");
+   }
+
+   std::vector<mem_usage_t> prev(tracked.size());
+   uint64_t total = 0;
+   for (size_t i = 0; i < tracked.size(); i++)
+   {
+      tracked_t& t = tracked[i];
+      prev[i] = t.last;
+      t.last = t.usage();
+      total += t.last.bytes;
+      t.peak.entries = std::max(t.peak.entries, t.last.entries);
+      if (t.last.bytes > t.peak.bytes)
+      {
+         t.peak.bytes = t.last.bytes;
+         t.peak_inst = num_inst;
+      }
+   }
+
+   const uint64_t rss = resident_bytes();
+   if (rss > peak_rss)
+   {
+      peak_rss = rss;
+      peak_rss_inst = num_inst;
+      for (tracked_t& t : tracked)
+         t.bytes_at_peak_rss = t.last.bytes;
+   }
+
+   fprintf(csv, "%lu,%lu,%lu", num_inst, rss, total);
+   for (const tracked_t& t : tracked)
+      fprintf(csv, ",%lu,%lu", t.last.entries, t.last.bytes);
+   fprintf(csv, "\n");
+   fflush(csv);
+
+   const uint64_t prev_inst = last_inst;
+   num_samples++;
+   last_inst = num_inst;
+
+   if (MEMSTATS_MAX_MB && (rss > MEMSTATS_MAX_MB * 1024 * 1024))
+      over_cap(num_inst, prev_inst, rss, prev);
+}
+
+void memstats_t::print_table(FILE *fp) const
+{
+   uint64_t total = 0;
+   uint64_t total_peak = 0;
+   uint64_t total_at_peak_rss = 0;
+
+   fprintf(fp, "-------------------------------MEMORY (-m, sampled every %lu instrs, estimated heap bytes per structure)-------------------------------\n", EPOCH_SIZE_INSTS);
+   fprintf(fp, "%-40s %14s %12s %14s %12s %14s %16s\n", "structure", "entries", "MB", "peak entries", "peak MB", "at instr", "MB at peak RSS");
+   for (const tracked_t& t : tracked)
+   {
+      fprintf(fp, "%-40s %14lu %12.2f %14lu %12.2f %14lu %16.2f\n", t.name.c_str(), t.last.entries, MB(t.last.bytes),
+              t.peak.entries, MB(t.peak.bytes), t.peak_inst, MB(t.bytes_at_peak_rss));
+      total += t.last.bytes;
+      total_peak += t.peak.bytes;
+      total_at_peak_rss += t.bytes_at_peak_rss;
+   }
+   fprintf(fp, "%-40s %14s %12.2f %14s %12.2f %14s %16.2f\n", "tracked total", "", MB(total), "", MB(total_peak), "", MB(total_at_peak_rss));
+   fprintf(fp, "RSS = %.2f MB at the last sample, highest sampled %.2f MB at instr %lu (%.2f MB of it tracked), process peak %.2f MB\n",
+           MB(resident_bytes()), MB(peak_rss), peak_rss_inst, MB(total_at_peak_rss), MB(std::max(peak_rss, peak_resident_bytes())));
+   fprintf(fp, "---------------------------------------------------------------------------------------------------------------------------------------\n");
+}
+
+void memstats_t::report() const
+{
+   if (MEMSTATS_ENABLE)
+      print_table(stdout);
+}
+
+void memstats_t::over_cap(uint64_t num_inst, uint64_t prev_inst, uint64_t rss, const std::vector<mem_usage_t>& prev)
+{
+   std::vector<size_t> order(tracked.size());
+   for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+   std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return tracked[a].last.bytes > tracked[b].last.bytes; });
+
+   uint64_t total = 0;
+   for (const tracked_t& t : tracked)
+      total += t.last.bytes;
+
+   fprintf(stderr, "Memory cap exceeded: RSS %.1f MB > %lu MB (-m) at instruction %lu.\n", MB(rss), MEMSTATS_MAX_MB, num_inst);
+   fprintf(stderr, "Tracked structures hold %.1f MB; largest, with growth since the previous sample (instr %lu):\n", MB(total), prev_inst);
+   for (size_t k = 0; (k < order.size()) && (k < 5); k++)
+   {
+      const tracked_t& t = tracked[order[k]];
+      const mem_usage_t& p = prev[order[k]];
+      fprintf(stderr, "   %-40s %14lu entries %10.1f MB (%+.1f MB, %+ld entries)\n", t.name.c_str(), t.last.entries, MB(t.last.bytes),
+              MB(t.last.bytes) - MB(p.bytes), (int64_t)(t.last.entries - p.entries));
+   }
+   if (rss > 2 * total)
+      fprintf(stderr, "Most of the RSS is not in the tracked structures (fixed-size tables, or structures not registered with the memory report).\n");
+   fprintf(stderr, "Stopping. Samples up to this point are in %s_memory.csv.\n", files.prefix.c_str());
+
+   print_table(stdout);
+   fflush(stdout);
+   fclose(csv);
+   csv = NULL;
+   exit(EXIT_FAILURE);
+}
@@ -0,0 +1,120 @@
+#ifndef _MEMSTATS_H_
+#define _MEMSTATS_H_
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+
+// Memory accounting of the structures that grow with the run (-m <max_MB>).
+//
+// Components register each such structure once, next to the structure, with a function
+// returning its entry count and estimated heap bytes; nothing is read until a sample is
+// taken. A sample is taken every EPOCH_SIZE_INSTS trace instructions: it appends a row to
+// <prefix>_memory.csv, updates each structure's peak and, when the RSS is the highest
+// seen so far, remembers the breakdown at that point. The table at the end of the result
+// log gives, per structure, the final size, the peak and the size at peak RSS.
+//
+// With max_MB > 0, a sample whose RSS exceeds it stops the run: the largest structures
+// and their growth since the previous sample are reported on stderr, the table is
+// written to the result log, and cbp exits with an error.
+//
+// Byte counts are estimates for libstdc++ containers (element payload, node and bucket
+// overhead, malloc headers); memory owned by the elements themselves is not included.
+
+struct mem_usage_t {
+   uint64_t entries;
+   uint64_t bytes;
+
+   mem_usage_t& operator+=(const mem_usage_t& o)
+   {
+      entries += o.entries;
+      bytes += o.bytes;
+      return *this;
+   }
+};
+
+constexpr uint64_t MEM_MALLOC_OVERHEAD = 16;
+
+template <typename T>
+mem_usage_t mem_usage(const std::vector<T>& v)
+{
+   return {v.size(), v.capacity() * sizeof(T)};
+}
+
+template <typename T>
+mem_usage_t mem_usage(const std::deque<T>& d)
+{
+   const uint64_t per_node = std::max((uint64_t)1, (uint64_t)(512 / sizeof(T)));
+   const uint64_t nodes = d.size() / per_node + 1;
+   return {d.size(), nodes * (per_node * sizeof(T) + MEM_MALLOC_OVERHEAD)};
+}
+
+template <typename T>
+mem_usage_t mem_usage(const std::list<T>& l)
+{
+   return {l.size(), l.size() * (sizeof(T) + 2 * sizeof(void *) + MEM_MALLOC_OVERHEAD)};
+}
+
+template <typename K, typename V>
+mem_usage_t mem_usage(const std::unordered_map<K, V>& m)
+{
+   return {m.size(), m.size() * (sizeof(void *) + sizeof(std::pair<const K, V>) + MEM_MALLOC_OVERHEAD) + m.bucket_count() * sizeof(void *)};
+}
+
+template <typename K>
+mem_usage_t mem_usage(const std::unordered_set<K>& s)
+{
+   return {s.size(), s.size() * (sizeof(void *) + sizeof(K) + MEM_MALLOC_OVERHEAD) + s.bucket_count() * sizeof(void *)};
+}
+
+// Resident set size of the simulator process and its peak so far, in bytes.
+uint64_t resident_bytes();
+uint64_t peak_resident_bytes();
+
+class memstats_t {
+public:
+   memstats_t();
+   ~memstats_t();
+
+   void track(const std::string& name, std::function<mem_usage_t()> usage);
+
+   bool due(uint64_t num_inst) const { return num_inst >= next; }
+   void sample(uint64_t num_inst);
+
+   // End-of-run table in the result log; the caller takes a last sample first.
+   void report() const;
+
+private:
+   struct tracked_t {
+      std::string name;
+      std::function<mem_usage_t()> usage;
+      mem_usage_t last;
+      mem_usage_t peak;            // highest entries and highest bytes, taken separately
+      uint64_t peak_inst;          // sample with the highest bytes
+      uint64_t bytes_at_peak_rss;
+   };
+
+   std::vector<tracked_t> tracked;
+   uint64_t next;               // nInstr of the next sample, UINT64_MAX when off
+   FILE *csv;
+   uint64_t num_samples;
+   uint64_t last_inst;
+   uint64_t peak_rss;
+   uint64_t peak_rss_inst;
+
+   void print_table(FILE *fp) const;
+   [[noreturn]] void over_cap(uint64_t num_inst, uint64_t prev_inst, uint64_t rss, const std::vector<mem_usage_t>& prev);
+};
+
+// Hook into the predictor side of the interface, implemented next to the other cbp.h
+// hooks in cond_branch_predictor_interface.cc.
+extern void register_cond_dir_predictor_memory(memstats_t& m);
+
+#endif
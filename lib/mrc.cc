@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <algorithm>
+#include "trace_reader.h"
+#include "cache.h"
+#include "hugepage.h"
+#include "mrc.h"
+#include "parameters.h"
+#include "profiler.h"
+#include "perfcount.h"
+
+static constexpr uint64_t NO_BLOCK = ~0lu;
+static constexpr uint64_t INITIAL_SLOTS = 1 << 16;
+
+static uint64_t log2_exact(uint64_t x)
+{
+   assert(x && !(x & (x - 1)));
+   return __builtin_ctzl(x);
+}
+
+static std::string size_name(uint64_t bytes)
+{
+   char s[32];
+   if (bytes >= (1lu << 30))
+      snprintf(s, sizeof(s), "%lu GB", bytes >> 30);
+   else if (bytes >= (1lu << 20))
+      snprintf(s, sizeof(s), "%lu MB", bytes >> 20);
+   else if (bytes >= (1lu << 10))
+      snprintf(s, sizeof(s), "%lu KB", bytes >> 10);
+   else
+      snprintf(s, sizeof(s), "%lu B", bytes);
+   return s;
+}
+
+// The block sample must not depend on the address bits a cache indexes with.
+static uint64_t mix(uint64_t x)
+{
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdlu;
+   x ^= x >> 33;
+   x *= 0xc4ceb9fe1a85ec53lu;
+   x ^= x >> 33;
+   return x;
+}
+
+stack_distance_t::stack_distance_t(const std::string& name, uint64_t blocksize, uint64_t log2_min_size, uint64_t log2_max_size, uint64_t log2_sampling)
+   : name(name)
+   , blocksize(blocksize)
+   , num_offset_bits(log2_exact(blocksize))
+   , log2_min_size(std::max(log2_min_size, num_offset_bits))
+   , log2_max_size(std::max(log2_max_size, std::max(log2_min_size, num_offset_bits)))
+   , log2_sampling(log2_sampling)
+   , counting(true)
+   , references(0)
+   , last_block(NO_BLOCK)
+   , fenwick(INITIAL_SLOTS + 1, 0)
+   , next_slot(0)
+   , full_cold(0)
+{
+   memset(full_hist, 0, sizeof(full_hist));
+
+   // Every number of sets that some size in the range has at some associativity up to
+   // MAX_ASSOC, each kept as deep as the largest such associativity. Sizes above
+   // MAX_SET_ASSOC_BLOCKS_BITS blocks are fully associative only.
+   const uint64_t min_blocks_bits = this->log2_min_size - num_offset_bits;
+   const uint64_t max_blocks_bits = std::min(this->log2_max_size - num_offset_bits, MAX_SET_ASSOC_BLOCKS_BITS);
+   const uint64_t max_assoc_bits = log2_exact(MAX_ASSOC);
+   for (uint64_t s = ((min_blocks_bits > max_assoc_bits) ? (min_blocks_bits - max_assoc_bits) : 0); s <= max_blocks_bits; s++) {
+      sets_t g;
+      g.num_sets_bits = s;
+      g.depth = std::min(MAX_ASSOC, 1lu << (max_blocks_bits - s));
+      g.stacks = (uint64_t *)table_alloc((g.depth << s) * sizeof(uint64_t));
+      std::fill(g.stacks, g.stacks + (g.depth << s), NO_BLOCK);
+      g.accesses = 0;
+      g.hist.assign(g.depth + 1, 0);
+      sets.push_back(g);
+   }
+}
+
+stack_distance_t::~stack_distance_t()
+{
+   for (sets_t& g : sets)
+      table_free(g.stacks);
+}
+
+bool stack_distance_t::sampled_block(uint64_t block) const
+{
+   return (log2_sampling == 0) || ((mix(block) >> (64 - log2_sampling)) == 0);
+}
+
+void stack_distance_t::fenwick_add(uint64_t slot, int delta)
+{
+   for (uint64_t i = slot + 1; i < fenwick.size(); i += (i & -i))
+      fenwick[i] += delta;
+}
+
+// Live slots in [0, slot].
+uint64_t stack_distance_t::fenwick_prefix(uint64_t slot) const
+{
+   uint64_t sum = 0;
+   for (uint64_t i = slot + 1; i > 0; i -= (i & -i))
+      sum += fenwick[i];
+   return sum;
+}
+
+// Renumbers the live slots 0 .. n-1 in the same order, with room for at least as many
+// new ones.
+void stack_distance_t::compact()
+{
+   std::vector<std::pair<uint64_t, uint64_t *>> live;
+   live.reserve(last_slot.size());
+   for (auto& e : last_slot)
+      live.push_back({e.second, &e.second});
+   std::sort(live.begin(), live.end());
+
+   uint64_t num_slots = fenwick.size() - 1;
+   while (num_slots < 2 * live.size())
+      num_slots *= 2;
+   fenwick.assign(num_slots + 1, 0);
+   for (uint64_t i = 0; i < live.size(); i++) {
+      *live[i].second = i;
+      fenwick[i + 1] = 1;
+   }
+   // Linear-time build: each node passes its sum up to its parent.
+   for (uint64_t i = 1; i <= num_slots; i++) {
+      const uint64_t parent = i + (i & -i);
+      if (parent <= num_slots)
+         fenwick[parent] += fenwick[i];
+   }
+   next_slot = live.size();
+}
+
+void stack_distance_t::full_access(uint64_t block)
+{
+   if (next_slot == fenwick.size() - 1)
+      compact();
+
+   auto it = last_slot.find(block);
+   if (it == last_slot.end()) {
+      if (counting)
+         full_cold++;
+      last_slot.emplace(block, next_slot);
+   }
+   else {
+      // Blocks referenced since: the live slots after this block's.
+      const uint64_t distance = (last_slot.size() - fenwick_prefix(it->second)) << log2_sampling;
+      if (counting)
+         full_hist[distance ? (64 - __builtin_clzl(distance)) : 0]++;
+      fenwick_add(it->second, -1);
+      it->second = next_slot;
+   }
+   fenwick_add(next_slot, 1);
+   next_slot++;
+}
+
+void stack_distance_t::access(uint64_t addr)
+{
+   const uint64_t block = addr >> num_offset_bits;
+   if (counting)
+      references++;
+
+   // Distance 0 in every geometry; the stacks are unchanged.
+   if (block == last_block) {
+      if (!counting)
+         return;
+      if (sampled_block(block))
+         full_hist[0]++;
+      for (sets_t& g : sets) {
+         g.accesses++;
+         g.hist[0]++;
+      }
+      return;
+   }
+   last_block = block;
+
+   if (sampled_block(block))
+      full_access(block);
+
+   for (sets_t& g : sets) {
+      const uint64_t index = block & ((1lu << g.num_sets_bits) - 1);
+
+      uint64_t *stack = &g.stacks[index * g.depth];
+      uint64_t p = 0;
+      while ((p < g.depth) && (stack[p] != block))
+         p++;
+      memmove(&stack[1], &stack[0], std::min(p, g.depth - 1) * sizeof(uint64_t));
+      stack[0] = block;
+      if (counting) {
+         g.accesses++;
+         g.hist[p]++;
+      }
+   }
+}
+
+const stack_distance_t::sets_t *stack_distance_t::find_sets(uint64_t size, uint64_t assoc) const
+{
+   const uint64_t blocks_bits = log2_exact(size) - num_offset_bits;
+   const uint64_t assoc_bits = log2_exact(assoc);
+   if (sets.empty() || (assoc_bits > blocks_bits))
+      return NULL;
+   const uint64_t s = blocks_bits - assoc_bits;
+   if ((s < sets.front().num_sets_bits) || (s > sets.back().num_sets_bits))
+      return NULL;
+   const sets_t *g = &sets[s - sets.front().num_sets_bits];
+   return (assoc <= g->depth) ? g : NULL;
+}
+
+double stack_distance_t::miss_ratio(uint64_t size, uint64_t assoc) const
+{
+   if ((size & (size - 1)) || (size < (1lu << log2_min_size)) || (size > (1lu << log2_max_size)))
+      return -1.0;
+
+   if (assoc == 0) {
+      // Hits: distance < size / blocksize, i.e. a bit width of at most log2 of it. The
+      // sampled misses are scaled over all references, not the sampled ones (SHARDS-adj):
+      // the number of references sampled swings with the few hottest blocks, the
+      // misses much less.
+      uint64_t misses = full_cold;
+      for (uint64_t w = log2_exact(size) - num_offset_bits + 1; w < 65; w++)
+         misses += full_hist[w];
+      return references ? std::min(1.0, (double)(misses << log2_sampling) / references) : 0.0;
+   }
+
+   if ((assoc & (assoc - 1)) || (assoc > MAX_ASSOC))
+      return -1.0;
+   const sets_t *g = find_sets(size, assoc);
+   if (!g)
+      return -1.0;
+   uint64_t hits = 0;
+   for (uint64_t p = 0; p < assoc; p++)
+      hits += g->hist[p];
+   return g->accesses ? ((double)(g->accesses - hits) / g->accesses) : 0.0;
+}
+
+void stack_distance_t::print(uint64_t config_size, uint64_t config_assoc) const
+{
+   printf("\treferences = %lu\n", references);
+   if (log2_max_size - num_offset_bits > MAX_SET_ASSOC_BLOCKS_BITS)
+      printf("\t(set-associative curves up to %s, fully associative only above)\n",
+             size_name(blocksize << MAX_SET_ASSOC_BLOCKS_BITS).c_str());
+   printf("\t  %-8s", "size");
+   for (uint64_t a = 1; a <= MAX_ASSOC; a *= 2)
+      printf("  %5lu-way", a);
+   printf("  %9s\n", "full");
+   for (uint64_t b = log2_min_size; b <= log2_max_size; b++) {
+      const uint64_t size = 1lu << b;
+      printf("\t%c %-8s", ((size == config_size) ? '*' : ' '), size_name(size).c_str());
+      for (uint64_t a = 1; a <= MAX_ASSOC; a *= 2) {
+         const double r = miss_ratio(size, a);
+         if (r < 0.0)
+            printf("  %9s", "-");
+         else
+            printf("  %8.2f%c", 100.0 * r, ((size == config_size) && (a == config_assoc)) ? '*' : '%');
+      }
+      printf("  %8.2f%%\n", 100.0 * miss_ratio(size, 0));
+   }
+}
+
+void stack_distance_t::write_csv(FILE *fp, uint64_t num_inst) const
+{
+   for (uint64_t b = log2_min_size; b <= log2_max_size; b++) {
+      const uint64_t size = 1lu << b;
+      for (uint64_t a = 0; a <= MAX_ASSOC; a = (a ? (2 * a) : 1)) {
+         const double r = miss_ratio(size, a);
+         if (r < 0.0)
+            continue;
+         const uint64_t misses = (uint64_t)(r * references + 0.5);
+         fprintf(fp, "%s,%lu,%lu,%lu,%lu,%lu,%lu,%.6f,%.4f\n", name.c_str(), blocksize, size, a,
+                 (a ? (size / blocksize / a) : 1lu), references, misses, r, (num_inst ? (1000.0 * misses / num_inst) : 0.0));
+      }
+   }
+}
+
+// The profiled sizes of a level: -K's range, or by default 1 KB up to 4x the configured size.
+static void mrc_range(uint64_t config_size, uint64_t& log2_min, uint64_t& log2_max)
+{
+   log2_min = MRC_LOG2_MAX_SIZE ? MRC_LOG2_MIN_SIZE : 10;
+   log2_max = MRC_LOG2_MAX_SIZE ? MRC_LOG2_MAX_SIZE : (63 - __builtin_clzl(config_size) + 2);
+}
+
+static stack_distance_t *new_stack_distance(const char *name, uint64_t config_size, uint64_t blocksize)
+{
+   uint64_t log2_min, log2_max;
+   mrc_range(config_size, log2_min, log2_max);
+   return new stack_distance_t(name, blocksize, log2_min, log2_max, MRC_LOG2_SAMPLING);
+}
+
+mrcsim_t::mrcsim_t()
+   : IC(FETCH_MODEL_ICACHE ? new_cache(IC_REPL, IC_SIZE, IC_ASSOC, IC_BLOCKSIZE, 0, NULL) : NULL)
+   , L1(new_cache(L1_REPL, L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, L1_LATENCY, NULL))
+   , L2(new_cache(L2_REPL, L2_SIZE, L2_ASSOC, L2_BLOCKSIZE, L2_LATENCY, NULL))
+   , ic_sd(FETCH_MODEL_ICACHE ? new_stack_distance("IC", IC_SIZE, IC_BLOCKSIZE) : NULL)
+   , l1_sd(new_stack_distance("L1", L1_SIZE, L1_BLOCKSIZE))
+   , l2_sd(new_stack_distance("L2", L2_SIZE, L2_BLOCKSIZE))
+   , l3_sd(new_stack_distance("L3", L3_SIZE, L3_BLOCKSIZE))
+   , num_inst(0)
+   , counting(WARMUP_INSTS == 0)
+{
+   for (stack_distance_t *sd : {ic_sd, l1_sd, l2_sd, l3_sd})
+      if (sd)
+         sd->set_counting(counting);
+}
+
+mrcsim_t::~mrcsim_t()
+{
+   for (stack_distance_t *sd : {ic_sd, l1_sd, l2_sd, l3_sd})
+      delete sd;
+   delete IC;
+   delete L1;
+   delete L2;
+}
+
+// The levels are not chained, so that each one's misses can be seen; the hit/miss
+// outcome does not depend on the cycle.
+void mrcsim_t::l2_access(uint64_t addr)
+{
+   l2_sd->access(addr);
+   if (L2->lookup(0, true, addr).level)
+      l3_sd->access(addr);
+}
+
+void mrcsim_t::step(db_t *inst)
+{
+   PROFILE_SCOPE(Step);
+   PERF_PHASE(Step);
+   if (IC) {
+      ic_sd->access(inst->pc);
+      if (IC->lookup(0, true, inst->pc).level)
+         l2_access(inst->pc);
+   }
+
+   if (inst->is_load || (inst->is_store && WRITE_ALLOCATE)) {
+      l1_sd->access(inst->addr);
+      if (L1->lookup(0, true, inst->addr).level)
+         l2_access(inst->addr);
+   }
+
+   if (inst->is_last_piece && counting)
+      num_inst++;
+}
+
+void mrcsim_t::end_warmup()
+{
+   counting = true;
+   for (stack_distance_t *sd : {ic_sd, l1_sd, l2_sd, l3_sd})
+      if (sd)
+         sd->set_counting(true);
+}
+
+void mrcsim_t::output(const std::string& prefix)
+{
+   PROFILE_SCOPE(Output);
+   PERF_PHASE(Output);
+   printf("MISS RATIO CURVES (LRU stack distance, no timing model)--------------\n");
+   printf("instructions = %lu\n", num_inst);
+   printf("MRC_SAMPLING = 1/%lu\n", 1lu << MRC_LOG2_SAMPLING);
+   printf("WARMUP_INSTS = %lu\n", WARMUP_INSTS);
+   printf("(miss ratio of an LRU cache of each size and associativity; *: configured size and associativity)\n");
+
+   struct level_t {
+      const char *title;
+      const stack_distance_t *sd;
+      uint64_t size, assoc, blocksize;
+   };
+   const level_t levels[] = {
+      {"I$ (every fetch)", ic_sd, IC_SIZE, IC_ASSOC, IC_BLOCKSIZE},
+      {"L1$ (loads and write-allocate stores)", l1_sd, L1_SIZE, L1_ASSOC, L1_BLOCKSIZE},
+      {"L2$ (misses of the configured I$ and L1$)", l2_sd, L2_SIZE, L2_ASSOC, L2_BLOCKSIZE},
+      {"L3$ (misses of the configured L2$)", l3_sd, L3_SIZE, L3_ASSOC, L3_BLOCKSIZE},
+   };
+
+   const std::string path = prefix + "_mrc.csv";
+   FILE *csv = fopen(path.c_str(), "w");
+   if (!csv) {
+      fprintf(stderr, "Miss ratio curves: cannot open %s for writing.\n", path.c_str());
+      exit(EXIT_FAILURE);
+   }
+   fprintf(csv, "level,blocksize,size,assoc,sets,references,misses,miss_ratio,mpki\n");
+   for (const level_t& l : levels) {
+      if (!l.sd)
+         continue;
+      printf("%s, %lu-byte blocks:\n", l.title, l.blocksize);
+      l.sd->print(l.size, l.assoc);
+      l.sd->write_csv(csv, num_inst);
+   }
+   fclose(csv);
+   printf("Miss ratio curves (assoc 0: fully associative): %s\n", path.c_str());
+}
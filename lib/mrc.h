@@ -0,0 +1,122 @@
+#ifndef _MRC_H_
+#define _MRC_H_
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class cache_base_t;
+struct db_t;
+
+// Miss-ratio curves from one pass over the trace (-K), instead of one simulation per
+// cache geometry.
+//
+// Each cache level gets a stack_distance_t over the references that reach it. A
+// reference's LRU stack distance is the number of distinct blocks referenced since the
+// previous reference to its block; an LRU cache holding C blocks hits exactly the
+// references at distance < C, so one histogram of distances gives the misses of every
+// capacity:
+//  - fully associative: the distance over all blocks, counted with a Fenwick tree over
+//    the "last reference" slots of the blocks (Olken), O(log n) per reference;
+//  - set associative: for each power-of-two number of sets S, the LRU stack of each set,
+//    kept MAX_ASSOC deep; a reference found at position p hits in every S-set cache
+//    of more than p ways (Mattson's all-associativity simulation). The stacks take
+//    8 bytes per block of the largest profiled size, times up to 6, so they stop at
+//    MAX_SET_ASSOC_BLOCKS blocks (at most 48 MB per level); larger sizes only get the
+//    fully associative curve, whose memory follows the footprint, not the range.
+// With 2^-k sampling (SHARDS, Waldspurger et al., FAST 2015) the fully associative
+// distances are measured over the blocks whose hash falls in a 2^-k slice and scaled by
+// 2^k, for long traces with large footprints. The set-associative curves stay exact:
+// following a fraction of the sets is as cheap, but far off when a few sets take most of
+// the references, as strided streams make them do.
+//
+// The streams are those of the simulated hierarchy: the I$ sees every fetch, the L1 every
+// load and (write-allocate) store, L2 the misses of the I$ and L1 and L3 the misses of L2,
+// the levels above being simulated with their configured geometry and replacement policy.
+// So the curve of a level is what a -D/-I sweep of that level alone would measure, with
+// LRU replacement in the swept level and without the prefetcher.
+
+class stack_distance_t {
+public:
+   static constexpr uint64_t MAX_ASSOC = 16;   // deepest set-associative stack
+   static constexpr uint64_t MAX_SET_ASSOC_BLOCKS_BITS = 20;   // largest set-associative size, in blocks
+
+   stack_distance_t(const std::string& name, uint64_t blocksize, uint64_t log2_min_size, uint64_t log2_max_size, uint64_t log2_sampling);
+   ~stack_distance_t();
+
+   void access(uint64_t addr);
+   void set_counting(bool on) { counting = on; }
+
+   // (Estimated) miss ratio of an LRU cache of size bytes (assoc 0: fully associative),
+   // negative if the geometry is outside the profiled range.
+   double miss_ratio(uint64_t size, uint64_t assoc) const;
+   uint64_t get_references() const { return references; }
+
+   // Miss ratios per size (rows) and associativity (columns) on the result log, the
+   // configured size marked; one row per geometry in the csv file.
+   void print(uint64_t config_size, uint64_t config_assoc) const;
+   void write_csv(FILE *fp, uint64_t num_inst) const;
+
+private:
+   std::string name;
+   uint64_t blocksize;
+   uint64_t num_offset_bits;
+   uint64_t log2_min_size;
+   uint64_t log2_max_size;
+   uint64_t log2_sampling;
+   bool counting;
+   uint64_t references;            // all of them, sampled or not
+   uint64_t last_block;            // repeated references are distance 0 everywhere
+
+   // Fully associative: slot of each sampled block's last reference, one bit per live
+   // slot in a Fenwick tree; slots are renumbered when they run out.
+   std::unordered_map<uint64_t, uint64_t> last_slot;
+   std::vector<uint32_t> fenwick;
+   uint64_t next_slot;
+   uint64_t full_cold;
+   uint64_t full_hist[65];         // by bit width of the (scaled) distance
+
+   // Set associative, one per number of sets 2^s that some profiled geometry has.
+   struct sets_t {
+      uint64_t num_sets_bits;
+      uint64_t depth;              // ways kept per set
+      uint64_t *stacks;            // depth blocks per set, MRU first
+      uint64_t accesses;
+      std::vector<uint64_t> hist;  // by position; hist[depth]: deeper or cold
+   };
+   std::vector<sets_t> sets;
+
+   bool sampled_block(uint64_t block) const;
+   void full_access(uint64_t block);
+   void compact();
+   void fenwick_add(uint64_t slot, int delta);
+   uint64_t fenwick_prefix(uint64_t slot) const;
+   const sets_t *find_sets(uint64_t size, uint64_t assoc) const;
+};
+
+// The -K run: the reference streams of the trace, fed to one stack_distance_t per level.
+class mrcsim_t {
+private:
+   cache_base_t *IC;               // the configured levels, for the streams below them
+   cache_base_t *L1;
+   cache_base_t *L2;
+   stack_distance_t *ic_sd;        // NULL without the I$ model
+   stack_distance_t *l1_sd;
+   stack_distance_t *l2_sd;
+   stack_distance_t *l3_sd;
+   uint64_t num_inst;
+   bool counting;
+
+   void l2_access(uint64_t addr);
+
+public:
+   mrcsim_t();
+   ~mrcsim_t();
+   void step(db_t *inst);
+   void end_warmup();
+   void output(const std::string& prefix);
+};
+
+#endif
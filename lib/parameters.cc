@@ -22,7 +22,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Author: Eric Rotenberg (ericro@ncsu.edu)
 
 
+#include <stddef.h>
 #include <inttypes.h>
+#include "pipetrace.h"
+#include "hugepage.h"
+#include "replacement.h"
 
 bool VP_ENABLE = false;
 bool VP_PERFECT = false;
@@ -82,3 +86,51 @@ bool PRINT_PER_EPOCH_STATS = false;
 bool LOAD_DEPENDENT_BRANCHES = false;
 int U_incrment = 0 ;
 
+uint64_t WARMUP_INSTS = 0;              // 0: no functional warm-up
+
+uint64_t CKPT_SAVE_INSTS = 0;           // 0: no checkpoint is taken
+const char *CKPT_SAVE_FILE = NULL;
+const char *CKPT_RESTORE_FILE = NULL;
+
+bool HOST_PERF_COUNTERS = false;        // -H: host hardware counters per simulation phase
+
+bool STATS_JSON = false;                // -S json: <trace>_stats.json next to the result log
+bool STATS_CSV = false;                 // -S csv: <trace>_stats.csv (and _epoch_stats.csv with -E)
+
+bool PRED_ONLY = false;                 // predictor-only fast mode (no timing model)
+uint64_t PRED_ONLY_DECODE_DELAY = 2;    // cycles from predict to notify_instr_decode
+uint64_t PRED_ONLY_RESOLVE_DELAY = 11;  // cycles from predict to resolve/commit (PIPELINE_FILL_LATENCY+1)
+
+bool STEP_SPECIALIZE = true;            // -g clears it: always use the runtime-configured step()
+
+uint64_t HEARTBEAT_INSTS = 0;           // -B: progress line every this many instructions (0: off)
+const char *HEARTBEAT_FILE = NULL;      // NULL: stderr
+
+pipetrace_trigger_t PIPETRACE_TRIGGER = pipetrace_trigger_t::Off;   // -T: pipeline timeline trigger
+uint64_t PIPETRACE_FIRST = 0;           // cycles/insts: first fetch cycle or instruction
+uint64_t PIPETRACE_LAST = 0;            // cycles/insts: last fetch cycle or instruction
+uint64_t PIPETRACE_PC = 0;              // misp: branch PC
+uint64_t PIPETRACE_MISP_K = 0;          // misp: which misprediction of that PC (1-based)
+uint64_t PIPETRACE_CYCLES = 0;          // misp: cycles of history before it
+uint64_t PIPETRACE_RING_SIZE = 65536;   // micro-op records kept (~100 bytes each)
+
+bool MEMSTATS_ENABLE = false;           // -m: per-structure memory report, sampled every EPOCH_SIZE_INSTS
+uint64_t MEMSTATS_MAX_MB = 0;           // -m: stop the run when the RSS exceeds this (0: no cap)
+
+hugepage_mode_t HUGEPAGE_MODE = hugepage_mode_t::Off;   // -G: back the cache and predictor tables with 2 MB pages
+
+repl_policy_t IC_REPL = repl_policy_t::LRU;   // -r: replacement policy of each cache level
+repl_policy_t L1_REPL = repl_policy_t::LRU;
+repl_policy_t L2_REPL = repl_policy_t::LRU;
+repl_policy_t L3_REPL = repl_policy_t::LRU;
+
+bool MRC_ENABLE = false;                // -K: miss-ratio curves of every cache level, no timing model
+uint64_t MRC_LOG2_SAMPLING = 0;         // -K: follow 2^-this of the blocks/sets (0: exact)
+uint64_t MRC_LOG2_MIN_SIZE = 0;         // -K: profiled sizes (max 0: 1 KB to 4x each level's size)
+uint64_t MRC_LOG2_MAX_SIZE = 0;
+
+uint64_t L2_SAMPLE_BITS = 0;            // -X: simulate 2^-this of the L2 sets, infer the rest (0: all)
+uint64_t L3_SAMPLE_BITS = 0;            // -X: same for L3
+bool CACHE_SAMPLE_VALIDATE = false;     // -X: simulate every set, report what sampling would have estimated
+
+uint64_t LOAD_PROFILE_SIZE = 0;         // -L: top load PCs by L1 misses kept in the load profile (0: off)
@@ -89,4 +89,56 @@ extern bool PRINT_PER_EPOCH_STATS;
 
 extern bool LOAD_DEPENDENT_BRANCHES;
 extern int U_incrment;
+
+extern uint64_t WARMUP_INSTS;
+
+extern uint64_t CKPT_SAVE_INSTS;
+extern const char *CKPT_SAVE_FILE;
+extern const char *CKPT_RESTORE_FILE;
+
+extern bool HOST_PERF_COUNTERS;
+
+extern bool STATS_JSON;
+extern bool STATS_CSV;
+
+extern bool PRED_ONLY;
+extern uint64_t PRED_ONLY_DECODE_DELAY;
+extern uint64_t PRED_ONLY_RESOLVE_DELAY;
+
+extern bool STEP_SPECIALIZE;
+
+extern uint64_t HEARTBEAT_INSTS;
+extern const char *HEARTBEAT_FILE;
+
+enum class pipetrace_trigger_t : uint8_t;   // pipetrace.h
+extern pipetrace_trigger_t PIPETRACE_TRIGGER;
+extern uint64_t PIPETRACE_FIRST;
+extern uint64_t PIPETRACE_LAST;
+extern uint64_t PIPETRACE_PC;
+extern uint64_t PIPETRACE_MISP_K;
+extern uint64_t PIPETRACE_CYCLES;
+extern uint64_t PIPETRACE_RING_SIZE;
+
+extern bool MEMSTATS_ENABLE;
+extern uint64_t MEMSTATS_MAX_MB;
+
+enum class hugepage_mode_t : uint8_t;       // hugepage.h
+extern hugepage_mode_t HUGEPAGE_MODE;
+
+enum class repl_policy_t : uint8_t;         // replacement.h
+extern repl_policy_t IC_REPL;
+extern repl_policy_t L1_REPL;
+extern repl_policy_t L2_REPL;
+extern repl_policy_t L3_REPL;
+
+extern bool MRC_ENABLE;
+extern uint64_t MRC_LOG2_SAMPLING;
+extern uint64_t MRC_LOG2_MIN_SIZE;
+extern uint64_t MRC_LOG2_MAX_SIZE;
+
+extern uint64_t L2_SAMPLE_BITS;
+extern uint64_t L3_SAMPLE_BITS;
+extern bool CACHE_SAMPLE_VALIDATE;
+
+extern uint64_t LOAD_PROFILE_SIZE;
 #endif
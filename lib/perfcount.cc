@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "perfcount.h"
+
+bool perf_enabled = false;
+perf_phase_t perf_current_phase = perf_phase_t::Other;
+
+#define NUM_PHASES ((int)perf_phase_t::NumPhases)
+
+static const char *phase_names[] = {
+   "other",
+   "trace decode",
+   "step",
+   "predictor hooks",
+   "output",
+};
+static_assert(sizeof(phase_names) / sizeof(phase_names[0]) == NUM_PHASES, "one name per phase");
+
+struct perf_counter_t {
+   const char *name;
+   int fd;
+   struct perf_event_mmap_page *page;    // NULL: read() only
+   uint64_t last;
+   uint64_t totals[NUM_PHASES];
+};
+
+static std::vector<perf_counter_t> counters;
+static bool any_read_syscall = false;
+
+static int open_event(uint32_t type, uint64_t config)
+{
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = type;
+   attr.config = config;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+   return (int)syscall(__NR_perf_event_open, &attr, 0 /*this process*/, -1 /*any cpu*/, -1 /*no group*/, 0);
+}
+
+static bool add_counter(const char *name, uint32_t type, uint64_t config, std::string& skipped)
+{
+   const int fd = open_event(type, config);
+   if (fd < 0) {
+      skipped += std::string(skipped.empty() ? "" : ", ") + name + " (" + strerror(errno) + ")";
+      return false;
+   }
+
+   perf_counter_t c;
+   memset(&c, 0, sizeof(c));
+   c.name = name;
+   c.fd = fd;
+   void *page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+   c.page = (page == MAP_FAILED) ? NULL : (struct perf_event_mmap_page *)page;
+   if (!c.page || !c.page->cap_user_rdpmc)
+      any_read_syscall = true;
+   counters.push_back(c);
+   return true;
+}
+
+// Self-monitoring read through the mmap'ed control page (see perf_event_open(2)); falls back
+// to read() when rdpmc is not permitted or the event is not currently on a hardware counter.
+static uint64_t read_counter(perf_counter_t& c)
+{
+#if defined(__x86_64__) || defined(__i386__)
+   if (c.page && c.page->cap_user_rdpmc) {
+      struct perf_event_mmap_page *pc = c.page;
+      uint32_t seq;
+      uint32_t idx;
+      uint64_t count;
+      do {
+         seq = pc->lock;
+         asm volatile("" ::: "memory");
+         idx = pc->index;
+         count = pc->offset;
+         if (idx) {
+            const uint32_t width = pc->pmc_width;
+            int64_t pmc = (int64_t)__rdpmc(idx - 1);
+            pmc <<= (64 - width);
+            pmc >>= (64 - width);
+            count += pmc;
+         }
+         asm volatile("" ::: "memory");
+      } while (pc->lock != seq);
+      if (idx)
+         return count;
+   }
+#endif
+   uint64_t v[3];
+   if (read(c.fd, v, sizeof(v)) != (ssize_t)sizeof(v))
+      return c.last;
+   return v[0];
+}
+
+void perf_start()
+{
+   std::string skipped;
+   add_counter("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, skipped);
+   add_counter("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, skipped);
+   add_counter("LLC-misses", PERF_TYPE_HW_CACHE,
+               PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), skipped);
+   add_counter("dTLB-misses", PERF_TYPE_HW_CACHE,
+               PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), skipped);
+   add_counter("branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, skipped);
+
+   if (counters.empty()) {
+      if (add_counter("task-clock(ns)", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, skipped)) {
+         fprintf(stderr, "Host counters (-H): no hardware events (%s); reporting task-clock per phase instead.\n", skipped.c_str());
+      }
+      else {
+         fprintf(stderr, "Host counters (-H): unavailable, continuing without them: %s.\n", skipped.c_str());
+         return;
+      }
+   }
+   else if (!skipped.empty()) {
+      fprintf(stderr, "Host counters (-H): not available: %s.\n", skipped.c_str());
+   }
+   if (any_read_syscall)
+      fprintf(stderr, "Host counters (-H): rdpmc not permitted for some events, reading them with read() (slower).\n");
+
+   for (perf_counter_t& c : counters)
+      c.last = read_counter(c);
+   perf_current_phase = perf_phase_t::Other;
+   perf_enabled = true;
+}
+
+void perf_switch(perf_phase_t next)
+{
+   for (perf_counter_t& c : counters) {
+      const uint64_t now = read_counter(c);
+      c.totals[(int)perf_current_phase] += now - c.last;
+      c.last = now;
+   }
+   perf_current_phase = next;
+}
+
+void perf_report(uint64_t num_inst)
+{
+   if (!perf_enabled)
+      return;
+   perf_switch(perf_current_phase);
+   perf_enabled = false;
+
+   int cycles = -1, instructions = -1;
+   for (size_t i = 0; i < counters.size(); i++) {
+      if (!strcmp(counters[i].name, "cycles")) cycles = (int)i;
+      if (!strcmp(counters[i].name, "instructions")) instructions = (int)i;
+   }
+
+   fprintf(stderr, "\nHOST COUNTERS (-H): simulator process, user space, per phase\n");
+   fprintf(stderr, "%-16s", "Phase");
+   for (const perf_counter_t& c : counters)
+      fprintf(stderr, " %16s", c.name);
+   if ((cycles >= 0) && (instructions >= 0))
+      fprintf(stderr, " %8s", "IPC");
+   fprintf(stderr, "\n");
+
+   for (int p = 0; p <= NUM_PHASES; p++) {
+      fprintf(stderr, "%-16s", (p < NUM_PHASES) ? phase_names[p] : "total");
+      std::vector<uint64_t> v;
+      for (const perf_counter_t& c : counters) {
+         uint64_t sum = 0;
+         for (int q = 0; q < NUM_PHASES; q++)
+            sum += c.totals[q];
+         v.push_back((p < NUM_PHASES) ? c.totals[p] : sum);
+         fprintf(stderr, " %16lu", v.back());
+      }
+      if ((cycles >= 0) && (instructions >= 0))
+         fprintf(stderr, " %8.3f", (v[cycles] > 0) ? ((double)v[instructions] / (double)v[cycles]) : 0.0);
+      fprintf(stderr, "\n");
+   }
+
+   if (num_inst > 0) {
+      fprintf(stderr, "Per 1000 simulated instructions:\n");
+      for (int p = 0; p < NUM_PHASES; p++) {
+         fprintf(stderr, "%-16s", phase_names[p]);
+         for (const perf_counter_t& c : counters)
+            fprintf(stderr, " %16.1f", 1000.0 * (double)c.totals[p] / (double)num_inst);
+         fprintf(stderr, "\n");
+      }
+   }
+
+   // Counts are not scaled; say so if the kernel had to multiplex the events.
+   for (const perf_counter_t& c : counters) {
+      uint64_t v[3];
+      if ((read(c.fd, v, sizeof(v)) == (ssize_t)sizeof(v)) && (v[2] < v[1]))
+         fprintf(stderr, "Note: %s was multiplexed (on the PMU %.1f%% of the time), its counts are partial.\n", c.name, 100.0 * (double)v[2] / (double)v[1]);
+   }
+}
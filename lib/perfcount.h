@@ -0,0 +1,57 @@
+#ifndef _PERFCOUNT_H_
+#define _PERFCOUNT_H_
+
+#include <inttypes.h>
+
+// Host hardware counters for the simulator process itself (-H), split by simulation phase.
+//
+// perf_start() opens cycles, instructions, LLC read misses, dTLB read misses and branch
+// misses with perf_event_open (user space only). Events the host or container does not
+// provide are skipped; if none of them can be opened, task-clock is used instead, and if
+// that fails too, -H only prints why. Counters are read with rdpmc when the kernel allows
+// it, so a phase switch costs a few dozen cycles; otherwise read() is used.
+//
+// PERF_PHASE(<phase>) at the top of a block charges everything until the block exits to
+// that phase and then returns to the enclosing one. When -H is off it is a single test of
+// perf_enabled.
+
+enum class perf_phase_t : uint8_t {
+   Other,            // setup, main loop glue
+   TraceDecode,      // TraceReader::get_inst (gzip + populateNewInstr)
+   Step,             // uarchsim_t::step / warmup / predsim_t::step, minus the hooks below
+   PredictorHooks,   // cbp.h hooks: predictor tables, pred_time_histories, histories_log
+   Output,           // end-of-run printing
+   NumPhases
+};
+
+extern bool perf_enabled;
+extern perf_phase_t perf_current_phase;
+
+void perf_start();
+void perf_switch(perf_phase_t next);
+void perf_report(uint64_t num_inst);
+
+class perf_phase_scope_t {
+private:
+   perf_phase_t prev;
+
+public:
+   explicit perf_phase_scope_t(perf_phase_t phase)
+      : prev(perf_current_phase)
+   {
+      if (perf_enabled && (phase != prev))
+         perf_switch(phase);
+   }
+
+   ~perf_phase_scope_t()
+   {
+      if (perf_enabled && (perf_current_phase != prev))
+         perf_switch(prev);
+   }
+};
+
+#define PERF_CONCAT2(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT2(a, b)
+#define PERF_PHASE(phase) perf_phase_scope_t PERF_CONCAT(perf_phase_, __LINE__)(perf_phase_t::phase)
+
+#endif
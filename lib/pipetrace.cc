@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include "pipetrace.h"
+#include "parameters.h"
+#include "log.h"
+
+extern log_files files;
+
+pipetrace_t::pipetrace_t(uint64_t rows)
+   : num_recorded(0)
+   , gate(UINT64_MAX)
+   , num_misp(0)
+   , rows(rows)
+   , by_inst(PIPETRACE_TRIGGER == pipetrace_trigger_t::Insts)
+{
+   if (PIPETRACE_TRIGGER == pipetrace_trigger_t::Off)
+      return;
+   ring.resize(PIPETRACE_RING_SIZE);
+   gate = (PIPETRACE_TRIGGER == pipetrace_trigger_t::Mispredict) ? 0 : PIPETRACE_FIRST;
+}
+
+void pipetrace_t::push(const pipetrace_uop_t& u)
+{
+   ring[num_recorded % ring.size()] = u;
+   num_recorded++;
+}
+
+void pipetrace_t::record(const pipetrace_uop_t& u)
+{
+   switch (PIPETRACE_TRIGGER) {
+      case pipetrace_trigger_t::Cycles:
+      case pipetrace_trigger_t::Insts:
+         if ((by_inst ? u.inst : u.fetch_cycle) <= PIPETRACE_LAST)
+            push(u);
+         else
+            dump(0);
+         break;
+      case pipetrace_trigger_t::Mispredict:
+         push(u);
+         if (u.mispredict && (u.pc == PIPETRACE_PC) && (++num_misp == PIPETRACE_MISP_K))
+            dump((u.fetch_cycle > PIPETRACE_CYCLES) ? (u.fetch_cycle - PIPETRACE_CYCLES) : 0);
+         break;
+      default:
+         break;
+   }
+}
+
+void pipetrace_t::finish()
+{
+   if (gate == UINT64_MAX)
+      return;
+   if (PIPETRACE_TRIGGER == pipetrace_trigger_t::Mispredict)
+   {
+      fprintf(stderr, "Pipeline trace: PC 0x%lx was mispredicted only %lu times, nothing written.\n", PIPETRACE_PC, num_misp);
+      gate = UINT64_MAX;
+   }
+   else if (num_recorded)
+      dump(0);
+   else
+   {
+      fprintf(stderr, "Pipeline trace: the run ended before %s %lu, nothing written.\n",
+              (by_inst ? "instruction" : "fetch cycle"), PIPETRACE_FIRST);
+      gate = UINT64_MAX;
+   }
+}
+
+// Writes the micro-ops still in flight at or after since_cycle and disarms the trigger.
+void pipetrace_t::dump(uint64_t since_cycle)
+{
+   gate = UINT64_MAX;
+
+   const std::string path = files.prefix + "_pipetrace.json";
+   FILE *fp = fopen(path.c_str(), "w");
+   if (!fp)
+   {
+      fprintf(stderr, "Pipeline trace: cannot open %s.\n", path.c_str());
+      return;
+   }
+
+   const uint64_t n = std::min<uint64_t>(num_recorded, ring.size());
+   // A mispredict window is only truncated if the oldest record kept still overlaps it.
+   uint64_t dropped = num_recorded - n;
+   if (dropped && (ring[num_recorded % ring.size()].retire_cycle < since_cycle))
+      dropped = 0;
+   uint64_t written = 0;
+
+   fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"time_unit\":\"1 us = 1 cycle\",\"dropped_uops\":%lu},\n\"traceEvents\":[\n", dropped);
+   fprintf(fp, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"pipeline\"}},\n");
+   fprintf(fp, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":2,\"args\":{\"name\":\"frontend\"}}");
+
+   auto span = [fp](const char *name, uint64_t tid, uint64_t begin, uint64_t end) {
+      if (end > begin)
+         fprintf(fp, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%lu,\"ts\":%lu,\"dur\":%lu}", name, tid, begin, end - begin);
+   };
+
+   for (uint64_t i = num_recorded - n; i < num_recorded; i++)
+   {
+      const pipetrace_uop_t& u = ring[i % ring.size()];
+      if (u.retire_cycle < since_cycle)
+         continue;
+      written++;
+
+      const uint64_t tid = u.seq_no % rows;
+      const bool mem = is_mem(u.insn_class);
+      fprintf(fp, ",\n{\"ph\":\"X\",\"name\":\"fetch\",\"pid\":1,\"tid\":%lu,\"ts\":%lu,\"dur\":%lu,"
+                  "\"args\":{\"seq\":%lu,\"piece\":%u,\"inst\":%lu,\"pc\":\"0x%lx\",\"class\":\"%s\"}}",
+              tid, u.fetch_cycle, u.decode_cycle - u.fetch_cycle,
+              u.seq_no, (unsigned)u.piece, u.inst, u.pc, cInfo[static_cast<uint8_t>(u.insn_class)]);
+      span("dispatch", tid, u.decode_cycle, u.issue_cycle);
+      if (mem)
+         span("agen", tid, u.issue_cycle, u.issue_cycle + 1);
+      span(mem ? "memory" : "execute", tid, u.issue_cycle + (mem ? 1 : 0), u.exec_cycle);
+      span("retire wait", tid, u.exec_cycle, u.retire_cycle);
+      fprintf(fp, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"retire\",\"pid\":1,\"tid\":%lu,\"ts\":%lu}", tid, u.retire_cycle);
+
+      if (u.mispredict)
+      {
+         fprintf(fp, ",\n{\"ph\":\"X\",\"name\":\"wrong path\",\"pid\":2,\"tid\":1,\"ts\":%lu,\"dur\":%lu,\"args\":{\"seq\":%lu,\"pc\":\"0x%lx\"}}",
+                 u.fetch_cycle, u.resume_cycle - u.fetch_cycle, u.seq_no, u.pc);
+         fprintf(fp, ",\n{\"ph\":\"i\",\"s\":\"p\",\"name\":\"mispredict\",\"pid\":2,\"tid\":1,\"ts\":%lu,\"args\":{\"pc\":\"0x%lx\"}}",
+                 u.exec_cycle, u.pc);
+      }
+   }
+   fprintf(fp, "\n]}\n");
+   fclose(fp);
+
+   fprintf(stderr, "Pipeline trace: %lu micro-ops written to %s", written, path.c_str());
+   if (dropped)
+      fprintf(stderr, " (%lu older ones dropped, ring holds %lu)", dropped, (uint64_t)ring.size());
+   fprintf(stderr, ".\n");
+
+   ring.clear();
+   ring.shrink_to_fit();
+}
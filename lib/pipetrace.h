@@ -0,0 +1,65 @@
+#ifndef _PIPETRACE_H_
+#define _PIPETRACE_H_
+
+#include <inttypes.h>
+#include <vector>
+#include "sim_common_structs.h"
+
+// Pipeline timeline in Chrome/Perfetto trace-event JSON (-T), <trace>_pipetrace.json.
+//
+// uarchsim_t::step() knows every stage cycle of a micro-op when it dispatches it, so one
+// record per micro-op is written into a fixed-size ring (PIPETRACE_RING_SIZE records) and
+// turned into events only when the trigger fires:
+//   cycles,<first>,<last>   micro-ops fetched in [first, last]
+//   insts,<first>,<last>    instructions first..last (1-based, all pieces)
+//   misp,<pc>,<k>,<n>       micro-ops in flight during the <n> cycles before the k-th
+//                           misprediction of the branch at <pc> (recorded continuously)
+// If a range holds more micro-ops than the ring, the oldest ones are dropped and the count
+// is reported. Outside the window step() pays one compare; after the dump, none.
+//
+// Each micro-op is a row (seq_no modulo the window size) with fetch, dispatch, agen,
+// execute and retire-wait spans and a retire marker; mispredictions add a wrong-path span
+// on a separate frontend track. Timestamps are cycles (1 us on the timeline = 1 cycle).
+
+enum class pipetrace_trigger_t : uint8_t { Off, Cycles, Insts, Mispredict };
+
+struct pipetrace_uop_t {
+   uint64_t seq_no;
+   uint64_t pc;
+   uint64_t inst;            // 1-based instruction number
+   uint64_t fetch_cycle;
+   uint64_t decode_cycle;
+   uint64_t issue_cycle;     // lane scheduled; AGEN for memory ops
+   uint64_t exec_cycle;      // result available
+   uint64_t retire_cycle;
+   uint64_t resume_cycle;    // fetch restart after a misprediction, 0 otherwise
+   uint8_t piece;
+   InstClass insn_class;
+   bool mispredict;
+};
+
+class pipetrace_t {
+private:
+   std::vector<pipetrace_uop_t> ring;
+   uint64_t num_recorded;      // total pushed; ring index is num_recorded % ring.size()
+   uint64_t gate;              // record() is called once the key reaches this
+   uint64_t num_misp;          // mispredictions of PIPETRACE_PC seen so far
+   uint64_t rows;
+   bool by_inst;               // the gate compares instruction numbers, not fetch cycles
+
+   void push(const pipetrace_uop_t& u);
+   void dump(uint64_t since_cycle);
+
+public:
+   pipetrace_t(uint64_t rows);
+
+   bool armed(uint64_t fetch_cycle, uint64_t inst) const
+   {
+      return (by_inst ? inst : fetch_cycle) >= gate;
+   }
+   void record(const pipetrace_uop_t& u);
+   // End of simulation: dumps a range that has not closed yet.
+   void finish();
+};
+
+#endif
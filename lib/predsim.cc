@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <assert.h>
+#include "trace_reader.h"
+#include "cache.h"
+#include "bp.h"
+#include "cbp.h"
+#include "resource_schedule.h"
+#include "uarchsim.h"
+#include "predsim.h"
+#include "parameters.h"
+#include "stats.h"
+#include "memstats.h"
+#include "profiler.h"
+#include "perfcount.h"
+#include "log.h"
+
+extern log_files files;
+
+predsim_t::predsim_t()
+   : num_decoded(0)
+   , BP()
+   , piece(UINT8_MAX)
+   , num_fetched(0)
+   , num_inst(0)
+   , num_uop(0)
+   , cycle(0)
+{
+   assert(PRED_ONLY_DECODE_DELAY <= PRED_ONLY_RESOLVE_DELAY);
+   BP.notify_begin_new_epoch();
+
+   stats.counter("instructions", &num_inst);
+   stats.counter("cycles", &cycle);
+   BP.register_stats(stats);
+   register_cond_dir_predictor_stats(stats);
+
+   memstats.track("predsim.inflight", [this]() { return mem_usage(inflight); });
+   BP.register_memory(memstats);
+   register_cond_dir_predictor_memory(memstats);
+}
+
+void predsim_t::drain(uint64_t current_cycle)
+{
+   while ((num_decoded < inflight.size()) && (inflight[num_decoded].decode_cycle <= current_cycle)) {
+      const inflight_t& e = inflight[num_decoded];
+      notify_instr_decode(e.seq_no, e.piece, e.pc, e.exec_info.dec_info, e.decode_cycle);
+      num_decoded++;
+   }
+
+   while ((num_decoded > 0) && (inflight.front().resolve_cycle <= current_cycle)) {
+      const inflight_t& e = inflight.front();
+      if (is_mem(e.exec_info.dec_info.insn_class))
+         notify_agen_complete(e.seq_no, e.piece, e.pc, e.exec_info.dec_info, e.exec_info.mem_va.value(), e.exec_info.mem_sz.value(), e.resolve_cycle);
+      notify_instr_execute_resolve(e.seq_no, e.piece, e.pc, e.pred_taken, e.exec_info, e.resolve_cycle);
+      notify_instr_commit(e.seq_no, e.piece, e.pc, e.pred_taken, e.exec_info, e.resolve_cycle);
+      inflight.pop_front();
+      num_decoded--;
+   }
+}
+
+void predsim_t::step(db_t *inst)
+{
+   PROFILE_SCOPE(Step);
+   PERF_PHASE(Step);
+   piece = (piece == UINT8_MAX) ? 0 : (piece + 1);
+   const uint64_t seq_no = num_uop;
+
+   // Older instructions whose decode/resolve time has come are processed before this one is predicted.
+   drain(cycle);
+
+   notify_instr_fetch(seq_no, piece, inst->pc, cycle);
+
+   inflight.emplace_back();
+   inflight_t& e = inflight.back();
+   e.seq_no = seq_no;
+   e.piece = piece;
+   e.pc = inst->pc;
+   e.decode_cycle = cycle + PRED_ONLY_DECODE_DELAY;
+   e.resolve_cycle = cycle + PRED_ONLY_RESOLVE_DELAY;
+   populate_exec_info(inst, e.exec_info);
+
+   bool misp = false;
+   if (!PERFECT_BRANCH_PRED)
+      misp = BP.predict(seq_no, piece, inst->insn_class, inst->pc, inst->next_pc, cycle, cycle, e.resolve_cycle);
+
+   if (is_cond_br(inst->insn_class))
+      e.pred_taken = misp ? !inst->is_taken : inst->is_taken;
+   else
+      e.pred_taken = is_br(inst->insn_class);
+
+   num_uop++;
+   if (inst->is_last_piece) {
+      piece = UINT8_MAX;
+      num_inst++;
+      if ((FETCH_WIDTH > 0) && (++num_fetched == FETCH_WIDTH)) {
+         num_fetched = 0;
+         cycle++;
+      }
+   }
+}
+
+void predsim_t::finish()
+{
+   drain(UINT64_MAX);
+   assert(inflight.empty());
+}
+
+sim_progress_t predsim_t::progress() const
+{
+   return sim_progress_t{num_inst, cycle, BP.num_cond_mispredicts()};
+}
+
+void predsim_t::output()
+{
+   PROFILE_SCOPE(Output);
+   PERF_PHASE(Output);
+   printf("PREDICTOR-ONLY MODE (no timing model)--------------\n");
+   printf("FETCH_WIDTH = %lu\n", FETCH_WIDTH);
+   printf("PRED_ONLY_DECODE_DELAY = %lu\n", PRED_ONLY_DECODE_DELAY);
+   printf("PRED_ONLY_RESOLVE_DELAY = %lu\n", PRED_ONLY_RESOLVE_DELAY);
+   printf("PERFECT_BRANCH_PRED = %s\n", (PERFECT_BRANCH_PRED ? "1" : "0"));
+   printf("PERFECT_INDIRECT_PRED = %s\n", (PERFECT_INDIRECT_PRED ? "1" : "0"));
+   printf("instructions = %lu\n", num_inst);
+   printf("cycles (synthetic) = %lu\n", cycle);
+   BP.output(num_inst);
+
+   if (STATS_JSON || STATS_CSV)
+      stats.dump(files.prefix);
+
+   memstats.report();
+}
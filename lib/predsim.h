@@ -0,0 +1,52 @@
+#ifndef _PREDSIM_H_
+#define _PREDSIM_H_
+
+#include <deque>
+
+// Predictor-only, in-order simulation (-O).
+//
+// Walks the trace without caches, lanes, the SQ or the window and calls the predictor
+// hooks in a fixed-delay order on a synthetic clock: an instruction fetched (and
+// predicted) at cycle c is decoded at c + PRED_ONLY_DECODE_DELAY and resolved/committed
+// at c + PRED_ONLY_RESOLVE_DELAY. The clock advances once per FETCH_WIDTH instructions,
+// so the delays set how many younger branches are predicted before an older one
+// updates the predictor. Mispredictions do not stall fetch.
+
+class predsim_t {
+private:
+   struct inflight_t {
+      uint64_t seq_no;
+      uint8_t piece;
+      uint64_t pc;
+      bool pred_taken;
+      uint64_t decode_cycle;
+      uint64_t resolve_cycle;
+      ExecuteInfo exec_info;
+   };
+
+   // Instructions in program order; the first num_decoded entries have been decoded.
+   std::deque<inflight_t> inflight;
+   uint64_t num_decoded;
+
+   bp_t BP;
+   stats_t stats;
+   memstats_t memstats;
+
+   uint8_t piece;             // of the current instruction, UINT8_MAX between instructions
+   uint64_t num_fetched;
+   uint64_t num_inst;
+   uint64_t num_uop;
+   uint64_t cycle;
+
+   void drain(uint64_t current_cycle);
+
+public:
+   predsim_t();
+   void step(db_t *inst);
+   void finish();
+   void output();
+   sim_progress_t progress() const;
+   memstats_t& memory() { return memstats; }
+};
+
+#endif
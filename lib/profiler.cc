@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <chrono>
+#include "profiler.h"
+
+#ifdef CBP_PROFILE
+
+prof_stats_t prof_stats[(int)prof_region_t::NumRegions];
+static uint64_t prof_root_child_ticks = 0;
+uint64_t *prof_child_ticks = &prof_root_child_ticks;
+
+static uint64_t start_ticks;
+static std::chrono::steady_clock::time_point start_time;
+
+static const char *region_names[] = {
+   "trace decode (gzip)",
+   "populateNewInstr",
+   "warmup bookkeeping",
+   "step bookkeeping",
+   "cache access/is_hit",
+   "stride prefetcher",
+   "cond. predict",
+   "spec_update",
+   "cond. update",
+   "ITTAGE",
+   "interface logging",
+   "output",
+};
+static_assert(sizeof(region_names) / sizeof(region_names[0]) == (size_t)prof_region_t::NumRegions, "one name per region");
+
+void profiler_start()
+{
+   start_time = std::chrono::steady_clock::now();
+   start_ticks = prof_now();
+}
+
+void profiler_report(uint64_t num_inst)
+{
+   const uint64_t total_ticks = prof_now() - start_ticks;
+   const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+   const double sec_per_tick = (total_ticks > 0) ? (wall / (double)total_ticks) : 0.0;
+
+   uint64_t attributed = 0;
+   for (int r = 0; r < (int)prof_region_t::NumRegions; r++)
+      attributed += prof_stats[r].self_ticks;
+
+   fprintf(stderr, "\nSELF-PROFILE: %.3f s wall, %lu instrs, %.1f KIPS\n", wall, num_inst, (wall > 0.0) ? ((double)num_inst / wall / 1000.0) : 0.0);
+   fprintf(stderr, "%-22s %12s %10s %7s %10s %12s %12s\n", "Region", "Calls", "Self(s)", "Self%", "Incl(s)", "ns/call", "ns/instr");
+   for (int r = 0; r < (int)prof_region_t::NumRegions; r++) {
+      const prof_stats_t& s = prof_stats[r];
+      if (s.calls == 0)
+         continue;
+      const double self = (double)s.self_ticks * sec_per_tick;
+      fprintf(stderr, "%-22s %12lu %10.3f %6.1f%% %10.3f %12.1f %12.1f\n",
+              region_names[r], s.calls, self, 100.0 * (double)s.self_ticks / (double)total_ticks,
+              (double)s.incl_ticks * sec_per_tick, 1e9 * self / (double)s.calls,
+              (num_inst > 0) ? (1e9 * self / (double)num_inst) : 0.0);
+   }
+   const uint64_t rest = (total_ticks > attributed) ? (total_ticks - attributed) : 0;
+   fprintf(stderr, "%-22s %12s %10.3f %6.1f%%\n", "unattributed", "", (double)rest * sec_per_tick, 100.0 * (double)rest / (double)total_ticks);
+}
+
+#endif
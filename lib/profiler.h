@@ -0,0 +1,96 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <inttypes.h>
+
+// Self-profiler: where does the simulator's own wall time go?
+//
+// Build with "make PROFILE=1" (defines CBP_PROFILE) and put PROFILE_SCOPE(<region>) at the
+// top of a block. Each scope reads the TSC on entry and exit; time spent in nested scopes is
+// charged to the inner region only, so the "self" column of the report adds up to the run's
+// wall time. Without the flag PROFILE_SCOPE expands to nothing.
+//
+// The breakdown is printed on stderr at exit (stdout goes to the result log).
+
+enum class prof_region_t : uint8_t {
+   TraceDecode,      // gzip stream reads (TraceReader::readInstr)
+   PopulateInstr,    // TraceReader::populateNewInstr
+   Warmup,           // uarchsim_t::warmup bookkeeping (-W)
+   Step,             // uarchsim_t::step / predsim_t::step bookkeeping
+   Cache,            // cache_t::access, cache_t::is_hit
+   Prefetcher,       // StridePrefetcher lookahead/train/issue
+   CondPredict,      // TAGE-SC-L + contestant predict
+   SpecUpdate,       // spec_update (history updates)
+   CondUpdate,       // TAGE-SC-L + contestant update at resolve
+   Indirect,         // ITTAGE
+   InterfaceLog,     // histories_log / dependency tracking in the interface layer
+   Output,           // end-of-run printing and endCondDirPredictor
+   NumRegions
+};
+
+#ifdef CBP_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t prof_now() { return __rdtsc(); }
+#else
+#include <chrono>
+static inline uint64_t prof_now() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+#endif
+
+struct prof_stats_t {
+   uint64_t calls;
+   uint64_t self_ticks;
+   uint64_t incl_ticks;    // outermost activations only, so recursion (L1 -> L2 -> L3) is not double counted
+   uint64_t depth;
+};
+
+extern prof_stats_t prof_stats[(int)prof_region_t::NumRegions];
+extern uint64_t *prof_child_ticks;    // child-time accumulator of the innermost open scope
+
+class prof_scope_t {
+private:
+   prof_stats_t& s;
+   uint64_t *parent_child_ticks;
+   uint64_t child_ticks;
+   uint64_t start;
+
+public:
+   explicit prof_scope_t(prof_region_t region)
+      : s(prof_stats[(int)region])
+      , parent_child_ticks(prof_child_ticks)
+      , child_ticks(0)
+   {
+      prof_child_ticks = &child_ticks;
+      s.depth++;
+      start = prof_now();
+   }
+
+   ~prof_scope_t()
+   {
+      const uint64_t elapsed = prof_now() - start;
+      s.calls++;
+      s.self_ticks += elapsed - child_ticks;
+      if (--s.depth == 0)
+         s.incl_ticks += elapsed;
+      *parent_child_ticks += elapsed;
+      prof_child_ticks = parent_child_ticks;
+   }
+};
+
+#define PROF_CONCAT2(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT2(a, b)
+#define PROFILE_SCOPE(region) prof_scope_t PROF_CONCAT(prof_scope_, __LINE__)(prof_region_t::region)
+
+void profiler_start();
+void profiler_report(uint64_t num_inst);
+
+#else
+
+#define PROFILE_SCOPE(region)
+static inline void profiler_start() {}
+static inline void profiler_report(uint64_t num_inst) {}
+
+#endif
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef _REPLACEMENT_H_
+#define _REPLACEMENT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <assert.h>
+#include "checkpoint.h"
+#include "hugepage.h"
+
+// Replacement policies for cache_t<> (cache.h). Each keeps its own per-set state and
+// is called by the cache on every access:
+//    init(num_sets, assoc)   once, before any access
+//    hit(index, way)         way of set index hit
+//    victim(index)           way to replace on a miss (the cache fills invalid ways first
+//                            when FILL_INVALID_FIRST)
+//    fill(index, way)        way now holds the missing block
+//    checkpoint_way(c, index, way) after each block's tag and timestamp, checkpoint(c)
+//                            after all blocks
+// REPEAT_HIT_IS_NOOP says that hit(index, way) right after a hit() or fill() of the same
+// way changes nothing, so the I$ line filter (cache_t<>::fetch()) can skip it.
+// The policy is a template parameter of cache_t, so none of these calls is virtual;
+// new_cache() in cache.cc picks the instantiation for a repl_policy_t at run time (-r).
+
+enum class repl_policy_t : uint8_t {
+   LRU,      // true LRU
+   PLRU,     // tree pseudo-LRU
+   SRRIP,    // static re-reference interval prediction, 2-bit, hit priority
+   BRRIP,    // bimodal RRIP: fills at distant re-reference, 1/32 of them at long
+   Random
+};
+
+const char *repl_policy_name(repl_policy_t p);
+bool parse_repl_policy(const char *name, repl_policy_t& p);
+
+// xorshift64, for the randomized policies: deterministic, so runs are reproducible,
+// and part of the checkpoint.
+struct repl_rng_t {
+   uint64_t state = 0x9e3779b97f4a7c15lu;
+
+   uint64_t next()
+   {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      return state;
+   }
+};
+
+// True LRU. With up to 16 ways, the recency order of a set packed in a uint64_t,
+// nibble k holding the way at position k (0: MRU, assoc - 1: LRU, unused nibbles 0xf);
+// with more ways, the position (rank) of each way. Way j starts at position j, so the
+// invalid ways are always the last ones and need no special case.
+class lru_repl_t {
+private:
+   static constexpr uint64_t MAX_PACKED_ASSOC = 16;
+   static constexpr uint64_t NIBBLE_ONES = 0x1111111111111111lu;
+   uint64_t assoc = 0;
+   uint64_t *order = NULL;   // assoc <= MAX_PACKED_ASSOC
+   uint16_t *rank = NULL;    // otherwise
+
+   // The position of way in a packed order, i.e. its first nibble.
+   // (x - 0x11..1) & ~x & 0x88..8 flags the zero nibbles of x; the lowest flag is exact.
+   static uint64_t position(uint64_t order, uint64_t way)
+   {
+      const uint64_t x = order ^ (way * NIBBLE_ONES);
+      return __builtin_ctzl((x - NIBBLE_ONES) & ~x & (NIBBLE_ONES << 3)) >> 2;
+   }
+
+   // Moves way to position 0; the ways ahead of it move back one position.
+   void touch(uint64_t index, uint64_t way)
+   {
+      if (order) {
+         const uint64_t o = order[index];
+         const uint64_t ahead = (1lu << (4 * position(o, way))) - 1;   // nibbles before way
+         const uint64_t upto = (ahead << 4) | 0xf;                    // ... and way's
+         order[index] = (o & ~upto) | ((o & ahead) << 4) | way;
+         return;
+      }
+
+      uint16_t *r = &rank[index * assoc];
+      for (uint64_t j = 0; j < assoc; j++)
+         r[j] += (r[j] < r[way]);
+      r[way] = 0;
+   }
+
+public:
+   static constexpr bool FILL_INVALID_FIRST = false;
+   static constexpr bool REPEAT_HIT_IS_NOOP = true;   // already the MRU way
+
+   ~lru_repl_t() { table_free(order ? (void *)order : (void *)rank); }
+
+   void init(uint64_t num_sets, uint64_t assoc)
+   {
+      this->assoc = assoc;
+      assert(assoc <= (1 << 16));
+      if (assoc <= MAX_PACKED_ASSOC) {
+         uint64_t initial = ~0lu;
+         for (uint64_t j = 0; j < assoc; j++)
+            initial = (initial & ~(0xflu << (4 * j))) | (j << (4 * j));
+         order = (uint64_t *)table_alloc(num_sets * sizeof(uint64_t));
+         for (uint64_t i = 0; i < num_sets; i++)
+            order[i] = initial;
+      }
+      else {
+         rank = (uint16_t *)table_alloc(num_sets * assoc * sizeof(uint16_t));
+         for (uint64_t i = 0; i < num_sets * assoc; i++)
+            rank[i] = i % assoc;
+      }
+   }
+
+   void hit(uint64_t index, uint64_t way) { touch(index, way); }
+   void fill(uint64_t index, uint64_t way) { touch(index, way); }
+
+   // The way at position assoc - 1.
+   uint64_t victim(uint64_t index) const
+   {
+      if (order)
+         return (order[index] >> (4 * (assoc - 1))) & 0xf;
+
+      uint64_t way;
+      for (way = 0; rank[index * assoc + way] != (assoc - 1); way++)
+         assert(way < assoc);
+      return way;
+   }
+
+   // The LRU position of each block.
+   void checkpoint_way(ckpt_t& c, uint64_t index, uint64_t way)
+   {
+      uint64_t r = order ? position(order[index], way) : rank[index * assoc + way];
+      c.io(r);
+      if (c.restoring()) {
+         assert(r < assoc);
+         if (!order)
+            rank[index * assoc + way] = r;
+         else
+            order[index] = ((way ? order[index] : ~0lu) & ~(0xflu << (4 * r))) | (way << (4 * r));
+      }
+   }
+
+   void checkpoint(ckpt_t& c) {}
+};
+
+// Tree pseudo-LRU: assoc - 1 bits per set, node n (root 1, children 2n and 2n + 1)
+// pointing to the half holding the next victim. A hit or fill points the nodes on the
+// path to the way away from it. Power-of-two associativity up to 64.
+class plru_repl_t {
+private:
+   uint64_t num_sets = 0;
+   uint64_t levels = 0;
+   uint64_t *tree = NULL;
+
+   void touch(uint64_t index, uint64_t way)
+   {
+      uint64_t t = tree[index];
+      uint64_t node = 1;
+      for (uint64_t l = levels; l-- > 0;) {
+         const uint64_t dir = (way >> l) & 1;
+         t = (t & ~(1lu << node)) | ((dir ^ 1) << node);
+         node = 2 * node + dir;
+      }
+      tree[index] = t;
+   }
+
+public:
+   static constexpr bool FILL_INVALID_FIRST = true;
+   static constexpr bool REPEAT_HIT_IS_NOOP = true;   // hit and fill point the same path away
+
+   ~plru_repl_t() { table_free(tree); }
+
+   void init(uint64_t num_sets, uint64_t assoc)
+   {
+      if ((assoc & (assoc - 1)) || (assoc > 64)) {
+         fprintf(stderr, "Tree-PLRU replacement needs a power-of-two associativity up to 64, not %lu.\n", assoc);
+         exit(EXIT_FAILURE);
+      }
+      this->num_sets = num_sets;
+      levels = __builtin_ctzl(assoc);
+      tree = (uint64_t *)table_alloc(num_sets * sizeof(uint64_t));
+      for (uint64_t i = 0; i < num_sets; i++)
+         tree[i] = 0;
+   }
+
+   void hit(uint64_t index, uint64_t way) { touch(index, way); }
+   void fill(uint64_t index, uint64_t way) { touch(index, way); }
+
+   uint64_t victim(uint64_t index) const
+   {
+      const uint64_t t = tree[index];
+      uint64_t node = 1;
+      for (uint64_t l = 0; l < levels; l++)
+         node = 2 * node + ((t >> node) & 1);
+      return node - (1lu << levels);
+   }
+
+   void checkpoint_way(ckpt_t& c, uint64_t index, uint64_t way) {}
+   void checkpoint(ckpt_t& c) { c.io_array(tree, num_sets); }
+};
+
+// RRIP (Jaleel et al., ISCA 2010) with 2-bit re-reference prediction values: a hit
+// predicts near-immediate re-reference (0), the victim is the first way predicted
+// distant (3), aging the whole set until one is. SRRIP fills at long (2); BRRIP fills
+// at distant and only 1 in 32 at long, so a scan larger than the cache does not flush it.
+template <bool Bimodal>
+class rrip_repl_t {
+private:
+   static constexpr uint8_t DISTANT = 3;
+   static constexpr uint8_t LONG = 2;
+   static constexpr uint64_t BIMODAL_LONG = 32;
+   uint64_t assoc = 0;
+   uint8_t *rrpv = NULL;
+   repl_rng_t rng;
+
+public:
+   static constexpr bool FILL_INVALID_FIRST = true;
+   static constexpr bool REPEAT_HIT_IS_NOOP = false;  // a hit after a fill promotes to 0
+
+   ~rrip_repl_t() { table_free(rrpv); }
+
+   void init(uint64_t num_sets, uint64_t assoc)
+   {
+      this->assoc = assoc;
+      rrpv = (uint8_t *)table_alloc(num_sets * assoc);
+      for (uint64_t i = 0; i < num_sets * assoc; i++)
+         rrpv[i] = DISTANT;
+   }
+
+   void hit(uint64_t index, uint64_t way) { rrpv[index * assoc + way] = 0; }
+
+   void fill(uint64_t index, uint64_t way)
+   {
+      rrpv[index * assoc + way] = (Bimodal && (rng.next() % BIMODAL_LONG)) ? DISTANT : LONG;
+   }
+
+   // Ages the set by DISTANT - (its largest value) at once instead of one step at a time.
+   uint64_t victim(uint64_t index)
+   {
+      uint8_t *r = &rrpv[index * assoc];
+      uint64_t way = 0;
+      for (uint64_t j = 1; j < assoc; j++)
+         if (r[j] > r[way])
+            way = j;
+      const uint8_t age = DISTANT - r[way];
+      if (age)
+         for (uint64_t j = 0; j < assoc; j++)
+            r[j] += age;
+      return way;
+   }
+
+   void checkpoint_way(ckpt_t& c, uint64_t index, uint64_t way) { c.io(rrpv[index * assoc + way]); }
+   void checkpoint(ckpt_t& c) { c.io(rng.state); }
+};
+
+typedef rrip_repl_t<false> srrip_repl_t;
+typedef rrip_repl_t<true> brrip_repl_t;
+
+// Uniformly random victim among the valid ways.
+class random_repl_t {
+private:
+   uint64_t assoc = 0;
+   repl_rng_t rng;
+
+public:
+   static constexpr bool FILL_INVALID_FIRST = true;
+   static constexpr bool REPEAT_HIT_IS_NOOP = true;
+
+   void init(uint64_t num_sets, uint64_t assoc) { this->assoc = assoc; }
+   void hit(uint64_t index, uint64_t way) {}
+   void fill(uint64_t index, uint64_t way) {}
+   uint64_t victim(uint64_t index) { return rng.next() % assoc; }
+   void checkpoint_way(ckpt_t& c, uint64_t index, uint64_t way) {}
+   void checkpoint(ckpt_t& c) { c.io(rng.state); }
+};
+
+#endif
@@ -24,99 +24,160 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <inttypes.h>
 #include <assert.h>
+#include <string.h>
+#include <algorithm>
 #include "resource_schedule.h"
+#include "checkpoint.h"
 
 resource_schedule::resource_schedule(uint64_t width) {
+   assert(width > 0);
    base_cycle = 0;
    this->width = width;
-   depth = SCHED_DEPTH_INCREMENT;
-   sched = new uint64_t[depth];
-   for (uint64_t i = 0; i < depth; i++)
-      sched[i] = 0;
+   depth = SCHED_MIN_DEPTH;
+   mask = depth - 1;
+   sched.assign(depth, 0);
+   full.assign(depth / 64, 0);
 }
 
 resource_schedule::~resource_schedule() {
 }
 
+// Grows the ring to the next power of two >= new_depth (at least doubling), moving each
+// live cycle to its slot under the new mask.
 void resource_schedule::resize(uint64_t new_depth) {
-   uint64_t old_depth;
-   uint64_t *old;
-   uint64_t increments;
-   uint64_t i;
-
-   old_depth = depth;
-   old = sched;
-
-   increments = (new_depth/SCHED_DEPTH_INCREMENT);
-   if (new_depth % SCHED_DEPTH_INCREMENT)
-      increments++;
-   depth = increments*SCHED_DEPTH_INCREMENT;
-   assert(depth >= new_depth);
-
-   sched = new uint64_t[depth];
-   for (i = 0; i < old_depth; i++)
-      sched[i] = old[i];
-   for (i = old_depth; i < depth; i++)
-      sched[i] = 0;
-
-   delete[] old;
+   uint64_t d = depth * 2;
+   while (d < new_depth)
+      d *= 2;
+
+   std::vector<uint64_t> old;
+   old.swap(sched);
+   const uint64_t old_mask = mask;
+
+   depth = d;
+   mask = depth - 1;
+   sched.assign(depth, 0);
+   full.assign(depth / 64, 0);
+   for (uint64_t c = base_cycle; c <= base_cycle + old_mask; c++) {
+      const uint64_t n = old[c & old_mask];
+      sched[c & mask] = n;
+      if (n == width)
+         full[(c & mask) >> 6] |= (1lu << (c & 63));
+   }
+}
+
+// First cycle >= cycle that has a free lane.
+uint64_t resource_schedule::find_free(uint64_t cycle) const {
+   const uint64_t end = base_cycle + depth;
+   if (cycle >= end)
+      return cycle;
+   while (cycle < end) {
+      const uint64_t bit = cycle & 63;
+      const uint64_t avail = ~full[(cycle & mask) >> 6] >> bit;
+      if (avail)
+         return std::min(cycle + __builtin_ctzl(avail), end);
+      cycle += 64 - bit;
+   }
+   return end;
+}
+
+// Reserves one lane in a cycle known to have one free.
+void resource_schedule::take(uint64_t cycle) {
+   if ((cycle - base_cycle + 1) > depth)
+      resize(cycle - base_cycle + 1);
+
+   const uint64_t i = cycle & mask;
+   assert(sched[i] < width);
+   if (++sched[i] == width)
+      full[i >> 6] |= (1lu << (i & 63));
 }
 
 uint64_t resource_schedule::schedule(uint64_t start_cycle, uint64_t max_delta) 
 {
    assert(start_cycle >= base_cycle);
 
-   uint64_t limit_cycle = max_delta == MAX_CYCLE ? MAX_CYCLE : start_cycle + max_delta;
-   bool found = false;
+   const uint64_t limit_cycle = max_delta == MAX_CYCLE ? MAX_CYCLE : start_cycle + max_delta;
+   const uint64_t cycle = find_free(start_cycle);
+   if (cycle > limit_cycle)
+      return MAX_CYCLE;
 
-   while (!found) {
-      if ((start_cycle - base_cycle + 1) > depth)
-         resize(start_cycle - base_cycle + 1);
-
-      if (sched[MOD_S(start_cycle,depth)] < width) {
-         found = true;
-         sched[MOD_S(start_cycle,depth)]++;
-      }
-      else {
-         start_cycle++;
-         if(start_cycle > limit_cycle)
-         {
-            return MAX_CYCLE;
-         }
-      }
-   }
-
-   assert(found);
-   return(start_cycle);
+   take(cycle);
+   return(cycle);
 }
 
 uint64_t resource_schedule::try_schedule(uint64_t try_cycle)
 {
    // Calling this assumes all previous events to schedule have been scheduled.
    assert(try_cycle >= base_cycle);
+   return find_free(try_cycle);
+}
 
-   bool found = false;
-
-   while (!found) {
-      if ((try_cycle - base_cycle + 1) > depth)
-         resize(try_cycle - base_cycle + 1);
+uint64_t resource_schedule::first_free(uint64_t first, uint64_t last) const
+{
+   assert(first >= base_cycle);
+   if (first > last)
+      return MAX_CYCLE;
+   const uint64_t cycle = find_free(first);
+   return (cycle <= last) ? cycle : MAX_CYCLE;
+}
 
-      if (sched[MOD_S(try_cycle,depth)] < width) {
-         found = true;
-      }
-      else {
-         try_cycle++;
-      }
+uint64_t resource_schedule::reserve(uint64_t first, uint64_t last, uint64_t k, uint64_t *cycles)
+{
+   uint64_t n = 0;
+   while (n < k) {
+      const uint64_t cycle = first_free(first, last);
+      if (cycle == MAX_CYCLE)
+         break;
+      do {
+         take(cycle);
+         cycles[n++] = cycle;
+      } while ((n < k) && (sched[cycle & mask] < width));
+      if (cycle == last)
+         break;
+      first = cycle + 1;
    }
+   return n;
+}
 
-   assert(found);
-   return(try_cycle);
+// Frees cycles [first, last] (ring slots, first <= last < depth).
+void resource_schedule::clear(uint64_t first, uint64_t last) {
+   memset(&sched[first], 0, (last - first + 1) * sizeof(uint64_t));
+   const uint64_t fw = first >> 6, lw = last >> 6;
+   const uint64_t lo = ~0lu << (first & 63);
+   const uint64_t hi = ~0lu >> (63 - (last & 63));
+   if (fw == lw)
+      full[fw] &= ~(lo & hi);
+   else {
+      full[fw] &= ~lo;
+      for (uint64_t w = fw + 1; w < lw; w++)
+         full[w] = 0;
+      full[lw] &= ~hi;
+   }
 }
 
 void resource_schedule::advance_base_cycle(uint64_t new_base_cycle) {
    assert(new_base_cycle >= base_cycle);
-   for (uint64_t i = base_cycle; i < new_base_cycle; i++)
-      sched[MOD_S(i,depth)] = 0;
+   if (new_base_cycle == base_cycle)
+      return;
+   if ((new_base_cycle - base_cycle) >= depth)
+      clear(0, mask);
+   else {
+      const uint64_t first = base_cycle & mask;
+      const uint64_t last = (new_base_cycle - 1) & mask;
+      if (first <= last)
+         clear(first, last);
+      else {
+         clear(first, mask);
+         clear(0, last);
+      }
+   }
    base_cycle = new_base_cycle;
 }
 
+void resource_schedule::checkpoint(ckpt_t& c) {
+   c.io(depth);
+   c.io(width);
+   c.io(base_cycle);
+   c.io(sched);
+   c.io(full);
+   mask = depth - 1;
+}
@@ -22,25 +22,49 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Author: Eric Rotenberg (ericro@ncsu.edu)
 
 
-#define SCHED_DEPTH_INCREMENT 256
-#define MOD_S(x,y)      ((x) & ((y)-1))
+#include <inttypes.h>
+#include <vector>
+
+#define SCHED_MIN_DEPTH 256
 
 constexpr uint64_t MAX_CYCLE = ~0lu;
 
+class ckpt_t;
+
+// Occupancy of "width" identical lanes per cycle, for cycles [base_cycle, base_cycle+depth).
+//
+// The cycles live in a power-of-two ring of per-cycle counts, plus a bitmap with one bit
+// per ring slot set when the cycle is full, so the first free cycle at or after a given
+// one is found a 64-cycle word at a time with count-trailing-zeros. Cycles past the end of
+// the ring have never been reserved and are free. The ring doubles when a reservation
+// falls past its end, and advance_base_cycle() clears the retired cycles a range at a time.
+
 class resource_schedule {
 private:
-   uint64_t *sched;
+   std::vector<uint64_t> sched;   // reservations per cycle, indexed by cycle & mask
+   std::vector<uint64_t> full;    // bit (cycle & mask) set when sched[] == width
    uint64_t depth;
+   uint64_t mask;
    uint64_t width;
 
    uint64_t base_cycle;
 
    void resize(uint64_t new_depth);
+   uint64_t find_free(uint64_t cycle) const;
+   void take(uint64_t cycle);
+   void clear(uint64_t first, uint64_t last);
 
 public:
    resource_schedule(uint64_t width);
    ~resource_schedule();
    uint64_t schedule(uint64_t start_cycle, uint64_t max_delta = MAX_CYCLE);
    uint64_t try_schedule(uint64_t try_cycle);
+   // Range queries: the first cycle in [first, last] with a free lane (MAX_CYCLE if none),
+   // and reserving up to k lanes in [first, last], earliest first, exactly as k calls of
+   // schedule(first, last - first) would. reserve() stores the cycles in cycles[] and
+   // returns how many lanes it got.
+   uint64_t first_free(uint64_t first, uint64_t last) const;
+   uint64_t reserve(uint64_t first, uint64_t last, uint64_t k, uint64_t *cycles);
    void advance_base_cycle(uint64_t new_base_cycle);
+   void checkpoint(ckpt_t& c);
 };
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
+#include "stats.h"
+#include "checkpoint.h"
+#include "parameters.h"
+#include "memstats.h"
+
+void stats_t::counter(const std::string& name, const uint64_t *value)
+{
+   counter(name, [value]() { return *value; });
+}
+
+void stats_t::counter(const std::string& name, std::function<uint64_t()> value)
+{
+   counters.push_back({name, value});
+}
+
+void stats_t::ratio(const std::string& name, const std::string& num, const std::string& den, double scale)
+{
+   ratios.push_back({name, find(num), find(den), scale});
+}
+
+void stats_t::summary(const std::string& name, std::function<double()> value)
+{
+   summaries.push_back({name, value});
+}
+
+size_t stats_t::find(const std::string& name) const
+{
+   for (size_t i = 0; i < counters.size(); i++)
+      if (counters[i].name == name)
+         return i;
+   fprintf(stderr, "Stats: ratio refers to unregistered counter %s.\n", name.c_str());
+   exit(EXIT_FAILURE);
+}
+
+std::vector<uint64_t> stats_t::snapshot() const
+{
+   std::vector<uint64_t> values(counters.size());
+   for (size_t i = 0; i < counters.size(); i++)
+      values[i] = counters[i].read();
+   return values;
+}
+
+double stats_t::ratio_value(const ratio_t& r, const std::vector<uint64_t>& values) const
+{
+   return r.scale * (double)values[r.num] / (double)values[r.den];
+}
+
+void stats_t::end_epoch()
+{
+   epoch_snapshots.push_back(snapshot());
+}
+
+void stats_t::reset_epochs()
+{
+   epoch_snapshots.clear();
+}
+
+mem_usage_t stats_t::epoch_memory() const
+{
+   mem_usage_t u = mem_usage(epoch_snapshots);
+   for (const std::vector<uint64_t>& s : epoch_snapshots)
+      u.bytes += s.capacity() * sizeof(uint64_t) + MEM_MALLOC_OVERHEAD;
+   return u;
+}
+
+void stats_t::checkpoint(ckpt_t& c)
+{
+   c.io(epoch_snapshots);
+}
+
+// 0/0 and x/0 have no JSON representation; they are written as null (JSON) or left empty (CSV).
+static void print_double(FILE *fp, double v, bool json)
+{
+   if (isfinite(v))
+      fprintf(fp, "%.10g", v);
+   else if (json)
+      fprintf(fp, "null");
+}
+
+void stats_t::write_json(FILE *fp) const
+{
+   const std::vector<uint64_t> values = snapshot();
+
+   fprintf(fp, "{\n  \"stats\": {");
+   const char *sep = "\n";
+   for (size_t i = 0; i < counters.size(); i++) {
+      fprintf(fp, "%s    \"%s\": %lu", sep, counters[i].name.c_str(), values[i]);
+      sep = ",\n";
+   }
+   for (const ratio_t& r : ratios) {
+      fprintf(fp, "%s    \"%s\": ", sep, r.name.c_str());
+      print_double(fp, ratio_value(r, values), true);
+   }
+   for (const summary_t& s : summaries) {
+      fprintf(fp, "%s    \"%s\": ", sep, s.name.c_str());
+      print_double(fp, s.read(), true);
+   }
+   fprintf(fp, "\n  }");
+
+   if (!epoch_snapshots.empty()) {
+      fprintf(fp, ",\n  \"epochs\": [");
+      std::vector<uint64_t> delta(counters.size());
+      for (size_t e = 0; e < epoch_snapshots.size(); e++) {
+         for (size_t i = 0; i < counters.size(); i++)
+            delta[i] = epoch_snapshots[e][i] - ((e > 0) ? epoch_snapshots[e - 1][i] : 0);
+
+         fprintf(fp, "%s    {\"epoch\": %lu", ((e > 0) ? ",\n" : "\n"), e);
+         for (size_t i = 0; i < counters.size(); i++)
+            fprintf(fp, ", \"%s\": %lu", counters[i].name.c_str(), delta[i]);
+         for (const ratio_t& r : ratios) {
+            fprintf(fp, ", \"%s\": ", r.name.c_str());
+            print_double(fp, ratio_value(r, delta), true);
+         }
+         fprintf(fp, "}");
+      }
+      fprintf(fp, "\n  ]");
+   }
+   fprintf(fp, "\n}\n");
+}
+
+void stats_t::write_csv(FILE *fp) const
+{
+   const std::vector<uint64_t> values = snapshot();
+
+   const char *sep = "";
+   for (const counter_t& c : counters) {
+      fprintf(fp, "%s%s", sep, c.name.c_str());
+      sep = ",";
+   }
+   for (const ratio_t& r : ratios)
+      fprintf(fp, ",%s", r.name.c_str());
+   for (const summary_t& s : summaries)
+      fprintf(fp, ",%s", s.name.c_str());
+   fprintf(fp, "\n");
+
+   sep = "";
+   for (uint64_t v : values) {
+      fprintf(fp, "%s%lu", sep, v);
+      sep = ",";
+   }
+   for (const ratio_t& r : ratios) {
+      fprintf(fp, ",");
+      print_double(fp, ratio_value(r, values), false);
+   }
+   for (const summary_t& s : summaries) {
+      fprintf(fp, ",");
+      print_double(fp, s.read(), false);
+   }
+   fprintf(fp, "\n");
+}
+
+void stats_t::write_epochs_csv(FILE *fp) const
+{
+   fprintf(fp, "epoch");
+   for (const counter_t& c : counters)
+      fprintf(fp, ",%s", c.name.c_str());
+   for (const ratio_t& r : ratios)
+      fprintf(fp, ",%s", r.name.c_str());
+   fprintf(fp, "\n");
+
+   std::vector<uint64_t> delta(counters.size());
+   for (size_t e = 0; e < epoch_snapshots.size(); e++) {
+      for (size_t i = 0; i < counters.size(); i++)
+         delta[i] = epoch_snapshots[e][i] - ((e > 0) ? epoch_snapshots[e - 1][i] : 0);
+
+      fprintf(fp, "%lu", e);
+      for (uint64_t v : delta)
+         fprintf(fp, ",%lu", v);
+      for (const ratio_t& r : ratios) {
+         fprintf(fp, ",");
+         print_double(fp, ratio_value(r, delta), false);
+      }
+      fprintf(fp, "\n");
+   }
+}
+
+static FILE *open_stats_file(const std::string& path)
+{
+   FILE *fp = fopen(path.c_str(), "w");
+   if (!fp) {
+      fprintf(stderr, "Stats: cannot open %s for writing.\n", path.c_str());
+      exit(EXIT_FAILURE);
+   }
+   return fp;
+}
+
+void stats_t::dump(const std::string& prefix) const
+{
+   if (STATS_JSON) {
+      FILE *fp = open_stats_file(prefix + "_stats.json");
+      write_json(fp);
+      fclose(fp);
+   }
+
+   if (STATS_CSV) {
+      FILE *fp = open_stats_file(prefix + "_stats.csv");
+      write_csv(fp);
+      fclose(fp);
+
+      if (!epoch_snapshots.empty()) {
+         fp = open_stats_file(prefix + "_epoch_stats.csv");
+         write_epochs_csv(fp);
+         fclose(fp);
+      }
+   }
+}
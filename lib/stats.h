@@ -0,0 +1,85 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+class ckpt_t;
+struct mem_usage_t;
+
+// Registry of named measurements for machine-readable output (-S json|csv).
+//
+// Each component registers its counters once, next to the counters themselves, under a
+// dotted name ("L1.misses", "bp.conddir.mispredicts"). Values are only read when a
+// snapshot is taken, so registration adds nothing to the simulation path.
+//
+// At the end of the run the registry writes <prefix>_stats.json and/or <prefix>_stats.csv.
+// With -E it also snapshots every counter at each epoch boundary; the per-epoch rows hold
+// the difference between consecutive snapshots and the ratios recomputed from those.
+
+class stats_t {
+public:
+   // A counter is read through the pointer (or function) whenever a snapshot is taken.
+   void counter(const std::string& name, const uint64_t *value);
+   void counter(const std::string& name, std::function<uint64_t()> value);
+
+   // scale * num / den over two already registered counters.
+   void ratio(const std::string& name, const std::string& num, const std::string& den, double scale = 1.0);
+
+   // Whole-run values that have no per-epoch meaning (e.g. the 50% window).
+   void summary(const std::string& name, std::function<double()> value);
+
+   // Per-epoch snapshots (-E).
+   void end_epoch();
+   void reset_epochs();
+
+   // Writes the files selected by STATS_JSON / STATS_CSV next to the result log.
+   void dump(const std::string& prefix) const;
+
+   void checkpoint(ckpt_t& c);
+
+   // Size of the per-epoch snapshots, for the memory report (-m).
+   mem_usage_t epoch_memory() const;
+
+private:
+   struct counter_t {
+      std::string name;
+      std::function<uint64_t()> read;
+   };
+
+   struct ratio_t {
+      std::string name;
+      size_t num;
+      size_t den;
+      double scale;
+   };
+
+   struct summary_t {
+      std::string name;
+      std::function<double()> read;
+   };
+
+   std::vector<counter_t> counters;
+   std::vector<ratio_t> ratios;
+   std::vector<summary_t> summaries;
+
+   // Cumulative counter values at the end of each epoch.
+   std::vector<std::vector<uint64_t>> epoch_snapshots;
+
+   size_t find(const std::string& name) const;
+   std::vector<uint64_t> snapshot() const;
+   double ratio_value(const ratio_t& r, const std::vector<uint64_t>& values) const;
+
+   void write_json(FILE *fp) const;
+   void write_csv(FILE *fp) const;
+   void write_epochs_csv(FILE *fp) const;
+};
+
+// Hook into the predictor side of the interface, implemented next to the other cbp.h
+// hooks in cond_branch_predictor_interface.cc.
+extern void register_cond_dir_predictor_stats(stats_t& s);
+
+#endif
@@ -6,6 +6,10 @@
 #include <map>
 #include <algorithm>
 //#include <optional>
+#include "checkpoint.h"
+#include "stats.h"
+#include "profiler.h"
+#include "memstats.h"
 
 #define DEF_ENUM(ENUM, NAME) _DEF_ENUM(ENUM, NAME)
 #define _DEF_ENUM(ENUM, NAME)                          \
@@ -54,8 +58,9 @@ static std::ostream& operator<<(std::ostream& stream, const PrefetcherState& s)
 }
 
 constexpr uint64_t NUM_RPT_ENTRIES = 1024;
+constexpr uint64_t RPT_HASH_BITS = 11;      // PC index with 2 slots per RPT entry
 constexpr uint64_t PREFETCH_MULTIPLIER = 2; // 2 because when we lookahead, we are 1 behind, so need next(next(access))
-constexpr int PF_QUEUE_SIZE = 32;
+constexpr int PF_QUEUE_SIZE = 32;         // queued prefetches held without reallocating (not a limit)
 constexpr uint64_t CACHE_LINE_MASK = ~63lu;
 constexpr uint64_t PF_MUST_ISSUE_BEFORE_CYCLES = 8;
 
@@ -67,7 +72,7 @@ struct RPTEntry
     uint64_t prev_address = 0xdeadbeef;
     uint64_t current_address = 0xdeadbeef;
     int64_t stride = -1;
-    uint64_t lru= 0;
+    uint64_t lru= 0;    // LRU rank (0: next victim), written out for checkpoints only; the live order is StridePrefetcher::lru_prev/lru_next
     uint64_t index = -1;
 
     RPTEntry() =default;
@@ -87,6 +92,17 @@ struct RPTEntry
         return stream;
 
     }
+
+    void checkpoint(ckpt_t& c)
+    {
+        c.io(state);
+        c.io(tag);
+        c.io(prev_address);
+        c.io(current_address);
+        c.io(stride);
+        c.io(lru);
+        c.io(index);
+    }
 };
 
 enum class CacheLevel
@@ -112,6 +128,12 @@ struct Prefetch
         return stream;
     }
 
+    void checkpoint(ckpt_t& c)
+    {
+        c.io(address);
+        c.io(cycle_generated);
+    }
+
     uint64_t address = 0xdeadbeef;
     uint64_t cycle_generated = ~0lu;
     //CacheLevel level;
@@ -128,8 +150,10 @@ class StridePrefetcher
             rpt[i].index = i;
             rpt[i].lru = i;
         }
+        rebuild_index();
         //Clear queue of generated prefetches
-        queue.clear();
+        queue.reserve(PF_QUEUE_SIZE);
+        queue_clear();
     }
 
     StridePrefetcher()
@@ -139,55 +163,78 @@ class StridePrefetcher
 
     uint64_t victim_way()
     {
-        auto entry = std::find_if(rpt.begin(), rpt.end(), [](RPTEntry& e){ return !e.lru; });
-        assert((entry != rpt.end()) && "Must find a valid victim way ");
-        spdlog::debug("Prefetch: Found victim entry : {}", *entry);
-
-        return entry->index;
+        spdlog::debug("Prefetch: Found victim entry : {}", rpt[lru_head]);
+        return lru_head;
     }
 
+    // Moves the entry to the MRU end of the LRU list.
     void update_lru(uint64_t index)
     {
         spdlog::debug("Updating LRU Index: {}", index);
-        auto& lru_way = rpt[index];
-        std::for_each(rpt.begin(), rpt.end(), [&lru_way](RPTEntry &e) { if(e.lru > lru_way.lru){ --e.lru;} });
-        lru_way.lru = (NUM_RPT_ENTRIES - 1);
+        if (index == lru_tail)
+            return;
+        if (index == lru_head)
+            lru_head = lru_next[index];
+        else
+            lru_next[lru_prev[index]] = lru_next[index];
+        lru_prev[lru_next[index]] = lru_prev[index];
+        lru_prev[index] = lru_tail;
+        lru_next[index] = RPT_NONE;
+        lru_next[lru_tail] = index;
+        lru_tail = index;
+    }
+
+    // RPT index of the valid entry for pc, RPT_NONE if there is none.
+    uint64_t find(uint64_t pc) const
+    {
+        for (uint64_t slot = rpt_slot(pc); rpt_hash[slot]; slot = (slot + 1) & RPT_HASH_MASK)
+        {
+            if (rpt[rpt_hash[slot] - 1].tag == pc)
+                return rpt_hash[slot] - 1;
+        }
+        return RPT_NONE;
     }
 
     // Prefetches will be generated when the load is fetched as in "Effective Hardware-Based Data Prefetching for High-Performance Processors"
     // However because we train immediately, there is no need for a count variable.
     void lookahead(uint64_t la_pc, uint64_t cycle)
     {
-        auto entry = std::find_if(rpt.begin(), rpt.end(), [la_pc](RPTEntry& e){ return e.tag == la_pc; });
-        if(entry == rpt.end())
+        PROFILE_SCOPE(Prefetcher);
+        const uint64_t index = find(la_pc);
+        if(index == RPT_NONE)
         {
             return;
         }
-        else if(entry->state == PrefetcherState::SteadyState)
+        else if(rpt[index].state == PrefetcherState::SteadyState)
         {
-            generate(*entry, cycle);
+            generate(rpt[index], cycle);
         }
     }
 
     void train(const PrefetchTrainingInfo & info)
     {
+        PROFILE_SCOPE(Prefetcher);
         spdlog::debug("Prefetcher: Training on LD {}", info);
-        auto entry = std::find_if(rpt.begin(), rpt.end(), [&info](RPTEntry& e){ return e.tag == info.pc; });
-        if(entry == rpt.end())
+        const uint64_t index = find(info.pc);
+        if(index == RPT_NONE)
         {
             //Establish a new entry
             auto victim_index = victim_way();
             auto& victim_entry = rpt[victim_index];
+            if(victim_entry.state != PrefetcherState::Invalid)
+                unhash(victim_index);
             victim_entry.state = PrefetcherState::Initial;
             victim_entry.tag = info.pc;
             victim_entry.prev_address = 0xdeadbeef;
             victim_entry.current_address = info.address;
             victim_entry.stride = 0;
+            hash(victim_index);
             spdlog::debug("Prefetcher: Overwriting entry now in Initial STate : {}", victim_entry);
             update_lru(victim_index);
         }
         else
         {
+            RPTEntry *entry = &rpt[index];
             switch(entry->state){
                 case PrefetcherState::Initial:
                 {
@@ -294,29 +341,9 @@ class StridePrefetcher
         Prefetch pf{entry.current_address + entry.stride * PREFETCH_MULTIPLIER, cycle};
         spdlog::debug("Prefetcher: Queuing a new prefetch: {} Entry {}", pf, entry);
 
-        auto it = std::find_if(queue.begin(), queue.end(), [&](const Prefetch & qpf)
-        {
-            return (qpf.address & CACHE_LINE_MASK) == (pf.address & CACHE_LINE_MASK);
-        });
-
-        if(it == queue.end())
+        if(!line_queued(pf.address))
         {
-            queue.push_back(pf);
-            
-            // Make extra sure PF are sorted by generation order from oldest to youngest
-            std::sort(queue.begin(), queue.end(), [](const Prefetch & lhs, const Prefetch & rhs)
-            {
-                if(lhs.cycle_generated != rhs.cycle_generated)
-                {
-                    return lhs.cycle_generated < rhs.cycle_generated;
-                }
-                if(lhs.address != rhs.address)
-                {
-                    return lhs.address < rhs.address;
-                }
-                return false;
-            });
-
+            queue_push(pf);
             ++stat_generated;
         }
         else
@@ -329,11 +356,12 @@ class StridePrefetcher
 
     bool issue(Prefetch& p, uint64_t cycle)
     {
+        PROFILE_SCOPE(Prefetcher);
         while(!queue.empty() && (queue.front().cycle_generated + PF_MUST_ISSUE_BEFORE_CYCLES) < cycle)
         {
             spdlog::debug("Dropping pf because too old (created at cycle {}, current fetch cycle {})", queue.front().cycle_generated, cycle);
             ++stat_dropped_untimely_pf;
-            queue.pop_front();
+            queue_pop();
         }
 
         if(!queue.empty())
@@ -341,7 +369,7 @@ class StridePrefetcher
             p = queue.front();
             if(p.cycle_generated <= cycle)
             {
-                queue.pop_front();
+                queue_pop();
                 ++stat_issued;
                 return true;
             }
@@ -351,10 +379,11 @@ class StridePrefetcher
         return false;
     }
 
+    // p was just issued, so it is still the oldest and goes back to the front.
     void put_back(const Prefetch & p)
     {
         ++stat_put_back;
-        queue.push_front(p);
+        queue_push(p);
     }
 
     uint64_t get_oldest_pf_cycle() const
@@ -379,12 +408,229 @@ class StridePrefetcher
         std::cout << "Num prefetches not issued LDST contention :" << stat_put_back << std::endl;
         std::cout << "Num prefetches not issued stride 0 :" << stat_stride_zero << std::endl;
     }
+
+    void register_stats(stats_t& s, const std::string& name)
+    {
+        s.counter(name + ".trainings", &stat_trainings);
+        s.counter(name + ".generated", &stat_generated);
+        s.counter(name + ".issued", &stat_issued);
+        s.counter(name + ".filtered_by_queue", &stat_duplicate_pf_filtered);
+        s.counter(name + ".dropped_untimely", &stat_dropped_untimely_pf);
+        s.counter(name + ".not_issued_ldst_contention", &stat_put_back);
+        s.counter(name + ".not_issued_stride_zero", &stat_stride_zero);
+    }
+
+    void register_memory(memstats_t& m, const std::string& name)
+    {
+        m.track(name + ".queue", [this]() { return mem_usage_t{queue.size(), mem_usage(queue).bytes + queue_lines.capacity() * sizeof(uint64_t)}; });
+    }
+
+    // Keep the trained RPT; drop queued prefetches (generated on the warm-up clock) and stats.
+    void end_warmup()
+    {
+        queue_clear();
+        stat_trainings = 0;
+        stat_generated = 0;
+        stat_issued = 0;
+        stat_duplicate_pf_filtered = 0;
+        stat_dropped_untimely_pf = 0;
+        stat_put_back = 0;
+        stat_stride_zero = 0;
+    }
+
+    // The LRU order travels as RPTEntry::lru ranks and the queue as a sorted deque; the
+    // PC index, the heap and the line set are rebuilt on restore.
+    void checkpoint(ckpt_t& c)
+    {
+        if (c.saving())
+        {
+            uint64_t rank = 0;
+            for (uint64_t i = lru_head; i != RPT_NONE; i = lru_next[i])
+                rpt[i].lru = rank++;
+        }
+        c.io(rpt);
+        if (c.restoring())
+            rebuild_index();
+        std::deque<Prefetch> sorted(queue.begin(), queue.end());
+        std::sort(sorted.begin(), sorted.end(), [](const Prefetch& a, const Prefetch& b) { return later(b, a); });
+        c.io(sorted);
+        if (c.restoring())
+        {
+            queue_clear();
+            for (const Prefetch& p : sorted)
+                queue_push(p);
+        }
+        c.io(stat_trainings);
+        c.io(stat_generated);
+        c.io(stat_issued);
+        c.io(stat_duplicate_pf_filtered);
+        c.io(stat_dropped_untimely_pf);
+        c.io(stat_put_back);
+        c.io(stat_stride_zero);
+    }
     private:
+    static constexpr uint64_t RPT_HASH_SIZE = 1lu << RPT_HASH_BITS;
+    static constexpr uint64_t RPT_HASH_MASK = RPT_HASH_SIZE - 1;
+    static constexpr uint16_t RPT_NONE = 0xffff;
+    static_assert(RPT_HASH_SIZE >= 2 * NUM_RPT_ENTRIES, "PC index must stay at most half full");
+    static_assert(NUM_RPT_ENTRIES < RPT_NONE, "RPT indices are stored in 16 bits");
+
     std::array<RPTEntry, NUM_RPT_ENTRIES> rpt;
     uint64_t lru_info;
 
-    //Queue to store generated prefetches
-    std::deque<Prefetch> queue;
+    // PC -> RPT index + 1 (0: empty slot) for the valid entries, open addressing with
+    // linear probing.
+    std::array<uint16_t, RPT_HASH_SIZE> rpt_hash;
+
+    // True LRU order over all entries as a doubly linked list, from lru_head (victim)
+    // to lru_tail (MRU); the same order as the lru ranks it replaces.
+    std::array<uint16_t, NUM_RPT_ENTRIES> lru_prev;
+    std::array<uint16_t, NUM_RPT_ENTRIES> lru_next;
+    uint16_t lru_head;
+    uint16_t lru_tail;
+
+    static uint64_t rpt_slot(uint64_t pc)
+    {
+        return (pc * 0x9e3779b97f4a7c15lu) >> (64 - RPT_HASH_BITS);
+    }
+
+    void hash(uint64_t index)
+    {
+        uint64_t slot = rpt_slot(rpt[index].tag);
+        while (rpt_hash[slot])
+            slot = (slot + 1) & RPT_HASH_MASK;
+        rpt_hash[slot] = index + 1;
+    }
+
+    // Removes the entry and shifts later entries of its probe run back into the hole.
+    void unhash(uint64_t index)
+    {
+        uint64_t hole = rpt_slot(rpt[index].tag);
+        while (rpt_hash[hole] != index + 1)
+            hole = (hole + 1) & RPT_HASH_MASK;
+        for (uint64_t slot = (hole + 1) & RPT_HASH_MASK; rpt_hash[slot]; slot = (slot + 1) & RPT_HASH_MASK)
+        {
+            const uint64_t home = rpt_slot(rpt[rpt_hash[slot] - 1].tag);
+            if (((slot - home) & RPT_HASH_MASK) >= ((slot - hole) & RPT_HASH_MASK))
+            {
+                rpt_hash[hole] = rpt_hash[slot];
+                hole = slot;
+            }
+        }
+        rpt_hash[hole] = 0;
+    }
+
+    // Rebuilds the PC index and the LRU list from rpt (tags, states and lru ranks).
+    void rebuild_index()
+    {
+        rpt_hash.fill(0);
+        std::array<uint16_t, NUM_RPT_ENTRIES> by_rank;
+        for (uint64_t i = 0; i < NUM_RPT_ENTRIES; i++)
+        {
+            assert(rpt[i].lru < NUM_RPT_ENTRIES);
+            by_rank[rpt[i].lru] = i;
+            if (rpt[i].state != PrefetcherState::Invalid)
+                hash(i);
+        }
+        lru_head = by_rank[0];
+        lru_tail = by_rank[NUM_RPT_ENTRIES - 1];
+        for (uint64_t r = 0; r < NUM_RPT_ENTRIES; r++)
+        {
+            lru_prev[by_rank[r]] = r ? by_rank[r - 1] : RPT_NONE;
+            lru_next[by_rank[r]] = (r + 1 < NUM_RPT_ENTRIES) ? by_rank[r + 1] : RPT_NONE;
+        }
+    }
+
+    //Queue to store generated prefetches: a binary min-heap on (cycle_generated, address),
+    //so queue.front() is the oldest prefetch. Lines are unique in the queue, so is the order.
+    std::vector<Prefetch> queue;
+
+    // Cache lines of the queued prefetches (line | 1; 0: empty slot), open addressing with
+    // linear probing, kept at most half full.
+    std::vector<uint64_t> queue_lines;
+    uint64_t queue_lines_bits = 0;
+
+    static bool later(const Prefetch& a, const Prefetch& b)
+    {
+        if (a.cycle_generated != b.cycle_generated)
+            return a.cycle_generated > b.cycle_generated;
+        return a.address > b.address;
+    }
+
+    uint64_t line_slot(uint64_t key) const
+    {
+        return ((key >> 6) * 0x9e3779b97f4a7c15lu) >> (64 - queue_lines_bits);
+    }
+
+    bool line_queued(uint64_t address) const
+    {
+        const uint64_t key = (address & CACHE_LINE_MASK) | 1;
+        const uint64_t mask = queue_lines.size() - 1;
+        for (uint64_t slot = line_slot(key); queue_lines[slot]; slot = (slot + 1) & mask)
+        {
+            if (queue_lines[slot] == key)
+                return true;
+        }
+        return false;
+    }
+
+    void line_insert(uint64_t key)
+    {
+        const uint64_t mask = queue_lines.size() - 1;
+        uint64_t slot = line_slot(key);
+        while (queue_lines[slot])
+            slot = (slot + 1) & mask;
+        queue_lines[slot] = key;
+    }
+
+    void line_erase(uint64_t address)
+    {
+        const uint64_t key = (address & CACHE_LINE_MASK) | 1;
+        const uint64_t mask = queue_lines.size() - 1;
+        uint64_t hole = line_slot(key);
+        while (queue_lines[hole] != key)
+            hole = (hole + 1) & mask;
+        for (uint64_t slot = (hole + 1) & mask; queue_lines[slot]; slot = (slot + 1) & mask)
+        {
+            const uint64_t home = line_slot(queue_lines[slot]);
+            if (((slot - home) & mask) >= ((slot - hole) & mask))
+            {
+                queue_lines[hole] = queue_lines[slot];
+                hole = slot;
+            }
+        }
+        queue_lines[hole] = 0;
+    }
+
+    void queue_push(const Prefetch& pf)
+    {
+        if (2 * (queue.size() + 1) > queue_lines.size())
+        {
+            // Grow the line set; the heap vector grows by itself.
+            queue_lines_bits++;
+            queue_lines.assign(1lu << queue_lines_bits, 0);
+            for (const Prefetch& q : queue)
+                line_insert((q.address & CACHE_LINE_MASK) | 1);
+        }
+        line_insert((pf.address & CACHE_LINE_MASK) | 1);
+        queue.push_back(pf);
+        std::push_heap(queue.begin(), queue.end(), later);
+    }
+
+    void queue_pop()
+    {
+        line_erase(queue.front().address);
+        std::pop_heap(queue.begin(), queue.end(), later);
+        queue.pop_back();
+    }
+
+    void queue_clear()
+    {
+        queue.clear();
+        if (!queue_lines_bits)
+            queue_lines_bits = 63 - __builtin_clzl(2 * PF_QUEUE_SIZE);
+        queue_lines.assign(1lu << queue_lines_bits, 0);
+    }
     //Stats
     uint64_t stat_trainings = 0;
     uint64_t stat_generated = 0;
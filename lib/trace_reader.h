@@ -72,6 +72,9 @@
 #include <vector>
 #include <cassert>
 #include "sim_common_structs.h"
+#include "checkpoint.h"
+#include "profiler.h"
+#include "perfcount.h"
 #include "./gzstream.h"
 
 // This structure is used by CBP's simulator.
@@ -417,12 +420,35 @@ struct TraceReader
         std::cout  << " Read " << nInstr << " instrs " << std::endl;
     }
 
+    // Checkpoints are taken between trace instructions, so the reader state is
+    // the instruction count plus the position in the uncompressed trace.
+    // Restore re-decompresses up to that position without simulating it.
+    void checkpoint(ckpt_t& c)
+    {
+        assert(mProcessedPieces == mTotalPieces);
+        uint64_t offset = c.restoring() ? 0 : dpressed_input->rdbuf()->tell();
+        c.io(nInstr);
+        c.io(offset);
+        if(c.restoring() && !dpressed_input->rdbuf()->seek(offset))
+        {
+            fprintf(stderr, "Checkpoint: cannot seek trace to offset %lu.\n", offset);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Position in the compressed trace file, for progress reporting.
+    uint64_t compressed_offset()
+    {
+        return dpressed_input->rdbuf()->compressed_tell();
+    }
+
     // This is the main API function
     // There is no specific reason to call the other functions from without this file.
     // Idiom is : while(instr = get_inst())
     //              ... process instr
     db_t  *get_inst()
     {
+        PERF_PHASE(TraceDecode);
         // If we are creating several pieces from a single trace instructions and some are left to create,
         // mProcessedPieces != mTotalPieces
         if(mProcessedPieces != mTotalPieces)
@@ -451,6 +477,7 @@ struct TraceReader
     // Number of calls is decided by mProcessedPieces from get_inst().
     db_t *populateNewInstr()
     {
+        PROFILE_SCOPE(PopulateInstr);
         db_t * inst = new db_t();
 
         //std::cout<<"Processing piece:"<<(uint64_t)(1+mProcessedPieces)<<" from:"<<(uint64_t)mTotalPieces<<std::endl;
@@ -669,6 +696,7 @@ struct TraceReader
     // Returns true if something was read from the trace, false if we the trace is over.
     bool readInstr()
     {
+        PROFILE_SCOPE(TraceDecode);
         // Trace Format :
         // Inst PC                  - 8 bytes
         // Inst Type                - 1 byte
@@ -37,15 +37,22 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "resource_schedule.h"
 #include "uarchsim.h"
 #include "parameters.h"
+#include "log.h"
+#include "profiler.h"
+#include "perfcount.h"
+
+extern log_files files;
 
 //uarchsim_t::uarchsim_t():window(WINDOW_SIZE),
 uarchsim_t::uarchsim_t()
       :window_capacity(WINDOW_SIZE)
-      ,L3(L3_SIZE, L3_ASSOC, L3_BLOCKSIZE, L3_LATENCY, (cache_t *)NULL)
-      ,L2(L2_SIZE, L2_ASSOC, L2_BLOCKSIZE, L2_LATENCY, &L3)
-      ,L1(L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, L1_LATENCY, &L2)
+      ,L3(new_cache(L3_REPL, L3_SIZE, L3_ASSOC, L3_BLOCKSIZE, L3_LATENCY, (cache_base_t *)NULL, L3_SAMPLE_BITS, CACHE_SAMPLE_VALIDATE))
+      ,L2(new_cache(L2_REPL, L2_SIZE, L2_ASSOC, L2_BLOCKSIZE, L2_LATENCY, L3, L2_SAMPLE_BITS, CACHE_SAMPLE_VALIDATE))
+      ,L1(new_cache(L1_REPL, L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, L1_LATENCY, L2))
       ,BP()
-      ,IC(IC_SIZE, IC_ASSOC, IC_BLOCKSIZE, 0, &L2) 
+      ,IC(new_cache(IC_REPL, IC_SIZE, IC_ASSOC, IC_BLOCKSIZE, 0, L2))
+      ,pipetrace(WINDOW_SIZE)
+      ,loadprof(LOAD_PROFILE_SIZE, RFSIZE, RFZERO)
 {
    assert(WINDOW_SIZE != 0);
    //assert(FETCH_WIDTH);
@@ -84,9 +91,112 @@ uarchsim_t::uarchsim_t()
    // stats
    num_load = 0;
    num_load_sqmiss = 0;
+   cycles_on_wrong_path = 0;
+
+   piece = UINT8_MAX;
+
+   // Register every measurement once; the registry reads them only when it takes a snapshot.
+   stats.counter("instructions", &num_inst);
+   stats.counter("cycles", [this]() { return last_epoch_end_cycle; });
+   stats.counter("cycles_on_wrong_path", &cycles_on_wrong_path);
+   stats.counter("loads", &num_load);
+   stats.counter("loads_sq_miss", &num_load_sqmiss);
+   stats.counter("pfs_issued_to_mem", &stat_pfs_issued_to_mem);
+   stats.ratio("ipc", "instructions", "cycles");
+   stats.ratio("cycwp_pki", "cycles_on_wrong_path", "instructions", 1000.0);
+   BP.register_stats(stats);
+   if (FETCH_MODEL_ICACHE) {
+      IC->register_stats(stats, "IC");
+      IC->register_filter_stats(stats, "IC");
+   }
+   L1->register_stats(stats, "L1");
+   L2->register_stats(stats, "L2");
+   L3->register_stats(stats, "L3");
+   if (L2_SAMPLE_BITS)
+      L2->register_sampling_stats(stats, "L2");
+   if (L3_SAMPLE_BITS)
+      L3->register_sampling_stats(stats, "L3");
+   prefetcher.register_stats(stats, "prefetcher");
+   register_cond_dir_predictor_stats(stats);
+   BP.register_window_stats(stats, num_insts_per_epoch, num_cycles_per_epoch);
+
+   // Structures whose size depends on the run rather than on the configuration (-m).
+   memstats.track("uarchsim.window", [this]() { return mem_usage(window); });
+   memstats.track("uarchsim.SQ", [this]() { return mem_usage(SQ); });
+   memstats.track("uarchsim.DQ", [this]() { return mem_usage(DQ); });
+   memstats.track("uarchsim.AQ", [this]() { return mem_usage(AQ); });
+   memstats.track("uarchsim.EQ", [this]() { return mem_usage(EQ); });
+   memstats.track("uarchsim.per_epoch_vectors", [this]() {
+      mem_usage_t u = mem_usage(num_insts_per_epoch);
+      u += mem_usage(num_cycles_per_epoch);
+      return u;
+   });
+   BP.register_memory(memstats);
+   prefetcher.register_memory(memstats, "prefetcher");
+   memstats.track("stats.epoch_snapshots", [this]() { return stats.epoch_memory(); });
+   register_cond_dir_predictor_memory(memstats);
+   if (loadprof.enabled())
+      memstats.track("uarchsim.loadprof", [this]() { return loadprof.memory(); });
 }
 
 uarchsim_t::~uarchsim_t() {
+   delete IC;
+   delete L1;
+   delete L2;
+   delete L3;
+}
+
+void uarchsim_t::checkpoint(ckpt_t& c)
+{
+   // Checkpoints are taken between instructions, never between the pieces of one.
+   assert(piece == UINT8_MAX);
+   c.io(piece);
+
+   c.io(num_fetched);
+   c.io(num_fetched_branch);
+   c.io(window);
+   c.io(window_capacity);
+   c.section("uarchsim.lanes");
+   alu_lanes->checkpoint(c);
+   ldst_lanes->checkpoint(c);
+   c.io(RF);
+   c.io(SQ);
+   c.io(DQ);
+   c.io(AQ);
+   c.io(EQ);
+
+   c.section("uarchsim.caches");
+   L3->checkpoint(c);
+   L2->checkpoint(c);
+   L1->checkpoint(c);
+   IC->checkpoint(c);
+
+   c.io(fetch_cycle);
+   c.io(previous_fetch_cycle);
+
+   c.section("uarchsim.bp");
+   BP.checkpoint(c);
+   c.section("uarchsim.prefetcher");
+   prefetcher.checkpoint(c);
+
+   c.section("uarchsim.loadprof");
+   loadprof.checkpoint(c);
+
+   c.section("uarchsim.stats");
+   c.io(num_inst);
+   c.io(num_uop);
+   c.io(cycle);
+   c.io(num_insts_per_epoch);
+   c.io(num_cycles_per_epoch);
+   c.io(last_epoch_end_cycle);
+   c.io(num_eligible);
+   c.io(num_correct);
+   c.io(num_incorrect);
+   c.io(num_load);
+   c.io(num_load_sqmiss);
+   c.io(cycles_on_wrong_path);
+   c.io(stat_pfs_issued_to_mem);
+   c.io(stats);
 }
 
 void uarchsim_t::end_current_begin_new_epoch(const bool first_epoch, const bool last_epoch, const uint64_t epoch_end_cycle)
@@ -100,6 +210,11 @@ void uarchsim_t::end_current_begin_new_epoch(const bool first_epoch, const bool
 
     last_epoch_end_cycle = epoch_end_cycle;
 
+    if(!first_epoch && PRINT_PER_EPOCH_STATS && (STATS_JSON || STATS_CSV))
+    {
+        stats.end_epoch();
+    }
+
     if(!last_epoch)
     {
         // begin new epoch
@@ -136,15 +251,15 @@ PredictionRequest uarchsim_t::get_value_prediction_req_for_track(uint64_t cycle,
          {
             req.cache_hit = HitMissInfo::Miss;
             uint64_t exec_cycle = get_load_exec_cycle(inst);
-            if(L1.is_hit(exec_cycle, inst->addr))
+            if(L1->is_hit(exec_cycle, inst->addr))
             {
                req.cache_hit = HitMissInfo::L1DHit;
             }
-            else if(L2.is_hit(exec_cycle, inst->addr))
+            else if(L2->is_hit(exec_cycle, inst->addr))
             {
                req.cache_hit = HitMissInfo::L2Hit;
             }
-            else if(L3.is_hit(exec_cycle, inst->addr))
+            else if(L3->is_hit(exec_cycle, inst->addr))
             {
                req.cache_hit = HitMissInfo::L3Hit;
             }
@@ -195,12 +310,38 @@ uint64_t uarchsim_t::get_load_exec_cycle(db_t *inst) const
    return exec_cycle;
 }
 
-void uarchsim_t::populate_exec_info(db_t *inst) 
+// Decode/execute information handed to the predictor hooks, derived from the trace record.
+void populate_decode_info(const db_t *inst, DecodeInfo& decode_info)
 {
-    _current_execute_info.reset();
+    decode_info.reset();
+    decode_info.insn_class = inst->insn_class;
 
-    populate_decode_info(inst);
-    _current_execute_info.dec_info = _current_decode_info;
+    if (inst->A.valid) {
+        assert(inst->A.log_reg < RFSIZE);
+        decode_info.src_reg_info.push_back(inst->A.log_reg);
+    }
+    if (inst->B.valid) {
+        assert(inst->B.log_reg < RFSIZE);
+        decode_info.src_reg_info.push_back(inst->B.log_reg);
+    }
+    if (inst->C.valid) {
+        assert(inst->C.log_reg < RFSIZE);
+        decode_info.src_reg_info.push_back(inst->C.log_reg);
+    }
+
+    // Anything to do if inst->D.log_reg != RFFLAGS
+    if (inst->D.valid)
+    {
+        assert(inst->D.log_reg < RFSIZE);
+        decode_info.dst_reg_info.emplace(inst->D.log_reg);
+    }
+}
+
+void populate_exec_info(const db_t *inst, ExecuteInfo& exec_info)
+{
+    exec_info.reset();
+
+    populate_decode_info(inst, exec_info.dec_info);
 
     if(is_br(inst->insn_class))
     {
@@ -209,48 +350,33 @@ void uarchsim_t::populate_exec_info(db_t *inst)
         {
             assert(branch_taken);
         }
-        _current_execute_info.taken.emplace(branch_taken);
-        //_current_execute_info.taken_target.emplace(inst->next_pc);
+        exec_info.taken.emplace(branch_taken);
+        //exec_info.taken_target.emplace(inst->next_pc);
     }
-    _current_execute_info.next_pc = inst->next_pc;
+    exec_info.next_pc = inst->next_pc;
 
     if(inst->is_load || inst->is_store)
     {
-        _current_execute_info.mem_va.emplace(inst->addr);
-        _current_execute_info.mem_sz.emplace(inst->size);
+        exec_info.mem_va.emplace(inst->addr);
+        exec_info.mem_sz.emplace(inst->size);
     }
 
     if (inst->D.valid)
     {
         assert(inst->D.log_reg < RFSIZE);
-        _current_execute_info.dst_reg_value.emplace(inst->D.value);
+        exec_info.dst_reg_value.emplace(inst->D.value);
     }
 }
 
-void uarchsim_t::populate_decode_info(db_t *inst) 
+void uarchsim_t::populate_exec_info(db_t *inst) 
 {
-    _current_decode_info.reset();
-    _current_decode_info.insn_class = inst->insn_class;
-
-    if (inst->A.valid) {
-        assert(inst->A.log_reg < RFSIZE);
-        _current_decode_info.src_reg_info.push_back(inst->A.log_reg);
-    }
-    if (inst->B.valid) {
-        assert(inst->B.log_reg < RFSIZE);
-        _current_decode_info.src_reg_info.push_back(inst->B.log_reg);
-    }
-    if (inst->C.valid) {
-        assert(inst->C.log_reg < RFSIZE);
-        _current_decode_info.src_reg_info.push_back(inst->C.log_reg);
-    }
+    populate_decode_info(inst);
+    ::populate_exec_info(inst, _current_execute_info);
+}
 
-    // Anything to do if inst->D.log_reg != RFFLAGS
-    if (inst->D.valid)
-    {
-        assert(inst->D.log_reg < RFSIZE);
-        _current_decode_info.dst_reg_info.emplace(inst->D.log_reg);
-    }
+void uarchsim_t::populate_decode_info(db_t *inst) 
+{
+    ::populate_decode_info(inst, _current_decode_info);
 }
 
 const window_t& uarchsim_t::locate_entry_in_window(uint64_t seq_no, uint8_t piece) const
@@ -279,7 +405,8 @@ void uarchsim_t::step(db_t *inst)
 ////////////////////////
 // Manage DQ
 ////////////////////////
-void uarchsim_t::eval_decode(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
+template <class C>
+void uarchsim_t::eval_decode(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
 {
    if(!DQ.empty())
    {
@@ -309,7 +436,8 @@ void uarchsim_t::eval_decode(std::ostream& activity_trace, bool& activity_observ
 ////////////////////////
 // Manage AGEN
 ////////////////////////
-void uarchsim_t::eval_aq(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
+template <class C>
+void uarchsim_t::eval_aq(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
 {
    auto aq_it = AQ.begin();
    while(aq_it != AQ.end())
@@ -338,7 +466,8 @@ void uarchsim_t::eval_aq(std::ostream& activity_trace, bool& activity_observed,
 ////////////////////////
 // Manage Execute
 ////////////////////////
-void uarchsim_t::eval_exec(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
+template <class C>
+void uarchsim_t::eval_exec(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
 {
    auto eq_it = EQ.begin();
    while(eq_it != EQ.end())
@@ -364,7 +493,8 @@ void uarchsim_t::eval_exec(std::ostream& activity_trace, bool& activity_observed
 /////////////////////////////
 // Manage window: retire.
 /////////////////////////////
-void uarchsim_t::eval_retire(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
+template <class C>
+void uarchsim_t::eval_retire(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_cycle) 
 {
    while (!window.empty() && (current_cycle >= window.front().retire_cycle)) {
       //window_t w = window.pop();
@@ -375,19 +505,23 @@ void uarchsim_t::eval_retire(std::ostream& activity_trace, bool& activity_observ
       //window.pop();
       window.pop_front();
       notify_instr_commit(w.seq_no, w.piece, w.PC, w.pred_taken, w.exec_info, current_cycle);
-      if (VP_ENABLE && !VP_PERFECT)
+      if (C::vp() && !C::vp_perfect())
          updatePredictor(w.seq_no, w.addr, w.value, w.latency);
    }
 }
 
-void uarchsim_t::step(db_t *inst) 
+template <class C>
+void uarchsim_t::step_impl(db_t *inst)
 {
+   PROFILE_SCOPE(Step);
+   PERF_PHASE(Step);
    spdlog::debug("Stepping, FC: {}",fetch_cycle);
    bool activity_observed = false;
-   std::ostringstream activity_trace;
+   typename C::activity_stream_t activity_trace;
+   typename C::cache_type *const ic = static_cast<typename C::cache_type *>(IC);
+   typename C::cache_type *const l1 = static_cast<typename C::cache_type *>(L1);
 
    // Preliminary step: determine which piece of the instruction this is.
-   static uint8_t piece = UINT8_MAX;
    //static uint64_t prev_pc = 0xdeadbeef;
    piece = (piece == UINT8_MAX) ? 0 : (piece + 1);
    //prev_pc = inst->pc;
@@ -399,10 +533,10 @@ void uarchsim_t::step(db_t *inst)
        uint64_t temp_fetch_cycle = previous_fetch_cycle;
        while(temp_fetch_cycle <= fetch_cycle)
        {
-           eval_decode(activity_trace, activity_observed, temp_fetch_cycle);
-           eval_aq(activity_trace, activity_observed, temp_fetch_cycle);
-           eval_exec(activity_trace, activity_observed, temp_fetch_cycle);
-           eval_retire(activity_trace, activity_observed, temp_fetch_cycle);
+           eval_decode<C>(activity_trace, activity_observed, temp_fetch_cycle);
+           eval_aq<C>(activity_trace, activity_observed, temp_fetch_cycle);
+           eval_exec<C>(activity_trace, activity_observed, temp_fetch_cycle);
+           eval_retire<C>(activity_trace, activity_observed, temp_fetch_cycle);
            temp_fetch_cycle++;
        }
    }
@@ -419,9 +553,9 @@ void uarchsim_t::step(db_t *inst)
    uint64_t i;
    uint64_t addr;
 
-   if (FETCH_MODEL_ICACHE)
+   if (C::icache())
    {
-      const uint64_t next_fetch_cycle = IC.access(fetch_cycle, true/*read*/, inst->pc);   // Note: I-cache hit latency is "0" (above), so fetch cycle doesn't increase on hits.
+      const uint64_t next_fetch_cycle = ic->fetch(fetch_cycle, inst->pc);   // Note: I-cache hit latency is "0" (above), so fetch cycle doesn't increase on hits.
       assert(next_fetch_cycle >= fetch_cycle);
       // advancing the pipe for the cycles skipped due to L1I$ miss
       if(next_fetch_cycle != fetch_cycle)
@@ -429,10 +563,10 @@ void uarchsim_t::step(db_t *inst)
           uint64_t temp_fetch_cycle = fetch_cycle;
           while(temp_fetch_cycle <= next_fetch_cycle)
           {
-              eval_decode(activity_trace, activity_observed, temp_fetch_cycle);
-              eval_aq(activity_trace, activity_observed, temp_fetch_cycle);
-              eval_exec(activity_trace, activity_observed, temp_fetch_cycle);
-              eval_retire(activity_trace, activity_observed, temp_fetch_cycle);
+              eval_decode<C>(activity_trace, activity_observed, temp_fetch_cycle);
+              eval_aq<C>(activity_trace, activity_observed, temp_fetch_cycle);
+              eval_exec<C>(activity_trace, activity_observed, temp_fetch_cycle);
+              eval_retire<C>(activity_trace, activity_observed, temp_fetch_cycle);
               temp_fetch_cycle++;
           }
           fetch_cycle = next_fetch_cycle;
@@ -440,9 +574,9 @@ void uarchsim_t::step(db_t *inst)
    }
 
    // Predict at fetch time
-   if (VP_ENABLE)
+   if (C::vp())
    {
-      if (VP_PERFECT)
+      if (C::vp_perfect())
       {
          PredictionRequest req = get_value_prediction_req_for_track(fetch_cycle, seq_no, piece, inst);
          pred.predicted_value = inst->D.value;
@@ -501,9 +635,11 @@ void uarchsim_t::step(db_t *inst)
    {
       if (alu_lanes) exec_cycle = alu_lanes->schedule(exec_cycle);
    }
+   const uint64_t issue_cycle = exec_cycle;
 
    const uint64_t agen_cycle = is_mem(inst->insn_class) ? (exec_cycle + 1) : UINT64_MAX;
 
+   uint8_t load_level = load_profiler_t::SQ_LEVEL;   // -L: where the load was served from
    if (inst->is_load) {
      
       latency = exec_cycle; // record start of execution
@@ -511,25 +647,34 @@ void uarchsim_t::step(db_t *inst)
       // AGEN takes 1 cycle.
       exec_cycle = (exec_cycle + 1);
 
-      // Train the prefetcher when the load finds out its outcome in the L1D
-      if (PREFETCHER_ENABLE)
-      {
-         // Generate prefetches ahead of time as in "Effective Hardware-Based Data Prefetching for High-Performance Processors"
-         // Instruction PC will be 4B aligned.
+      // Generate prefetches ahead of time as in "Effective Hardware-Based Data Prefetching for High-Performance Processors"
+      // Instruction PC will be 4B aligned.
+      if (C::prefetcher())
          prefetcher.lookahead((inst->pc >> 2), fetch_cycle);
 
-         // Train the prefetcher 
-         const bool hit = L1.is_hit(exec_cycle, inst->addr);
-         PrefetchTrainingInfo info{inst->pc >> 2, inst->addr, 0, hit};
-         prefetcher.train(info);
-      }
-
-      // Search D$ using AGEN's cycle.
+      // Search D$ using AGEN's cycle. The same lookup tells whether the load hit in the L1D.
       uint64_t data_cache_cycle;
-      if (PERFECT_CACHE)
+      bool hit;
+      uint8_t cache_level = 0;
+      if (C::perfect_cache())
+      {
          data_cache_cycle = exec_cycle + L1_LATENCY;
+         hit = C::prefetcher() && l1->is_hit(exec_cycle, inst->addr);
+      }
       else
-         data_cache_cycle = L1.access(exec_cycle, true/*read*/, inst->addr);
+      {
+         const cache_access_t dc = l1->lookup(exec_cycle, true/*read*/, inst->addr);
+         data_cache_cycle = dc.avail;
+         hit = dc.hit;
+         cache_level = dc.level;
+      }
+
+      // Train the prefetcher when the load finds out its outcome in the L1D
+      if (C::prefetcher())
+      {
+         PrefetchTrainingInfo info{inst->pc >> 2, inst->addr, 0, hit};
+         prefetcher.train(info);
+      }
 
       // Search of SQ takes 1 cycle after AGEN cycle.
       exec_cycle = (exec_cycle + 1);
@@ -550,6 +695,8 @@ void uarchsim_t::step(db_t *inst)
 
       num_load++;                   // stat
       num_load_sqmiss += (inc_sqmiss ? 1 : 0);      // stat
+      if (inc_sqmiss)
+         load_level = 1 + cache_level;
 
       assert(temp_cycle >= exec_cycle);
       exec_cycle = temp_cycle;
@@ -570,47 +717,37 @@ void uarchsim_t::step(db_t *inst)
       exec_cycle += latency;
    }
 
+   if (loadprof.enabled())
+      loadprof.step(inst, load_level, latency);
+
    activity_observed = true;
 
    // Drain prefetches from PF Queue
    // The idea is that a prefetch can go only if there is a free LDST slot "this" cycle
    // Here, "this" means all the cycles between the previous fetch cycle and the current one since all fetched ld/st will have been
    // scheduled and prefetch can correctly "steal" ld/st slots.
-   if(PREFETCHER_ENABLE)
+   if(C::prefetcher())
    {
-      uint64_t tmp_previous_fetch_cycle;
       Prefetch p;
-      bool issued;
       while(prefetcher.issue(p, fetch_cycle))
       {
-         tmp_previous_fetch_cycle = MAX(previous_fetch_cycle, p.cycle_generated);
-         issued = false;
-         while(tmp_previous_fetch_cycle <= fetch_cycle)
-         {
-            spdlog::debug("Issuing prefetch:{}", p);
-            uint64_t cycle_pf_exec = tmp_previous_fetch_cycle;
-
-            if(ldst_lanes) cycle_pf_exec = ldst_lanes->schedule(cycle_pf_exec, 0);
-
-            if(cycle_pf_exec != MAX_CYCLE)
-            {
-               L1.access(cycle_pf_exec, true, p.address, true);
-               ++stat_pfs_issued_to_mem;
-               issued = true;
-               break;
-            }
-            else
-            {
-               tmp_previous_fetch_cycle++;
-               spdlog::debug("Could not find empty LDST slot for PF this cycle, increasing");
-            }
-         }
-         
-         if(!issued)
+         // First free LDST slot between the later of the previous fetch cycle and the prefetch's
+         // generation, and the current fetch cycle; otherwise it waits for the next fetch cycle.
+         const uint64_t first_cycle = MAX(previous_fetch_cycle, p.cycle_generated);
+         uint64_t cycle_pf_exec = (first_cycle <= fetch_cycle) ? first_cycle : MAX_CYCLE;
+         if (ldst_lanes && (ldst_lanes->reserve(first_cycle, fetch_cycle, 1, &cycle_pf_exec) == 0))
+            cycle_pf_exec = MAX_CYCLE;
+
+         if(cycle_pf_exec == MAX_CYCLE)
          {
+            spdlog::debug("Could not find empty LDST slot for PF up to this cycle");
             prefetcher.put_back(p);
             break;
          }
+
+         spdlog::debug("Issuing prefetch:{}", p);
+         l1->access(cycle_pf_exec, true, p.address, true);
+         ++stat_pfs_issued_to_mem;
       }
    }
 
@@ -635,10 +772,10 @@ void uarchsim_t::step(db_t *inst)
    // Update SQ byte timestamps.
    if (inst->is_store) {
       uint64_t data_cache_cycle;
-      if (!WRITE_ALLOCATE || PERFECT_CACHE)
+      if (!C::write_allocate() || C::perfect_cache())
          data_cache_cycle = exec_cycle;
       else
-         data_cache_cycle = L1.access(exec_cycle, true, inst->addr);
+         data_cache_cycle = l1->access(exec_cycle, true, inst->addr);
 
       uint64_t ret_cycle = MAX(data_cache_cycle, (window.empty() ? 0 : window.back().retire_cycle));
       for (i = 0, addr = inst->addr; i < inst->size; i++, addr++) {
@@ -737,13 +874,13 @@ void uarchsim_t::step(db_t *inst)
        }
 
        // Indirect branch constraint.
-       if (FETCH_STOP_AT_INDIRECT && is_uncond_ind_br(inst->insn_class))
+       if (C::stop_at_indirect() && is_uncond_ind_br(inst->insn_class))
        {
            stop = true;
        }
 
        // Taken branch constraint.
-       if(FETCH_STOP_AT_TAKEN && inst->is_taken)
+       if(C::stop_at_taken() && inst->is_taken)
        {
            const bool taken_branch = (is_cond_br(inst->insn_class) && (inst->next_pc != (inst->pc + 4))) || is_uncond_br(inst->insn_class);
            if(!taken_branch)
@@ -766,7 +903,7 @@ void uarchsim_t::step(db_t *inst)
    // Account for the effect of a mispredicted branch on the fetch cycle.
    // TODO:: capture taken_target
    bool br_mispred = false;
-   if (!PERFECT_BRANCH_PRED && BP.predict(seq_no, piece, inst->insn_class, inst->pc, inst->next_pc, predict_cycle, fetch_cycle, exec_cycle))
+   if (!C::perfect_bp() && BP.predict(seq_no, piece, inst->insn_class, inst->pc, inst->next_pc, predict_cycle, fetch_cycle, exec_cycle))
    {
        br_mispred = true;
        // setting fetched/fetched_branch for the next cycle
@@ -798,13 +935,21 @@ void uarchsim_t::step(db_t *inst)
        window.back().update_pred_taken(predicted_taken);
    }
 
+   if (pipetrace.armed(predict_cycle, num_inst + !inst->is_last_piece))
+   {
+      const window_t& w = window.back();
+      pipetrace.record(pipetrace_uop_t{seq_no, inst->pc, num_inst + !inst->is_last_piece,
+                                       predict_cycle, decode_cycle, issue_cycle, exec_cycle, w.retire_cycle,
+                                       (br_mispred ? fetch_cycle : 0), piece, inst->insn_class, br_mispred});
+   }
+
    spdlog::debug("Updating base_cycle to {}", MIN(fetch_cycle, prefetcher.get_oldest_pf_cycle()));
 
    // Attempt to advance the base cycles of resource schedules.
    // Note : We may have some prefetches to issue still that are older than the fetch cycle.
    if (ldst_lanes) ldst_lanes->advance_base_cycle(MIN(fetch_cycle, prefetcher.get_oldest_pf_cycle()));
    if (alu_lanes) alu_lanes->advance_base_cycle(MIN(fetch_cycle, prefetcher.get_oldest_pf_cycle()));
-   const bool dump_activity = LOG_LEVEL != 0 && (fetch_cycle>= LOG_START_CYCLE) && (fetch_cycle<=LOG_END_CYCLE);
+   const bool dump_activity = C::activity() && (fetch_cycle>= LOG_START_CYCLE) && (fetch_cycle<=LOG_END_CYCLE);
    if(dump_activity && activity_observed)
    {
        std::cout<<activity_trace.str();
@@ -823,10 +968,132 @@ void uarchsim_t::step(db_t *inst)
    }
 
 }
+
+void uarchsim_t::step(db_t *inst)
+{
+   step_impl<runtime_step_config_t>(inst);
+}
+
+// The specializations select_step() in cbp.cc can pick.
+template void uarchsim_t::step_impl<fixed_step_config_t<false, false, false, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<false, false, true, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<false, true, false, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<false, true, true, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, false, false, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, false, true, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, true, false, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, true, true, true>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<false, false, false, false>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<false, false, true, false>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<false, true, false, false>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<false, true, true, false>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, false, false, false>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, false, true, false>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, true, false, false>>(db_t *inst);
+template void uarchsim_t::step_impl<fixed_step_config_t<true, true, true, false>>(db_t *inst);
 #endif
 
 
 
+// Functional warm-up: drive the caches, the prefetcher and the predictors through their
+// normal update paths in program order, one instruction per cycle, without the
+// window/lane/queue timing model. Every predictor hook is called back to back so no
+// instruction is left in flight when detailed simulation begins.
+void uarchsim_t::warmup(db_t *inst)
+{
+   PROFILE_SCOPE(Warmup);
+   PERF_PHASE(Step);
+   piece = (piece == UINT8_MAX) ? 0 : (piece + 1);
+   const uint64_t seq_no = num_uop;
+
+   if (FETCH_MODEL_ICACHE)
+      IC->fetch(fetch_cycle, inst->pc);
+
+   if (inst->is_load) {
+      if (PREFETCHER_ENABLE)
+         prefetcher.lookahead((inst->pc >> 2), fetch_cycle);
+      const bool hit = PERFECT_CACHE ? (PREFETCHER_ENABLE && L1->is_hit(fetch_cycle, inst->addr))
+                                     : L1->lookup(fetch_cycle, true/*read*/, inst->addr).hit;
+      if (PREFETCHER_ENABLE)
+      {
+         PrefetchTrainingInfo info{inst->pc >> 2, inst->addr, 0, hit};
+         prefetcher.train(info);
+      }
+   }
+   else if (inst->is_store && WRITE_ALLOCATE && !PERFECT_CACHE) {
+      L1->access(fetch_cycle, true, inst->addr);
+   }
+
+   if (PREFETCHER_ENABLE)
+   {
+      Prefetch p;
+      while (prefetcher.issue(p, fetch_cycle))
+         L1->access(fetch_cycle, true, p.address, true);
+   }
+
+   populate_exec_info(inst);
+   const uint64_t exec_cycle = fetch_cycle + 1;
+   notify_instr_fetch(seq_no, piece, inst->pc, fetch_cycle);
+   bool br_mispred = false;
+   if (!PERFECT_BRANCH_PRED)
+      br_mispred = BP.predict(seq_no, piece, inst->insn_class, inst->pc, inst->next_pc, fetch_cycle, fetch_cycle, exec_cycle);
+   bool pred_taken = false;
+   if (is_cond_br(inst->insn_class))
+      pred_taken = br_mispred ? !_current_execute_info.taken.value() : _current_execute_info.taken.value();
+   else if (is_br(inst->insn_class))
+      pred_taken = true;
+
+   notify_instr_decode(seq_no, piece, inst->pc, _current_execute_info.dec_info, fetch_cycle);
+   if (is_mem(inst->insn_class))
+      notify_agen_complete(seq_no, piece, inst->pc, _current_execute_info.dec_info, _current_execute_info.mem_va.value(), _current_execute_info.mem_sz.value(), exec_cycle);
+   notify_instr_execute_resolve(seq_no, piece, inst->pc, pred_taken, _current_execute_info, exec_cycle);
+   notify_instr_commit(seq_no, piece, inst->pc, pred_taken, _current_execute_info, exec_cycle);
+
+   num_uop += 1;
+   if (inst->is_last_piece)
+   {
+      piece = UINT8_MAX;
+      fetch_cycle++;
+   }
+}
+
+// Ends functional warm-up: all measurements restart from zero and detailed simulation
+// starts at cycle 0 with empty pipeline structures. num_uop is kept so that sequence
+// numbers handed to the predictor stay unique.
+void uarchsim_t::end_warmup()
+{
+   assert(window.empty() && DQ.empty() && AQ.empty() && EQ.empty());
+
+   IC->end_warmup();
+   L1->end_warmup();
+   L2->end_warmup();
+   L3->end_warmup();
+   prefetcher.end_warmup();
+   loadprof.end_warmup();
+
+   num_fetched = 0;
+   num_fetched_branch = 0;
+   fetch_cycle = 0;
+   previous_fetch_cycle = 0;
+   num_inst = 0;
+   cycle = 0;
+
+   BP.reset_measurements();
+   stats.reset_epochs();
+   num_insts_per_epoch.clear();
+   num_cycles_per_epoch.clear();
+   last_epoch_end_cycle = 0;
+   end_current_begin_new_epoch(true/*first_epoch*/, false/*last_epoch*/, 0/*epoch_end_cycle*/);
+
+   num_eligible = 0;
+   num_correct = 0;
+   num_incorrect = 0;
+   num_load = 0;
+   num_load_sqmiss = 0;
+   cycles_on_wrong_path = 0;
+   stat_pfs_issued_to_mem = 0;
+}
+
 #define KILOBYTE    (1<<10)
 #define MEGABYTE    (1<<20)
 #define SCALED_SIZE(size)   ((size/KILOBYTE >= KILOBYTE) ? (size/MEGABYTE) : (size/KILOBYTE))
@@ -837,8 +1104,16 @@ uint64_t uarchsim_t::get_current_fetch_cycle() const {
     return fetch_cycle;
 }
 
+sim_progress_t uarchsim_t::progress() const
+{
+   return sim_progress_t{num_inst, cycle, BP.num_cond_mispredicts()};
+}
+
 void uarchsim_t::output() 
 {
+   PROFILE_SCOPE(Output);
+   PERF_PHASE(Output);
+   pipetrace.finish();
    end_current_begin_new_epoch(false/*first_epoch*/, true/*last_epoch*/, cycle);
    //auto get_track_name = [] (uint64_t track){
    //   static std::string track_names [] = {
@@ -863,6 +1138,8 @@ void uarchsim_t::output()
    printf("PIPELINE_FILL_LATENCY = %lu\n", PIPELINE_FILL_LATENCY);
    printf("NUM_LDST_LANES = %lu%s", NUM_LDST_LANES, ((NUM_LDST_LANES > 0) ? "\n" : " (unbounded)\n"));
    printf("NUM_ALU_LANES = %lu%s", NUM_ALU_LANES, ((NUM_ALU_LANES > 0) ? "\n" : " (unbounded)\n"));
+   if (WARMUP_INSTS > 0)
+      printf("WARMUP_INSTS = %lu (functional warm-up, all measurements below reset when it ends)\n", WARMUP_INSTS);
    //BP.output();
    printf("MEMORY HIERARCHY CONFIGURATION---------------------\n");
    printf("STRIDE Prefetcher = %s\n", PREFETCHER_ENABLE ? "1" : "0");
@@ -894,12 +1171,20 @@ void uarchsim_t::output()
    printf("---------------------------------------------------------------------------------------------------------------------------------------\n");
    printf("------------------------MEMORY HIERARCHY MEASUREMENTS (Full Simulation i.e. Counts Not Reset When Warmup Ends)-------------------------\n");
    if (FETCH_MODEL_ICACHE) {
-      printf("I$:\n"); IC.stats();
+      printf("I$:\n"); IC->stats(); IC->filter_stats();
    }
-   printf("L1$:\n"); L1.stats();
-   printf("L2$:\n"); L2.stats();
-   printf("L3$:\n"); L3.stats();
+   printf("L1$:\n"); L1->stats();
+   printf("L2$:\n"); L2->stats();
+   if (L2_SAMPLE_BITS)
+      L2->sampling_stats();
+   printf("L3$:\n"); L3->stats();
+   if (L3_SAMPLE_BITS)
+      L3->sampling_stats();
    printf("---------------------------------------------------------------------------------------------------------------------------------------\n");
+   if (loadprof.enabled()) {
+      loadprof.output(files.prefix);
+      printf("---------------------------------------------------------------------------------------------------------------------------------------\n");
+   }
    printf("----------------------------------------------Prefetcher (Full Simulation i.e. No Warmup)----------------------------------------------\n");
    prefetcher.print_stats();
    printf("---------------------------------------------------------------------------------------------------------------------------------------\n");
@@ -912,4 +1197,9 @@ void uarchsim_t::output()
    // Branch Prediction Measurements
    BP.output(num_inst);
    BP.output_periodic_info(num_insts_per_epoch, num_cycles_per_epoch);
+
+   if (STATS_JSON || STATS_CSV)
+      stats.dump(files.prefix);
+
+   memstats.report();
 }
@@ -24,11 +24,20 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <unordered_map>
 #include <list>
+#include <sstream>
+#include <type_traits>
 #include "spdlog/spdlog.h"
 #include "spdlog/fmt/ostr.h"
 //#include "cbp.h"
 #include "value_predictor_interface.h"
 #include "stride_prefetcher.h"
+#include "checkpoint.h"
+#include "stats.h"
+#include "heartbeat.h"
+#include "pipetrace.h"
+#include "memstats.h"
+#include "loadprof.h"
+#include "parameters.h"
 using namespace std;
 
 #ifndef _RISCV_UARCHSIM_H
@@ -102,11 +111,98 @@ struct window_t {
        os<<"}";
        return os;
    }
+
+   void checkpoint(ckpt_t& c)
+   {
+      c.io(seq_no);
+      c.io(piece);
+      c.io(PC);
+      c.io(fetch_cycle);
+      c.io(decode_cycle);
+      c.io(exec_cycle);
+      c.io(exec_info);
+      c.io(retire_cycle);
+      c.io(pred_taken);
+      c.io(addr);
+      c.io(value);
+      c.io(latency);
+   }
 };
 
 struct store_queue_t {
    uint64_t exec_cycle; // store's execution cycle
    uint64_t ret_cycle;  // store's commit cycle
+
+   void checkpoint(ckpt_t& c)
+   {
+      c.io(exec_cycle);
+      c.io(ret_cycle);
+   }
+};
+
+// Builds the decode/execute information passed to the predictor hooks from a trace record.
+void populate_decode_info(const db_t *inst, DecodeInfo& decode_info);
+void populate_exec_info(const db_t *inst, ExecuteInfo& exec_info);
+
+// Configuration policies for uarchsim_t::step_impl<>().
+//
+// runtime_step_config_t reads the parameters on every micro-op, as step() always did.
+// fixed_step_config_t bakes in one of the combinations we run (the defaults, with or
+// without the I-cache model, the prefetcher and a perfect D$) as compile-time constants,
+// so those branches and the activity-trace formatting fold away. With LRU at every cache
+// level (the default) the I$ and D$ are also accessed through cache_t<lru_repl_t>,
+// without virtual calls; other replacement policies go through cache_base_t. select_step() in cbp.cc
+// picks a fixed specialization when matches(), and step() otherwise.
+
+// Stand-in for the activity-trace stream when it is compiled out.
+struct null_activity_stream_t {
+   template <typename T>
+   null_activity_stream_t& operator<<(const T&) { return *this; }
+   const char *str() const { return ""; }
+};
+
+struct runtime_step_config_t {
+   typedef std::ostringstream activity_stream_t;
+   typedef cache_base_t cache_type;
+   static bool icache() { return FETCH_MODEL_ICACHE; }
+   static bool vp() { return VP_ENABLE; }
+   static bool vp_perfect() { return VP_PERFECT; }
+   static bool prefetcher() { return PREFETCHER_ENABLE; }
+   static bool perfect_cache() { return PERFECT_CACHE; }
+   static bool write_allocate() { return WRITE_ALLOCATE; }
+   static bool perfect_bp() { return PERFECT_BRANCH_PRED; }
+   static bool stop_at_indirect() { return FETCH_STOP_AT_INDIRECT; }
+   static bool stop_at_taken() { return FETCH_STOP_AT_TAKEN; }
+   static bool activity() { return LOG_LEVEL != 0; }
+};
+
+template <bool ICache, bool Prefetcher, bool PerfectCache, bool LRU>
+struct fixed_step_config_t {
+   typedef null_activity_stream_t activity_stream_t;
+   typedef std::conditional_t<LRU, cache_t<lru_repl_t>, cache_base_t> cache_type;
+   static constexpr bool icache() { return ICache; }
+   static constexpr bool vp() { return false; }
+   static constexpr bool vp_perfect() { return false; }
+   static constexpr bool prefetcher() { return Prefetcher; }
+   static constexpr bool perfect_cache() { return PerfectCache; }
+   static constexpr bool write_allocate() { return true; }
+   static constexpr bool perfect_bp() { return false; }
+   static constexpr bool stop_at_indirect() { return true; }
+   static constexpr bool stop_at_taken() { return true; }
+   static constexpr bool activity() { return false; }
+
+   static bool matches()
+   {
+      return (FETCH_MODEL_ICACHE == ICache) && (PREFETCHER_ENABLE == Prefetcher) && (PERFECT_CACHE == PerfectCache)
+          && !VP_ENABLE && WRITE_ALLOCATE && !PERFECT_BRANCH_PRED && FETCH_STOP_AT_INDIRECT && FETCH_STOP_AT_TAKEN
+          && (LOG_LEVEL == 0) && (all_lru() == LRU);
+   }
+
+   static bool all_lru()
+   {
+      return (IC_REPL == repl_policy_t::LRU) && (L1_REPL == repl_policy_t::LRU) && (L2_REPL == repl_policy_t::LRU)
+          && (L3_REPL == repl_policy_t::LRU);
+   }
 };
 
 // Class for a microarchitectural simulator.
@@ -135,9 +231,9 @@ class uarchsim_t {
       std::list<std::tuple<uint64_t/*seq_no*/, uint8_t/*piece*/, uint64_t/*exec_cycle*/>> EQ;
 
       // memory block timestamps
-      cache_t L3;
-      cache_t L2;
-      cache_t L1;
+      cache_base_t *L3;
+      cache_base_t *L2;
+      cache_base_t *L1;
 
       // fetch timestamp
       uint64_t fetch_cycle;
@@ -147,7 +243,7 @@ class uarchsim_t {
       bp_t BP;
 
       // Instruction cache.
-      cache_t IC;
+      cache_base_t *IC;
 
       //Prefetcher
       StridePrefetcher prefetcher;
@@ -173,6 +269,21 @@ class uarchsim_t {
 
       uint64_t stat_pfs_issued_to_mem = 0;
 
+      // Machine-readable measurements (-S).
+      stats_t stats;
+
+      // Pipeline timeline (-T).
+      pipetrace_t pipetrace;
+
+      // Memory report (-m).
+      memstats_t memstats;
+
+      // Per-PC load profile (-L).
+      load_profiler_t loadprof;
+
+      // Piece of the current instruction being stepped (UINT8_MAX between instructions).
+      uint8_t piece;
+
       // Helper for oracle hit/miss information
       uint64_t get_load_exec_cycle(db_t *inst) const;
 
@@ -189,12 +300,18 @@ class uarchsim_t {
 
       //void set_funcsim(processor_t *funcsim);
       void step(db_t *inst);
-      void eval_decode(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
-      void eval_aq(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
-      void eval_exec(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
-      void eval_retire(std::ostream& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
+      template <class C> void step_impl(db_t *inst);
+      void warmup(db_t *inst);
+      void end_warmup();
+      template <class C> void eval_decode(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
+      template <class C> void eval_aq(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
+      template <class C> void eval_exec(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
+      template <class C> void eval_retire(typename C::activity_stream_t& activity_trace, bool& activity_observed, const uint64_t current_fetch_cycle) ;
       void output();
+      void checkpoint(ckpt_t& c);
       uint64_t get_current_fetch_cycle() const;
+      sim_progress_t progress() const;
+      memstats_t& memory() { return memstats; }
       PredictionRequest get_value_prediction_req_for_track(uint64_t cycle, uint64_t seq_no, uint8_t piece, db_t *inst);
 };
 
@@ -2,6 +2,8 @@
 #define _PREDICTOR_H_
 
 #include <stdlib.h>
+#include "lib/checkpoint.h"
+#include "lib/memstats.h"
 
 struct SampleHist
 {
@@ -12,6 +14,12 @@ struct SampleHist
       {
           ghist = 0;
       }
+
+      void checkpoint(ckpt_t& c)
+      {
+          c.io(ghist);
+          c.io(tage_pred);
+      }
 };
 
 
@@ -33,6 +41,18 @@ class SampleCondPredictor
         {
         }
 
+        void checkpoint(ckpt_t& c)
+        {
+            c.io(active_hist);
+            c.io(pred_time_histories);
+        }
+
+        // Checkpointed histories of the branches in flight, for the memory report (-m).
+        mem_usage_t memory() const
+        {
+            return mem_usage(pred_time_histories);
+        }
+
         // sample function to get unique instruction id
         uint64_t get_unique_inst_id(uint64_t seq_no, uint8_t piece) const
         {
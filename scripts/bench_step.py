@@ -0,0 +1,64 @@
+import os
+import re
+import sys
+import glob
+import time
+import shutil
+import tempfile
+import subprocess
+import argparse
+from pathlib import Path
+
+# Times the generic step() (-g) against the one specialized for the configuration and
+# checks that both produce the same result log. Runs execute in a scratch directory.
+#
+#   python scripts/bench_step.py --cbp ./cbp --trace sample_traces/int/sample_int_trace.gz [--reps 3] [-- <extra cbp flags>]
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--cbp', help='path to the cbp binary', default='./cbp')
+parser.add_argument('--trace', help='path to a .gz trace', required= True)
+parser.add_argument('--reps', help='runs per variant (best time is reported)', type=int, default=3)
+parser.add_argument('flags', nargs=argparse.REMAINDER, help='extra cbp flags (after --)')
+
+args = parser.parse_args()
+cbp = Path(args.cbp).resolve()
+trace = Path(args.trace).resolve()
+flags = [f for f in args.flags if f != '--']
+
+read_line = re.compile(r'^ Read (\d+) instrs')
+
+def run(work_dir, extra):
+    cmd = [str(cbp)] + flags + extra + [str(trace)]
+    start = time.perf_counter()
+    subprocess.run(cmd, cwd=work_dir, check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    elapsed = time.perf_counter() - start
+    logs = glob.glob(os.path.join(work_dir, 'output', '*', trace.name[:-3], trace.name[:-3] + '_result.log'))
+    assert len(logs) == 1, f'expected one result log, found {logs}'
+    with open(logs[0]) as f:
+        return elapsed, f.read().splitlines()
+
+work_dir = tempfile.mkdtemp(prefix='cbp_bench_')
+results = {}
+for name, extra in (('generic', ['-g']), ('specialized', [])):
+    times = []
+    for _ in range(args.reps):
+        elapsed, log = run(work_dir, extra)
+        times.append(elapsed)
+    results[name] = (min(times), log)
+shutil.rmtree(work_dir)
+
+instrs = 0
+for l in results['generic'][1]:
+    m = read_line.match(l)
+    if m:
+        instrs = int(m.group(1))
+
+for name, (best, _) in results.items():
+    kips = f'{instrs / best / 1000:.1f} KIPS' if instrs else ''
+    print(f'{name:12s} {best:8.2f} s  {kips}')
+print(f'speed-up     {results["generic"][0] / results["specialized"][0]:8.2f}x')
+
+if results['generic'][1] != results['specialized'][1]:
+    print('FAIL: result logs differ')
+    sys.exit(1)
+print('PASS: identical result logs')
@@ -0,0 +1,65 @@
+import os
+import re
+import sys
+import glob
+import shutil
+import tempfile
+import subprocess
+import argparse
+from pathlib import Path
+
+# Checks that a run resumed from a checkpoint produces the same result log as an
+# uninterrupted run. Both runs execute in a scratch directory so the output/ tree
+# of the caller is left alone.
+#
+#   python scripts/verify_checkpoint.py --cbp ./cbp --trace sample_traces/int/sample_int_trace.gz --at 1000000 [-- <extra cbp flags>]
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--cbp', help='path to the cbp binary', default='./cbp')
+parser.add_argument('--trace', help='path to a .gz trace', required= True)
+parser.add_argument('--at', help='instruction count at which the checkpoint is taken', type=int, required= True)
+parser.add_argument('--keep', help='keep the scratch directory', action='store_true')
+parser.add_argument('flags', nargs=argparse.REMAINDER, help='extra cbp flags (after --)')
+
+args = parser.parse_args()
+cbp = Path(args.cbp).resolve()
+trace = Path(args.trace).resolve()
+flags = [f for f in args.flags if f != '--']
+
+# TraceReader progress lines depend on where reading started, not on simulation state.
+progress_line = re.compile(r'^\d+ instrs\s*$')
+
+def run(work_dir, tag, extra):
+    cmd = [str(cbp)] + flags + extra + [str(trace)]
+    print(f'Running {tag}: {" ".join(cmd)}')
+    subprocess.run(cmd, cwd=work_dir, check=True, stdout=subprocess.DEVNULL)
+    logs = glob.glob(os.path.join(work_dir, 'output', '*', trace.name[:-3], trace.name[:-3] + '_result.log'))
+    assert len(logs) == 1, f'expected one result log, found {logs}'
+    dst = os.path.join(work_dir, f'{tag}_result.log')
+    shutil.move(logs[0], dst)
+    with open(dst) as f:
+        return [l for l in f.read().splitlines() if not progress_line.match(l)]
+
+work_dir = tempfile.mkdtemp(prefix='cbp_ckpt_')
+ckpt_file = os.path.join(work_dir, 'sim.ckpt')
+
+full = run(work_dir, 'uninterrupted', ['-C', f'{args.at},{ckpt_file}'])
+resumed = run(work_dir, 'resumed', ['-R', ckpt_file])
+
+if full == resumed:
+    print(f'PASS: resumed run matches uninterrupted run ({len(full)} lines compared)')
+    status = 0
+else:
+    for i, (a, b) in enumerate(zip(full, resumed)):
+        if a != b:
+            print(f'FAIL: first difference at line {i + 1}:\n  uninterrupted: {a}\n  resumed:       {b}')
+            break
+    else:
+        print(f'FAIL: logs differ in length ({len(full)} vs {len(resumed)} lines)')
+    status = 1
+
+if args.keep or status:
+    print(f'Logs and checkpoint kept in {work_dir}')
+else:
+    shutil.rmtree(work_dir)
+sys.exit(status)
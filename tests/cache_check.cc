@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <vector>
+#include "cache.h"
+#include "mrc.h"
+#include "parameters.h"
+
+// Randomized checks of the cache models against plain reference models, run by make test
+// before the golden-stats cases (which only cover the configured geometries).
+//
+//   lru   cache_t<lru_repl_t> (packed recency order up to 16 ways, per-way ranks above)
+//         against a cache that keeps an LRU rank counter per way, over an L1/L2 pair:
+//         1-16, 20, 24 and 32 ways, 1, 4 and 64 sets, demand and prefetch lookups and
+//         is_hit() probes, with fills still in flight. Every result (avail, level, hit),
+//         every probe and the final accesses/misses counts must be identical.
+//   mrc   stack_distance_t (-K) against one cache_t<lru_repl_t> per geometry it profiles,
+//         1 KB to 64 KB, 1-16 ways and fully associative: the misses it reports must be
+//         those of the cache, exactly. With 2^-2 sampling the set-associative curves must
+//         still be exact (the fully associative one is an estimate).
+
+// xorshift64, so the streams are the same on every host.
+struct rng_t {
+   uint64_t state;
+   uint64_t next()
+   {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      return state;
+   }
+};
+
+static uint64_t failures = 0;
+
+static void check(bool ok, const char *what, uint64_t n, uint64_t expected, uint64_t got)
+{
+   if (ok)
+      return;
+   if (failures < 10)
+      fprintf(stderr, "cache_check: %s at access %lu: reference %lu, got %lu\n", what, n, expected, got);
+   failures++;
+}
+
+// A cache level with true LRU kept as a rank per way (0: MRU, assoc - 1: LRU, way j starts
+// at rank j), the way the simulator's caches worked before the packed order.
+class ref_lru_cache_t {
+public:
+   ref_lru_cache_t(uint64_t num_sets, uint64_t assoc, uint64_t blocksize, uint64_t latency, ref_lru_cache_t *next)
+      : num_sets(num_sets), assoc(assoc), blocksize(blocksize), latency(latency), next(next)
+      , valid(num_sets * assoc, false), tags(num_sets * assoc, 0), timestamps(num_sets * assoc, 0)
+      , rank(num_sets * assoc), accesses(0), misses(0), pf_accesses(0), pf_misses(0)
+   {
+      for (uint64_t i = 0; i < num_sets * assoc; i++)
+         rank[i] = i % assoc;
+   }
+
+   cache_access_t lookup(uint64_t cycle, uint64_t addr, bool pf)
+   {
+      const uint64_t block = addr / blocksize;
+      const uint64_t set = block % num_sets;
+      const uint64_t base = set * assoc;
+      accesses += !pf;
+      pf_accesses += pf;
+      for (uint64_t w = 0; w < assoc; w++) {
+         if (valid[base + w] && (tags[base + w] == block)) {
+            const uint64_t avail = std::max(timestamps[base + w], cycle + latency);
+            touch(base, w);
+            return {avail, 0, avail == cycle + latency};
+         }
+      }
+      misses += !pf;
+      pf_misses += pf;
+
+      uint64_t victim = 0;
+      while (rank[base + victim] != assoc - 1)
+         victim++;
+      cache_access_t below = {cycle + latency + MAIN_MEMORY_LATENCY, 0, false};
+      if (next)
+         below = next->lookup(cycle + latency, addr, pf);
+      valid[base + victim] = true;
+      tags[base + victim] = block;
+      timestamps[base + victim] = below.avail;
+      touch(base, victim);
+      return {below.avail, below.level + 1, false};
+   }
+
+   bool is_hit(uint64_t cycle, uint64_t addr) const
+   {
+      const uint64_t block = addr / blocksize;
+      const uint64_t base = (block % num_sets) * assoc;
+      for (uint64_t w = 0; w < assoc; w++)
+         if (valid[base + w] && (tags[base + w] == block))
+            return timestamps[base + w] <= cycle + latency;
+      return false;
+   }
+
+   uint64_t num_sets, assoc, blocksize, latency;
+   ref_lru_cache_t *next;
+   std::vector<bool> valid;
+   std::vector<uint64_t> tags;
+   std::vector<uint64_t> timestamps;
+   std::vector<uint64_t> rank;
+   uint64_t accesses, misses, pf_accesses, pf_misses;
+
+private:
+   void touch(uint64_t base, uint64_t way)
+   {
+      for (uint64_t w = 0; w < assoc; w++)
+         rank[base + w] += (rank[base + w] < rank[base + way]);
+      rank[base + way] = 0;
+   }
+};
+
+// The counters are protected; a pointer to member taken in a derived class reads them
+// from any cache_base_t.
+struct cache_counts_t : public cache_base_t {
+   static std::vector<uint64_t> of(const cache_base_t *c)
+   {
+      return {c->*&cache_counts_t::accesses, c->*&cache_counts_t::misses,
+              c->*&cache_counts_t::pf_accesses, c->*&cache_counts_t::pf_misses};
+   }
+};
+
+static void check_counts(const char *level, uint64_t n, const ref_lru_cache_t& ref, const cache_base_t *c)
+{
+   static const char *names[] = {"accesses", "misses", "pf accesses", "pf misses"};
+   const std::vector<uint64_t> expected = {ref.accesses, ref.misses, ref.pf_accesses, ref.pf_misses};
+   const std::vector<uint64_t> got = cache_counts_t::of(c);
+   for (uint64_t i = 0; i < expected.size(); i++) {
+      char what[64];
+      snprintf(what, sizeof(what), "%s %s", level, names[i]);
+      check(expected[i] == got[i], what, n, expected[i], got[i]);
+   }
+}
+
+static void check_lru()
+{
+   const uint64_t BLOCKSIZE = 64;
+   const uint64_t ACCESSES = 60000;
+   std::vector<uint64_t> assocs;
+   for (uint64_t a = 1; a <= 16; a++)
+      assocs.push_back(a);
+   for (uint64_t a : {20, 24, 32})
+      assocs.push_back(a);
+
+   uint64_t geometries = 0, total = 0;
+   for (uint64_t assoc : assocs) {
+      for (uint64_t sets : {1, 4, 64}) {
+         // L2: 4x the sets, 8 ways, so that it misses too.
+         ref_lru_cache_t ref_l2(4 * sets, 8, BLOCKSIZE, 10, NULL);
+         ref_lru_cache_t ref_l1(sets, assoc, BLOCKSIZE, 3, &ref_l2);
+         cache_base_t *l2 = new_cache(repl_policy_t::LRU, 4 * sets * 8 * BLOCKSIZE, 8, BLOCKSIZE, 10, NULL);
+         cache_base_t *l1 = new_cache(repl_policy_t::LRU, sets * assoc * BLOCKSIZE, assoc, BLOCKSIZE, 3, l2);
+
+         rng_t rng{0x9e3779b97f4a7c15lu ^ (assoc * 131 + sets)};
+         const uint64_t footprint = 3 * sets * assoc * BLOCKSIZE;   // reuse within 3x the L1
+         uint64_t cycle = 0;
+         for (uint64_t n = 0; n < ACCESSES; n++) {
+            const uint64_t r = rng.next();
+            const uint64_t addr = ((r & 3) == 0) ? (rng.next() % (16 * footprint)) : ((r >> 8) % footprint);
+            if ((r >> 58) < 8) {
+               const bool expected = ref_l1.is_hit(cycle, addr);
+               const bool got = l1->is_hit(cycle, addr);
+               check(expected == got, "is_hit", n, expected, got);
+            }
+            const bool pf = ((r >> 56) & 3) == 0;
+            const cache_access_t expected = ref_l1.lookup(cycle, addr, pf);
+            const cache_access_t got = l1->lookup(cycle, true, addr, pf);
+            check(expected.avail == got.avail, "avail", n, expected.avail, got.avail);
+            check(expected.level == got.level, "level", n, expected.level, got.level);
+            check(expected.hit == got.hit, "hit", n, expected.hit, got.hit);
+            cycle += (r >> 40) & 3;   // often less than a miss, so fills are still in flight
+         }
+         check_counts("L1", ACCESSES, ref_l1, l1);
+         check_counts("L2", ACCESSES, ref_l2, l2);
+         delete l1;
+         delete l2;
+         geometries++;
+         total += ACCESSES;
+      }
+   }
+   printf("lru: %lu geometries, %lu accesses against the rank-counter model\n", geometries, total);
+}
+
+static void check_mrc()
+{
+   const uint64_t BLOCKSIZE = 64, LOG2_MIN = 10, LOG2_MAX = 16;
+   const uint64_t REFERENCES = 120000;
+
+   uint64_t geometries = 0;
+   for (uint64_t trial = 0; trial < 3; trial++) {
+      for (uint64_t log2_sampling : {0, 2}) {
+         stack_distance_t sd("mrc", BLOCKSIZE, LOG2_MIN, LOG2_MAX, log2_sampling);
+         std::vector<uint64_t> sizes, assocs;   // assoc 0: fully associative
+         std::vector<cache_base_t *> caches;
+         for (uint64_t b = LOG2_MIN; b <= LOG2_MAX; b++) {
+            for (uint64_t a = 0; a <= stack_distance_t::MAX_ASSOC; a = a ? (2 * a) : 1) {
+               if ((sd.miss_ratio(1lu << b, a) < 0) || (log2_sampling && !a))
+                  continue;
+               sizes.push_back(1lu << b);
+               assocs.push_back(a);
+               caches.push_back(new_cache(repl_policy_t::LRU, 1lu << b, a ? a : ((1lu << b) / BLOCKSIZE), BLOCKSIZE, 1, NULL));
+            }
+         }
+
+         // A hot set of 50-850 blocks, a colder one of 20000, a strided scan and repeats.
+         rng_t rng{0x2545f4914f6cdd1dlu + trial};
+         const uint64_t hot = 50 + 400 * trial;
+         std::vector<uint64_t> misses(caches.size(), 0);
+         for (uint64_t n = 0; n < REFERENCES; n++) {
+            const uint64_t r = rng.next() % 100;
+            const uint64_t block = (r < 60) ? (rng.next() % hot) : ((r < 90) ? (rng.next() % 20000) : (3 * (n / 4)));
+            const uint64_t addr = (block * BLOCKSIZE) + (rng.next() % BLOCKSIZE) + (trial << 40);
+            for (uint64_t k = 0, repeats = ((rng.next() & 3) == 0) ? 2 : 1; k < repeats; k++) {
+               sd.access(addr);
+               for (uint64_t c = 0; c < caches.size(); c++)
+                  misses[c] += (caches[c]->lookup(0, true, addr).level != 0);
+            }
+         }
+
+         for (uint64_t c = 0; c < caches.size(); c++) {
+            const uint64_t expected = misses[c];
+            const uint64_t got = (uint64_t)(sd.miss_ratio(sizes[c], assocs[c]) * (double)sd.get_references() + 0.5);
+            char what[64];
+            snprintf(what, sizeof(what), "mrc misses, %lu B %lu-way (sampling 2^-%lu)", sizes[c], assocs[c], log2_sampling);
+            check(expected == got, what, sd.get_references(), expected, got);
+            delete caches[c];
+         }
+         geometries += caches.size();
+      }
+   }
+   printf("mrc: %lu curve points against an LRU cache of each geometry\n", geometries);
+}
+
+int main()
+{
+   check_lru();
+   check_mrc();
+   if (failures) {
+      printf("cache_check: %lu mismatches\n", failures);
+      return 1;
+   }
+   printf("cache_check: all checks pass\n");
+   return 0;
+}
@@ -0,0 +1,87 @@
+import gzip
+import struct
+import random
+import argparse
+
+# Deterministic synthetic trace in the CBP2025 format (see lib/trace_reader.h), for the
+# golden-stats regression tests. The same (seed, instructions) always gives the same
+# instruction stream: strided and random loads, stores, FP and slow ALU ops, loop
+# branches with some noise, direct calls/returns and a three-target indirect jump.
+#
+#   python tests/gen_trace.py out_trace.gz --instructions 40000 --seed 1
+
+ALU, LD, ST, CB, UDB, UIB, FP, SLOW, UNDEF, CALLD, CALLI, RET = range(12)
+
+def generate(n, seed, noise):
+    r = random.Random(seed)
+    out = bytearray()
+
+    def emit(pc, typ, ea=None, size=8, taken=None, target=None, ins=(), outs=(), vals=()):
+        out.extend(struct.pack('<QB', pc, typ))
+        if typ in (LD, ST):
+            out.extend(struct.pack('<QBB', ea, size, 0))
+            if typ == ST:
+                out.extend(struct.pack('<B', 0))
+        if typ in (CB, UDB, UIB, CALLD, CALLI, RET):
+            out.extend(struct.pack('<B', 1 if taken else 0))
+            if taken:
+                out.extend(struct.pack('<Q', target))
+        out.extend(struct.pack('<B', len(ins)))
+        out.extend(bytes(ins))
+        out.extend(struct.pack('<B', len(outs)))
+        out.extend(bytes(outs))
+        for o, v in zip(outs, vals):
+            out.extend(struct.pack('<Q', v & (2**64 - 1)))
+            if 32 <= o < 64:
+                out.extend(struct.pack('<Q', 0))
+
+    count = 0
+    arrays = [0x10000000 + i * 0x100000 for i in range(8)]
+    it = 0
+    while count < n:
+        base = 0x400000 + (it % 7) * 0x1000
+        trip = r.choice([3, 8, 17, 64])
+        arr = arrays[it % 8]
+        stride = r.choice([8, 16, 64, 4096])
+        for k in range(trip):
+            pc = base
+            emit(pc, LD, ea=arr + k * stride, ins=(1,), outs=(2,), vals=(k * 3,)); pc += 4
+            emit(pc, ALU, ins=(2, 3), outs=(3,), vals=(k,)); pc += 4
+            emit(pc, FP, ins=(33,), outs=(34,), vals=(k,)); pc += 4
+            if r.random() < 0.3:
+                emit(pc, LD, ea=0x20000000 + r.randrange(1 << 22) * 8, ins=(4,), outs=(5,), vals=(r.randrange(100),)); pc += 4
+                count += 1
+            emit(pc, ALU, ins=(2,), outs=(64,), vals=(k & 1,)); pc += 4
+            t = (k % 3 == 0) or (r.random() < noise)
+            emit(pc, CB, taken=t, target=pc + 16, ins=(64,))
+            pc = pc + 16 if t else pc + 4
+            emit(pc, ST, ea=arr + 0x80000 + k * 8, ins=(1, 3)); pc += 4
+            emit(pc, SLOW, ins=(3, 2), outs=(6,), vals=(k * k,)); pc += 4
+            if k % 5 == 4:
+                emit(pc, CALLD, taken=True, target=0x500000, outs=(30,), vals=(pc + 4,))
+                ret = pc + 4
+                emit(0x500000, ALU, ins=(6,), outs=(7,), vals=(1,))
+                emit(0x500004, RET, taken=True, target=ret, ins=(30,))
+                pc = ret
+                count += 3
+            if k % 11 == 10:
+                tgt = 0x600000 + r.choice([0, 0x40, 0x80])
+                emit(pc, UIB, taken=True, target=tgt, ins=(8,))
+                emit(tgt, UDB, taken=True, target=pc + 4)
+                pc += 4
+                count += 2
+            emit(pc, CB, taken=(k != trip - 1), target=base, ins=(64,))
+            count += 8
+        it += 1
+    return bytes(out)
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('path', help='output .gz trace (name must end in _trace.gz for the result scripts)')
+    parser.add_argument('--instructions', type=int, default=40000)
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--noise', type=float, default=0.1, help='probability of a random taken inner branch')
+    args = parser.parse_args()
+    # mtime=0: regenerating a trace under the same name gives the same file.
+    with gzip.GzipFile(args.path, 'wb', mtime=0) as f:
+        f.write(generate(args.instructions, args.seed, args.noise))
@@ -0,0 +1,220 @@
+import os
+import re
+import sys
+import glob
+import json
+import time
+import shutil
+import tempfile
+import argparse
+import subprocess
+from pathlib import Path
+from multiprocessing import Pool
+
+# Golden-stats regression test: runs cbp on short synthetic traces (tests/gen_trace.py)
+# under several configurations and compares every counter, ratio and summary of the
+# -S json output, its per-epoch (-E) series and the result log against tests/golden/.
+# Refactors of the timing model, caches or predictors must leave all of them bit-exact.
+#
+#   make test                                        # check (python tests/golden_stats.py)
+#   make golden                                      # rewrite tests/golden/ after an intended change
+#   python tests/golden_stats.py --throughput [--baseline-cbp old/cbp]
+#                                                    # also time each case (best of --reps), and
+#                                                    # the baseline binary for a speed-up column
+
+TESTS_DIR = Path(__file__).resolve().parent
+GOLDEN_DIR = TESTS_DIR / 'golden'
+
+# name: (seed, instructions, noise)
+TRACES = {
+    'loops':  (1, 40000, 0.10),
+    'noisy':  (2, 40000, 0.35),
+    'long':   (3, 120000, 0.05),
+}
+
+# name: flags. Every case also gets -S json; -E is part of the flags where the epoch series
+# is checked. 'generic' must match 'default' exactly and is compared against its golden.
+# The -K cases write no stats, only the result log and the files in CASE_FILES.
+CONFIGS = {
+    'default':    ['-E', '5000'],
+    'generic':    ['-g', '-E', '5000'],
+    'noicache':   ['-F', '16,16,1,1,0', '-E', '5000'],
+    'perfectd':   ['-d'],
+    'lanes':      ['-M', '2', '-A', '4', '-w', '256', '-E', '5000'],
+    'caches':     ['-D', '13,2,64,3,16,4,64,12,18,8,128,50,150', '-I', '12,2,64', '-E', '5000'],
+    'warmup':     ['-W', '10000', '-E', '5000'],
+    'predonly':   ['-O', '2,11'],
+    'sampled':    ['-X', '4,4', '-E', '5000'],
+    'loadprof':   ['-L', '16', '-E', '5000'],
+    'replmix':    ['-r', 'plru,srrip,brrip,random', '-E', '5000'],
+    'brripwarm':  ['-r', 'brrip', '-W', '10000', '-E', '5000'],
+    'mrc':        ['-K', '0'],
+    'mrc_sampled': ['-K', '2'],
+}
+GOLDEN_OF = {'generic': 'default'}
+
+# name: output file (suffix of the result log's prefix) also compared, as golden/<trace>__<name>.csv.
+CASE_FILES = {'mrc': '_mrc.csv', 'mrc_sampled': '_mrc.csv'}
+
+# Lines that name files in the caller's tree rather than report results.
+path_line = re.compile(r'log file: ')
+
+def trace_path(work_dir, name):
+    return Path(work_dir) / f'{name}_trace.gz'
+
+def run_case(job):
+    cbp, work_root, trace, config = job
+    work_dir = tempfile.mkdtemp(prefix=f'{trace}_{config}_', dir=work_root)
+    tpath = trace_path(work_root, trace)
+    cmd = [cbp] + CONFIGS[config] + ['-S', 'json', str(tpath)]
+    start = time.perf_counter()
+    proc = subprocess.run(cmd, cwd=work_dir, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    elapsed = time.perf_counter() - start
+    if proc.returncode != 0:
+        return trace, config, None, None, None, elapsed, f'exit code {proc.returncode}: {proc.stderr.strip()[-500:]}'
+    stem = tpath.name[:-3]
+    prefix = glob.glob(os.path.join(work_dir, 'output', '*', stem, stem + '_result.log'))[0][:-len('_result.log')]
+    stats = None
+    if os.path.exists(prefix + '_stats.json'):
+        with open(prefix + '_stats.json') as f:
+            stats = json.load(f)
+    with open(prefix + '_result.log') as f:
+        log = [l for l in f.read().splitlines() if not path_line.search(l)]
+    extra = None
+    if config in CASE_FILES:
+        with open(prefix + CASE_FILES[config]) as f:
+            extra = f.read().splitlines()
+    shutil.rmtree(work_dir)
+    return trace, config, stats, log, extra, elapsed, None
+
+def time_case(job):
+    cbp, work_root, trace, config, reps = job
+    best = None
+    for _ in range(reps):
+        result = run_case((cbp, work_root, trace, config))
+        if result[6]:
+            return None   # e.g. a baseline binary without this case's flags
+        best = result[5] if best is None else min(best, result[5])
+    return best
+
+def first_stats_diff(golden, got):
+    for key in sorted(set(golden['stats']) | set(got['stats'])):
+        a, b = golden['stats'].get(key, '<missing>'), got['stats'].get(key, '<missing>')
+        if a != b:
+            return f'stats.{key}: golden {a}, got {b}'
+    ge, ce = golden.get('epochs', []), got.get('epochs', [])
+    if len(ge) != len(ce):
+        return f'epochs: golden has {len(ge)}, got {len(ce)}'
+    for e, (a, b) in enumerate(zip(ge, ce)):
+        for key in sorted(set(a) | set(b)):
+            if a.get(key, '<missing>') != b.get(key, '<missing>'):
+                return f'epochs[{e}].{key}: golden {a.get(key, "<missing>")}, got {b.get(key, "<missing>")}'
+    return None
+
+def first_log_diff(golden, got, what='result log'):
+    for i, (a, b) in enumerate(zip(golden, got)):
+        if a != b:
+            return f'{what} line {i + 1}:\n      golden: {a}\n      got:    {b}'
+    if len(golden) != len(got):
+        return f'{what} has {len(got)} lines, golden {len(golden)}'
+    return None
+
+def instructions(stats, log):
+    if stats:
+        return stats['stats']['instructions']
+    return int(next(l for l in log if l.startswith('instructions = ')).split()[-1])
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--cbp', help='path to the cbp binary', default='./cbp')
+    parser.add_argument('--update', help='rewrite the golden files', action='store_true')
+    parser.add_argument('--throughput', help='also report per-case time and KIPS', action='store_true')
+    parser.add_argument('--baseline-cbp', help='with --throughput, time this binary too and report the speed-up')
+    parser.add_argument('--reps', help='runs per case for --throughput (best time is used)', type=int, default=3)
+    parser.add_argument('--jobs', type=int, default=os.cpu_count())
+    args = parser.parse_args()
+
+    cbp = str(Path(args.cbp).resolve())
+    work_root = tempfile.mkdtemp(prefix='cbp_golden_')
+    for name, (seed, n, noise) in TRACES.items():
+        subprocess.run([sys.executable, str(TESTS_DIR / 'gen_trace.py'), str(trace_path(work_root, name)),
+                        '--seed', str(seed), '--instructions', str(n), '--noise', str(noise)], check=True)
+
+    cases = [(t, c) for t in TRACES for c in CONFIGS if not (args.update and c in GOLDEN_OF)]
+    with Pool(args.jobs) as pool:
+        results = pool.map(run_case, [(cbp, work_root, t, c) for t, c in cases])
+
+    failures = 0
+    instrs = {}
+    for trace, config, stats, log, extra, elapsed, error in results:
+        case = f'{trace}/{config}'
+        if error:
+            print(f'FAIL {case}: {error}')
+            failures += 1
+            continue
+        instrs[(trace, config)] = instructions(stats, log)
+        golden = GOLDEN_DIR / f'{trace}__{GOLDEN_OF.get(config, config)}'
+        if args.update:
+            GOLDEN_DIR.mkdir(exist_ok=True)
+            if stats:
+                with open(str(golden) + '.json', 'w') as f:
+                    json.dump(stats, f, indent=1, sort_keys=True)
+                    f.write('\n')
+            with open(str(golden) + '.log', 'w') as f:
+                f.write('\n'.join(log) + '\n')
+            if extra is not None:
+                with open(str(golden) + '.csv', 'w') as f:
+                    f.write('\n'.join(extra) + '\n')
+            print(f'wrote {golden.name}')
+            continue
+        if not os.path.exists(str(golden) + ('.json' if stats else '.log')):
+            print(f'FAIL {case}: no golden output (run make golden)')
+            failures += 1
+            continue
+        diff = None
+        if stats:
+            with open(str(golden) + '.json') as f:
+                diff = first_stats_diff(json.load(f), stats)
+        if not diff:
+            with open(str(golden) + '.log') as f:
+                diff = first_log_diff(f.read().splitlines(), log)
+        if not diff and extra is not None:
+            with open(str(golden) + '.csv') as f:
+                diff = first_log_diff(f.read().splitlines(), extra, CASE_FILES[config])
+        if diff:
+            print(f'FAIL {case}: {diff}')
+            failures += 1
+        elif stats:
+            print(f'ok   {case} ({len(stats["stats"])} stats, {len(stats.get("epochs", []))} epochs)')
+        else:
+            print(f'ok   {case} ({len(extra or [])} {CASE_FILES.get(config, "")} lines)')
+
+    if args.throughput and not failures:
+        # Timed one case at a time so the runs do not compete for cores.
+        print(f'\n{"case":24s} {"time(s)":>9s} {"KIPS":>9s}' + (f' {"base(s)":>9s} {"speed-up":>9s}' if args.baseline_cbp else ''))
+        total = base_total = base_cases = 0.0
+        for trace, config in cases:
+            t = time_case((cbp, work_root, trace, config, args.reps))
+            total += t
+            line = f'{trace + "/" + config:24s} {t:9.3f} {instrs[(trace, config)] / t / 1000:9.1f}'
+            if args.baseline_cbp:
+                b = time_case((str(Path(args.baseline_cbp).resolve()), work_root, trace, config, args.reps))
+                if b is None:
+                    line += f' {"n/a":>9s}'
+                else:
+                    base_total += b
+                    base_cases += t
+                    line += f' {b:9.3f} {b / t:8.2f}x'
+            print(line)
+        line = f'{"total":24s} {total:9.3f} {sum(instrs[c] for c in cases) / total / 1000:9.1f}'
+        if args.baseline_cbp:
+            line += f' {base_total:9.3f} {base_total / base_cases:8.2f}x' if base_cases else f' {"n/a":>9s}'
+        print(line)
+
+    shutil.rmtree(work_root)
+    if not args.update:
+        print(f'\n{len(cases) - failures}/{len(cases)} cases match the golden outputs')
+    sys.exit(1 if failures else 0)
+
+if __name__ == '__main__':
+    main()